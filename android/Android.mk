@@ -67,6 +67,7 @@ LOCAL_SRC_FILES := app_main.c \
 	../src/city.cpp \
 	../src/codex.cpp \
 	../src/combat.cpp \
+	../src/combatsim.cpp \
 	../src/controller.cpp \
 	../src/context.cpp \
 	../src/creature.cpp \
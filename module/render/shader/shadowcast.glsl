@@ -15,8 +15,8 @@ void main() {
 
 uniform vec4 vport;			// Viewport pixel (x, y, width, height)
 uniform vec3 viewer;	    // World (x, y, scale)
-uniform ivec3 shape_count;	// (left, center, right)
-uniform vec3 shapes[128];	// (x, y, type) for each shape.
+uniform ivec2 center;		// Map tile at the viewer.
+uniform sampler2D occluders;	// Shape type of each map tile (0, 1, 2).
 out vec4 fragColor;
 
 vec3 shapeCube = vec3(0.5, 0.5, 0.5);
@@ -31,25 +31,34 @@ float sdBox(vec3 p, vec3 b) {
 	return length(max(q,0.0)) + min(max(q.x,q.z),0.0);	// 2D test.
 }
 
-float sceneSDF(vec3 pnt, ivec4 group) {
-	ivec2 it;
+int shapeAt(ivec2 tile) {
+	if (any(lessThan(tile, ivec2(0))) ||
+		any(greaterThanEqual(tile, textureSize(occluders, 0))))
+		return 0;
+	return int(texelFetch(occluders, tile, 0).r * 255.0 + 0.5);
+}
+
+float sceneSDF(vec3 pnt) {
 	float d;
 	float nd = farClip;
-
-	if (pnt.x < 0.0)
-		it = group.xy;
-	else
-		it = group.zw;
-
-	for ( ; it.x < it.y; it.x++) {
-		vec3 spos = shapes[it.x];
-		if (spos.z == 1.0)
-			d = sdBox(pnt - vec3(spos.x, 0.0, spos.y), shapeCube);
-		else
-			d = sdSphere(pnt - vec3(spos.x, 0.0, spos.y), 0.5);
-		nd = min(nd, d);
+	vec2 cell = floor(pnt.xz + 0.5);
+
+	// Only the 3x3 tiles around the point need to be checked as the
+	// distance is capped to 1.0 and shapes are no larger than a tile.
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			vec2 spos = cell + vec2(x, y);
+			int type = shapeAt(center + ivec2(spos));
+			if (type == 0)
+				continue;
+			if (type == 1)
+				d = sdBox(pnt - vec3(spos.x, 0.0, spos.y), shapeCube);
+			else
+				d = sdSphere(pnt - vec3(spos.x, 0.0, spos.y), 0.5);
+			nd = min(nd, d);
+		}
 	}
-	return min(1.0, nd);    // Cap ray advance to handle group transition.
+	return min(1.0, nd);    // Cap ray advance.
 }
 
 void main() {
@@ -69,14 +78,9 @@ void main() {
 	float rpos = 0.0;
 	float visible = 1.0;
 	float inside = 0.0;
-	ivec4 group;
 	int i;
 
-	// Setup the left and right shape group iterators.
-	i = shape_count.x + shape_count.y;
-	group = ivec4(0, i, shape_count.x, i + shape_count.z);
-
-	dist = sceneSDF(rayStart, group);
+	dist = sceneSDF(rayStart);
 	if (dist < 0.0) {
 		rpos = 1.0;
 		inside = 1.0;
@@ -86,7 +90,7 @@ void main() {
 		if (rpos >= rayLen)
 			break;                  // Reached viewer.
 		pnt = rayStart + rayDir * rpos;
-		dist = sceneSDF(pnt, group);
+		dist = sceneSDF(pnt);
 		if (dist < surfEpsilon) {
 			visible = 0.0;          // Inside a surface.
 			break;
@@ -142,6 +142,7 @@ exe %xu4 [
 		%city.cpp
 		%codex.cpp
 		%combat.cpp
+		%combatsim.cpp
 		%controller.cpp
 		%context.cpp
 		%creature.cpp
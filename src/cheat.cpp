@@ -171,6 +171,9 @@ bool CheatMenuController::keyPressed(int key) {
                       "r - Reagents\n"
                       "s - Summon\n"
                       "t - Transports\n"
+#ifdef GPU_RENDER
+                      "u - Zoom Out\n"
+#endif
                       "v - Full Virtues\n"
                       "w - Change Wind\n"
                       "x - Exit Map\n"
@@ -316,6 +319,21 @@ bool CheatMenuController::keyPressed(int key) {
         }
         break;
 
+#ifdef GPU_RENDER
+    case 'u': {
+        // Cycle through overview zoom levels.
+        static const float zoomTiles[] = { 0.0f, 33.0f, 99.0f, 256.0f };
+        static int zoomLevel = 0;
+        zoomLevel = (zoomLevel + 1) % 4;
+        game->mapArea.setZoom(zoomTiles[zoomLevel]);
+        if (zoomLevel)
+            screenMessage("Zoom %d!\n", int(zoomTiles[zoomLevel]));
+        else
+            screenMessage("Zoom Normal!\n");
+        break;
+    }
+#endif
+
     case 'v':
         screenMessage("\nFull Virtues!\n");
         for (i = 0; i < 8; i++)
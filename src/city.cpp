@@ -45,6 +45,7 @@ Person *City::addPerson(Person *person) {
     p->placeOnMap(this, p->getStart());
 
     objects.push_back(p);
+    ++objectsRev;
     return p;
 }
 
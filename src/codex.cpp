@@ -301,6 +301,7 @@ ask_next:
         pausedMessage(1, "\n\nThe ground rumbles beneath your feet.\n");
         soundPlay(SOUND_RUMBLE);
         screenShake(10);
+        EventHandler::waitEffects();
         EventHandler::wait_msecs(3000);
         return true;
     }
@@ -344,6 +345,7 @@ correct:
     EventHandler::wait_msecs(2000);
     soundPlay(SOUND_RUMBLE);
     screenShake(10);
+    EventHandler::waitEffects();
 
     // Split codex to reveal infinity image.
     {
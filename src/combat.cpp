@@ -8,6 +8,7 @@
 #include "death.h"
 #include "debug.h"
 #include "dungeon.h"
+#include "error.h"
 #include "item.h"
 #include "location.h"
 #include "mapmgr.h"
@@ -394,36 +395,32 @@ int  CombatController::initialNumberOfCreatures(const Creature *creature) const
  * Returns true if the player has won.
  */
 bool CombatController::isWon() const {
-    CreatureVector creatures = map->getCreatures();
-    if (creatures.size())
-        return false;
-    return true;
+    return map->syncRoster()->creatureCount == 0;
 }
 
 /**
  * Returns true if the player has lost.
  */
 bool CombatController::isLost() const {
-    PartyMemberVector party = map->getPartyMembers();
-    if (party.size())
-        return false;
-    return true;
+    const CombatRoster* ros = map->syncRoster();
+    return ros->count == ros->creatureCount;
 }
 
 /**
  * Performs all of the creature's actions
  */
 void CombatController::moveCreatures() {
+    const CombatRoster* ros;
     Creature *m;
 
-    // XXX: this iterator is rather complex; but the vector::iterator can
-    // break and crash if we delete elements while iterating it, which we do
-    // if a jinxed monster kills another
-    for (unsigned int i = 0; i < map->getCreatures().size(); i++) {
-        m = map->getCreatures().at(i);
+    // The roster is re-synced after each action as a jinxed monster may
+    // kill another or a creature may flee.
+    for (int i = 0; i < (ros = map->syncRoster())->creatureCount; i++) {
+        m = ros->handle[ ros->creatureSlot[i] ];
         m->act(this);
 
-        if (i < map->getCreatures().size() && map->getCreatures().at(i) != m) {
+        ros = map->syncRoster();
+        if (i < ros->creatureCount && ros->handle[ros->creatureSlot[i]] != m) {
             // don't skip a later creature when an earlier one flees
             i--;
         }
@@ -459,7 +456,7 @@ void CombatController::placePartyMembers() {
         if (! p->isDead()) {
             /* add the party member to the map */
             p->placeOnMap(map, map->player_start[i]);
-            map->objects.push_back(p);
+            map->addObject(p, map->player_start[i]);
             party[i] = p;
         }
     }
@@ -517,14 +514,20 @@ bool CombatController::attackHit(const Creature* attacker,
     ASSERT(attacker != NULL, "attacker must not be NULL");
     ASSERT(defender != NULL, "defender must not be NULL");
 
-    int attackValue = xu4_random(0x100) + attacker->getAttackBonus();
-    return attackValue > defender->getDefense();
+    return combat_attackHits(xu4_random(0x100), attacker->getAttackBonus(),
+                             defender->getDefense());
 }
 
 #ifdef GPU_RENDER
 #include <math.h>
 
+static void attackEffectFunc(QueuedEffect* fx, float frac) {
+    if (frac >= 1.0f)
+        xu4.game->mapArea.removeEffect(fx->id);
+}
+
 static void animateAttack(const vector<Coords>& path, int range, TileId tid) {
+    QueuedEffect fx;
     float vec[4];
 
     vec[0] = path[0].x;
@@ -539,9 +542,11 @@ static void animateAttack(const vector<Coords>& path, int range, TileId tid) {
     AnimId move = anim_startLinearF2(&xu4.eventHandler->fxAnim, duration, 0,
                                      vec, vec + 2);
 
-    int fx = xu4.game->mapArea.showEffect(path[0], tid, move);
-    EventHandler::wait_msecs(duration * 1000.0);
-    xu4.game->mapArea.removeEffect(fx);
+    fx.func = attackEffectFunc;
+    fx.duration = duration;
+    fx.id = xu4.game->mapArea.showEffect(path[0], tid, move);
+    xu4.eventHandler->queueEffect(&fx);
+    gameWaitEffects();
 }
 
 enum AttackResult {
@@ -817,7 +822,8 @@ void CombatController::finishTurn() {
 
                 /* give a slight pause in case party members are asleep for awhile */
                 gameUpdateScreen();
-                EventHandler::wait_msecs(50);
+                if (! gameFastEffects())
+                    EventHandler::wait_msecs(50);
 
                 /* adjust moves */
                 c->party->endTurn();
@@ -1275,18 +1281,124 @@ void CombatController::combatNotice(int sender, void* eventData, void* user) {
 /**
  * CombatMap class implementation
  */
-CombatMap::CombatMap() : Map(), dungeonRoom(false), altarRoom(VIRT_NONE), contextual(false) {}
+/**
+ * Return the roster index of a handle or -1 if it is not present.
+ */
+int roster_find(const CombatRoster* ros, const Creature* handle) {
+    for (int i = 0; i < ros->count; ++i) {
+        if (ros->handle[i] == handle)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Return the roster index of the first team member at pos or -1 if there
+ * is none.
+ */
+int roster_at(const CombatRoster* ros, const Coords& pos, int team) {
+    for (int i = 0; i < ros->count; ++i) {
+        if (ros->team[i] == team && ros->pos[i] == pos)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Return the roster index of the closest opponent of entry self, or -1 if
+ * there is none.  Party members oppose creatures and, when jinxed,
+ * creatures also oppose each other.
+ */
+int roster_nearestOpponent(const CombatRoster* ros, int self, bool ranged,
+                           bool jinx, int* dist) {
+    const Coords& from = ros->pos[self];
+    bool amPlayer = (ros->team[self] == ROSTER_PARTY);
+    int opponent = -1;
+    int d, leastDist = 0xFFFF;
+
+    for (int i = 0; i < ros->count; ++i) {
+        bool fightingPlayer = (ros->team[i] == ROSTER_PARTY);
+
+        /* if a party member, find a creature. If a creature, find a party member */
+        /* if jinxed is false, find anything that isn't self */
+        if ((amPlayer != fightingPlayer) ||
+            (jinx && !amPlayer && i != self)) {
+            /* if ranged, get the distance using diagonals, otherwise get movement distance */
+            if (ranged)
+                d = map_distance(ros->pos[i], from);
+            else
+                d = map_movementDistance(ros->pos[i], from);
+
+            /* skip target 50% of time if same distance */
+            if (d < leastDist || (d == leastDist && xu4_random(2) == 0)) {
+                opponent = i;
+                leastDist = d;
+            }
+        }
+    }
+
+    if (opponent >= 0)
+        *dist = leastDist;
+    return opponent;
+}
+
+CombatMap::CombatMap() : Map(), dungeonRoom(false), altarRoom(VIRT_NONE), contextual(false) {
+    roster.count = roster.creatureCount = 0;
+    roster.objectsRev = objectsRev - 1;     // Force rebuild on first sync.
+    roster.moveRev = objectMoveRev;
+}
+
+/**
+ * Bring the roster up to date with the map objects.  The member list is
+ * only rebuilt when objects have been added or removed, and the positions
+ * are only copied again when an object has moved since the last sync.
+ */
+const CombatRoster* CombatMap::syncRoster() {
+    CombatRoster* ros = &roster;
+    Creature* m;
+    int i;
+
+    if (ros->objectsRev != objectsRev) {
+        ObjectDeque::iterator it;
+        ros->objectsRev = objectsRev;
+        ros->moveRev = objectMoveRev - 1;   // Force position copy.
+        ros->count = ros->creatureCount = 0;
+        for (it = objects.begin(); it != objects.end(); ++it) {
+            m = dynamic_cast<Creature*>(*it);
+            if (! m)
+                continue;
+            if (ros->count == CombatRoster::MAX) {
+                errorWarning("Combat roster is full");
+                break;
+            }
+            i = ros->count++;
+            ros->handle[i] = m;
+            if (isPartyMember(m)) {
+                ros->team[i] = ROSTER_PARTY;
+            } else {
+                ros->team[i] = ROSTER_CREATURE;
+                ros->creatureSlot[ ros->creatureCount++ ] = i;
+            }
+        }
+    }
+
+    if (ros->moveRev != objectMoveRev) {
+        ros->moveRev = objectMoveRev;
+        for (i = 0; i < ros->count; ++i)
+            ros->pos[i] = ros->handle[i]->coords;
+    }
+    return ros;
+}
 
 /**
  * Returns a vector containing all of the creatures on the map
  */
 CreatureVector CombatMap::getCreatures() {
-    ObjectDeque::iterator i;
+    const CombatRoster* ros = syncRoster();
     CreatureVector creatures;
-    for (i = objects.begin(); i != objects.end(); i++) {
-        if (isCreature(*i) && !isPartyMember(*i))
-            creatures.push_back(dynamic_cast<Creature*>(*i));
-    }
+    creatures.reserve(ros->creatureCount);
+    for (int i = 0; i < ros->creatureCount; ++i)
+        creatures.push_back(ros->handle[ ros->creatureSlot[i] ]);
     return creatures;
 }
 
@@ -1294,11 +1406,11 @@ CreatureVector CombatMap::getCreatures() {
  * Returns a vector containing all of the party members on the map
  */
 PartyMemberVector CombatMap::getPartyMembers() {
-    ObjectDeque::iterator i;
+    const CombatRoster* ros = syncRoster();
     PartyMemberVector party;
-    for (i = objects.begin(); i != objects.end(); i++) {
-        if (isPartyMember(*i))
-            party.push_back(dynamic_cast<PartyMember*>(*i));
+    for (int i = 0; i < ros->count; ++i) {
+        if (ros->team[i] == ROSTER_PARTY)
+            party.push_back(static_cast<PartyMember*>(ros->handle[i]));
     }
     return party;
 }
@@ -1308,14 +1420,9 @@ PartyMemberVector CombatMap::getPartyMembers() {
  * NULL if otherwise.
  */
 PartyMember *CombatMap::partyMemberAt(Coords coords) {
-    PartyMemberVector party = getPartyMembers();
-    PartyMemberVector::iterator i;
-
-    for (i = party.begin(); i != party.end(); i++) {
-        if ((*i)->coords == coords)
-            return *i;
-    }
-    return NULL;
+    const CombatRoster* ros = syncRoster();
+    int i = roster_at(ros, coords, ROSTER_PARTY);
+    return (i < 0) ? NULL : static_cast<PartyMember*>(ros->handle[i]);
 }
 
 /**
@@ -1323,14 +1430,9 @@ PartyMember *CombatMap::partyMemberAt(Coords coords) {
  * NULL if otherwise.
  */
 Creature *CombatMap::creatureAt(Coords coords) {
-    CreatureVector creatures = getCreatures();
-    CreatureVector::iterator i;
-
-    for (i = creatures.begin(); i != creatures.end(); i++) {
-        if ((*i)->coords == coords)
-            return *i;
-    }
-    return NULL;
+    const CombatRoster* ros = syncRoster();
+    int i = roster_at(ros, coords, ROSTER_CREATURE);
+    return (i < 0) ? NULL : ros->handle[i];
 }
 
 // These coincide with Tile::sym.dungeonMaps[]
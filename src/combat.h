@@ -111,6 +111,35 @@ private:
 
 typedef std::vector<Creature *> CreatureVector;
 
+enum RosterTeam {
+    ROSTER_CREATURE,
+    ROSTER_PARTY
+};
+
+/**
+ * Structure of arrays copy of the creatures & party members on a combat map
+ * in map object order.  The Creature objects remain the authority and are
+ * kept as handles for the UI code.  When used without a map (e.g. for
+ * simulations) the handles may be NULL.
+ */
+struct CombatRoster {
+    enum { MAX = 128 };     // Larger than the number of combat map cells.
+
+    uint16_t count;
+    uint16_t creatureCount;
+    uint16_t objectsRev;
+    uint32_t moveRev;               // objectMoveRev when pos was copied.
+    uint8_t  team[MAX];             // RosterTeam
+    uint8_t  creatureSlot[MAX];     // Index of each ROSTER_CREATURE entry.
+    Coords   pos[MAX];
+    Creature* handle[MAX];
+};
+
+int roster_find(const CombatRoster*, const Creature* handle);
+int roster_at(const CombatRoster*, const Coords& pos, int team);
+int roster_nearestOpponent(const CombatRoster*, int self, bool ranged,
+                           bool jinx, int* dist);
+
 /**
  * CombatMap class
  */
@@ -122,6 +151,7 @@ public:
     PartyMemberVector getPartyMembers();
     PartyMember* partyMemberAt(Coords coords);
     Creature* creatureAt(Coords coords);
+    const CombatRoster* syncRoster();
 
     static MapId mapForTile(const Tile *ground, const Tile *transport, Object *obj);
 
@@ -141,6 +171,7 @@ protected:
     bool dungeonRoom;
     BaseVirtue altarRoom;
     bool contextual;
+    CombatRoster roster;
 
 public:
     Coords creature_start[AREA_CREATURES];
@@ -0,0 +1,380 @@
+/*
+ * combatsim.cpp
+ *
+ * Headless combat simulation used to balance module creatures & weapons.
+ *
+ * The current party (from party.sav) fights many groups of one creature
+ * type.  The encounter size, to-hit and damage rolls use the same rule
+ * formulas as CombatController, but battles are resolved as melee rounds
+ * without a map, screen, sound or effect delays.  Movement, ranged attacks,
+ * spells and status effects are not modeled.  Creatures below 24 hit points
+ * flee on their next turn.
+ *
+ * Each battle uses its own random generator seeded from the battle number
+ * so results do not depend on the number of worker threads.  The game
+ * generator (xu4_random) and the effects generator (xu4_randomFx) are not
+ * touched.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "combat.h"
+#include "combatsim.h"
+#include "config.h"
+#include "creature.h"
+#include "party.h"
+#include "savegame.h"
+#include "weapon.h"
+#include "xu4.h"
+#include "support/threads.h"
+
+extern uint32_t getTicks();
+
+#define SIM_DEFAULT_BATTLES 100000
+#define SIM_ROUND_LIMIT     200
+
+struct SimRandom {
+    uint64_t state;
+};
+
+struct SimPlayer {
+    int hp;
+    int attackBonus;
+    int maxDamage;
+    int defense;
+};
+
+struct SimSetup {
+    const Creature* proto;
+    uint32_t battles;
+    uint32_t seed;
+    int members;
+    SimPlayer party[8];
+};
+
+struct SimStats {
+    uint32_t won;
+    uint32_t lost;
+    uint32_t drawn;
+    uint64_t rounds;
+    uint64_t creatures;
+    uint64_t killed;
+    uint64_t fled;
+    uint64_t damageDealt;
+    uint64_t damageTaken;
+    uint64_t deaths;
+};
+
+struct SimWorker {
+    const SimSetup* setup;
+    uint32_t first;
+    uint32_t step;
+    Thread thread;
+    SimStats stats;
+};
+
+static void simRandom_seed(SimRandom* rs, uint32_t seed, uint32_t battle) {
+    // SplitMix64 scramble so neighbouring battles get unrelated sequences.
+    uint64_t z = ((uint64_t) seed << 32 | battle) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    rs->state = z ? z : 1;
+}
+
+/*
+ * Generate a random number between 0 and (upperRange - 1).
+ * Like xu4_random(), zero is returned for ranges less than two.
+ */
+static int simRandom(SimRandom* rs, int upperRange) {
+    if (upperRange < 2)
+        return 0;
+    uint64_t x = rs->state;     // xorshift64*
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rs->state = x;
+    return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32) % upperRange;
+}
+
+/*
+ * Standard encounter size rule of CombatController::initialNumberOfCreatures.
+ */
+static int simEncounterSize(SimRandom* rs, const Creature* proto, int members) {
+    int groupSize;
+    int n = simRandom(rs, 8) + 1;
+    if (n == 1) {
+        if ((groupSize = proto->getEncounterSize()) > 0)
+            n = simRandom(rs, groupSize) + groupSize + 1;
+        else
+            n = 8;
+    }
+    while (n > 2 * members)
+        n = simRandom(rs, 16) + 1;
+    return (n > AREA_CREATURES) ? AREA_CREATURES : n;
+}
+
+static void simBattle(const SimSetup* setup, SimRandom* rs, SimStats* st) {
+    const Creature* proto = setup->proto;
+    int creatureHp[AREA_CREATURES];
+    int playerHp[8];
+    int creatureCount, creaturesLeft, playersLeft;
+    int i, n, dmg, round;
+    bool immune = (proto->getId() == LORDBRITISH_ID);
+
+    creatureCount = creaturesLeft =
+        simEncounterSize(rs, proto, setup->members);
+    for (i = 0; i < creatureCount; ++i)
+        creatureHp[i] = creature_initialHp(simRandom(rs, proto->basehp),
+                                           proto->basehp);
+
+    playersLeft = 0;
+    for (i = 0; i < setup->members; ++i) {
+        playerHp[i] = setup->party[i].hp;
+        if (playerHp[i] >= 0)
+            ++playersLeft;
+    }
+
+    st->creatures += creatureCount;
+
+    for (round = 0; round < SIM_ROUND_LIMIT; ++round) {
+        // Party members attack the first creature still present.
+        for (i = 0; i < setup->members && creaturesLeft; ++i) {
+            const SimPlayer* pc = setup->party + i;
+            if (playerHp[i] < 0)
+                continue;
+            for (n = 0; creatureHp[n] <= 0; ++n)
+                ;
+            if (combat_attackHits(simRandom(rs, 0x100), pc->attackBonus,
+                                  proto->getDefense())) {
+                dmg = simRandom(rs, pc->maxDamage);
+                if (immune)
+                    continue;
+                st->damageDealt += dmg;
+                creatureHp[n] -= dmg;
+                if (creatureHp[n] <= 0) {
+                    ++st->killed;
+                    --creaturesLeft;
+                }
+            }
+        }
+        if (! creaturesLeft) {
+            ++st->won;
+            goto done;
+        }
+
+        // Creatures flee or attack a random party member.
+        for (n = 0; n < creatureCount && playersLeft; ++n) {
+            if (creatureHp[n] <= 0)
+                continue;
+            if (creatureHp[n] < 24) {
+                creatureHp[n] = 0;
+                ++st->fled;
+                --creaturesLeft;
+                continue;
+            }
+            if (! proto->willAttack())
+                continue;
+
+            i = simRandom(rs, playersLeft);
+            for (int j = 0; ; ++j) {
+                if (playerHp[j] >= 0 && i-- == 0) {
+                    i = j;
+                    break;
+                }
+            }
+            if (combat_attackHits(simRandom(rs, 0x100),
+                                  proto->getAttackBonus(),
+                                  setup->party[i].defense)) {
+                dmg = creature_damage(simRandom(rs, proto->basehp >> 2));
+                st->damageTaken += dmg;
+                playerHp[i] -= dmg;
+                if (playerHp[i] < 0) {
+                    ++st->deaths;
+                    --playersLeft;
+                }
+            }
+        }
+        if (! playersLeft) {
+            ++st->lost;
+            goto done;
+        }
+        if (! creaturesLeft) {
+            ++st->won;
+            goto done;
+        }
+    }
+    ++st->drawn;
+    st->rounds += round;
+    return;
+
+done:
+    st->rounds += round + 1;    // Battle ended during this round.
+}
+
+static THREAD_FUNC simWorkerThread(void* arg) {
+    SimWorker* wk = (SimWorker*) arg;
+    const SimSetup* setup = wk->setup;
+    SimRandom rs;
+    uint32_t b;
+
+    for (b = wk->first; b < setup->battles; b += wk->step) {
+        simRandom_seed(&rs, setup->seed, b);
+        simBattle(setup, &rs, &wk->stats);
+    }
+    return THREAD_RETURN;
+}
+
+static int cpuCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? int(n) : 1;
+#endif
+}
+
+static void printStats(const SimSetup* setup, const SimStats* st,
+                       int threads, uint32_t msec) {
+    double battles = setup->battles;
+
+    printf("Creature: %s\n"
+           "Battles:  %u (seed %u, %d threads, %u ms)\n\n",
+           setup->proto->getName(), setup->battles, setup->seed,
+           threads, msec);
+
+    printf("Won      %10u  %6.2f%%\n"
+           "Lost     %10u  %6.2f%%\n"
+           "Drawn    %10u  %6.2f%%\n\n",
+           st->won,   100.0 * st->won / battles,
+           st->lost,  100.0 * st->lost / battles,
+           st->drawn, 100.0 * st->drawn / battles);
+
+    printf("Per battle:\n"
+           "  Rounds          %8.2f\n"
+           "  Creatures       %8.2f\n"
+           "  Killed          %8.2f\n"
+           "  Fled            %8.2f\n"
+           "  Damage dealt    %8.2f\n"
+           "  Damage taken    %8.2f\n"
+           "  Party deaths    %8.2f\n",
+           st->rounds / battles,
+           st->creatures / battles,
+           st->killed / battles,
+           st->fled / battles,
+           st->damageDealt / battles,
+           st->damageTaken / battles,
+           st->deaths / battles);
+}
+
+/*
+ * Run simulated battles and print the statistics.
+ *
+ * \param spec  "creature[,battles[,seed[,threads]]]"
+ *
+ * \return Program exit status.
+ */
+int combatSim_run(const char* spec) {
+    SimSetup setup;
+    char name[64];
+    const char* field;
+    int threads = cpuCount();
+    int i;
+
+    memset(&setup, 0, sizeof(setup));
+    setup.battles = SIM_DEFAULT_BATTLES;
+    setup.seed = 1;
+
+    field = strchr(spec, ',');
+    i = field ? field - spec : strlen(spec);
+    if (i >= (int) sizeof(name))
+        i = sizeof(name) - 1;
+    memcpy(name, spec, i);
+    name[i] = '\0';
+
+    if (field) {
+        setup.battles = strtoul(field + 1, NULL, 0);
+        if ((field = strchr(field + 1, ','))) {
+            setup.seed = strtoul(field + 1, NULL, 0);
+            if ((field = strchr(field + 1, ',')))
+                threads = atoi(field + 1);
+        }
+    }
+    if (threads < 1)
+        threads = 1;
+
+    setup.proto = Creature::getByName(name);
+    if (! setup.proto) {
+        fprintf(stderr, "combat-sim: Unknown creature \"%s\"\n", name);
+        return 1;
+    }
+
+    const SaveGame* sg = saveGameLoad();
+    if (! sg) {
+        fprintf(stderr, "combat-sim: %s\n", xu4.errorMessage);
+        return 1;
+    }
+    setup.members = (sg->members > 8) ? 8 : sg->members;
+    for (i = 0; i < setup.members; ++i) {
+        const SaveGamePlayerRecord* rec = sg->players + i;
+        SimPlayer* pc = setup.party + i;
+        pc->hp = (rec->status == STAT_DEAD) ? -1 : rec->hp;
+        pc->attackBonus = player_attackBonus(rec);
+        pc->maxDamage   = player_maxDamage(rec);
+        pc->defense     = xu4.config->armor(rec->armor)->defense;
+    }
+
+    // Run the workers.
+    SimWorker* workers = new SimWorker[threads];
+    uint32_t startTime = getTicks();
+    int running = 0;
+
+    for (i = 0; i < threads; ++i) {
+        SimWorker* wk = workers + i;
+        wk->setup = &setup;
+        wk->first = i;
+        wk->step  = threads;
+        memset(&wk->stats, 0, sizeof(SimStats));
+    }
+    for (i = 1; i < threads; ++i) {
+        if (! thread_create(&workers[i].thread, simWorkerThread, workers + i))
+            break;
+        ++running;
+    }
+    if (running < threads - 1) {
+        // Do the battles of workers which could not be started here.
+        for (int j = running + 1; j < threads; ++j)
+            simWorkerThread(workers + j);
+    }
+    simWorkerThread(workers);
+    for (i = 1; i <= running; ++i)
+        thread_join(workers[i].thread);
+
+    // Combine results.
+    SimStats total = workers[0].stats;
+    for (i = 1; i < threads; ++i) {
+        const SimStats* st = &workers[i].stats;
+        total.won         += st->won;
+        total.lost        += st->lost;
+        total.drawn       += st->drawn;
+        total.rounds      += st->rounds;
+        total.creatures   += st->creatures;
+        total.killed      += st->killed;
+        total.fled        += st->fled;
+        total.damageDealt += st->damageDealt;
+        total.damageTaken += st->damageTaken;
+        total.deaths      += st->deaths;
+    }
+
+    if (setup.battles)
+        printStats(&setup, &total, threads, getTicks() - startTime);
+    delete[] workers;
+    return 0;
+}
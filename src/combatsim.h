@@ -0,0 +1,10 @@
+/*
+ * combatsim.h
+ */
+
+#ifndef COMBATSIM_H
+#define COMBATSIM_H
+
+int combatSim_run(const char* spec);
+
+#endif
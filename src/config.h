@@ -54,6 +54,7 @@ public:
     int scriptItemId(Symbol name);
     const void* scriptEvalArg(const char* fmt, ...);
     int32_t npcTalk(uint32_t appId);
+    void npcTalkPrefetch(const uint32_t* appIds, int count);
 #endif
     void* loadFile(const char* sourceFilename) const;
     const char* modulePath(const CDIEntry*) const;
@@ -84,6 +85,7 @@ public:
     const UltimaSaveIds* usaveIds() const;
     Map* map(uint32_t id);
     Map* restoreMap(uint32_t id);
+    int mapMusic(uint32_t id) const;
     const Coords* moongateCoords(int phase) const;
 
 protected:
@@ -29,6 +29,10 @@
 #include "weapon.h"
 #include "u4file.h"
 #include "xu4.h"
+#include "support/threads.h"
+#include "support/symbolIndex.c"
+
+extern int64_t usecTicks();
 
 #include "config_data.cpp"
 
@@ -58,13 +62,29 @@ Config::~Config() {}
 
 //--------------------------------------
 
-#define TALK_CACHE_SIZE 2
+// Number of unserialized talk blocks kept.  May be set at build time.
+#ifndef TALK_CACHE_SIZE
+#define TALK_CACHE_SIZE 8
+#endif
+#define TALK_PREFETCH_MAX 4
+
+struct TalkChunk
+{
+    CDIEntry ent;
+    const char* path;
+    uint8_t* buf;
+};
 
 struct NpcTalkCache
 {
     UIndex blkN;
     uint32_t appId[TALK_CACHE_SIZE];
-    int lastUsed;
+    uint32_t lastUse[TALK_CACHE_SIZE];
+    uint32_t useCount;
+    int loading;
+    int pendingCount;
+    Thread loader;
+    TalkChunk pending[TALK_PREFETCH_MAX];
 };
 
 static void npcTalk_init(NpcTalkCache* tc, UThread* ut) {
@@ -74,8 +94,108 @@ static void npcTalk_init(NpcTalkCache* tc, UThread* ut) {
     ur_hold(tc->blkN);      // Keep forever.
 
     UBuffer* blk = ur_buffer(tc->blkN);
-    ur_blkAppendNew(blk, UT_NONE);
-    ur_blkAppendNew(blk, UT_NONE);
+    for (int i = 0; i < TALK_CACHE_SIZE; ++i)
+        ur_blkAppendNew(blk, UT_NONE);
+}
+
+/*
+ * Read the raw chunks of the pending list.  This runs on the loader thread
+ * and only touches the pending entries.
+ */
+static THREAD_FUNC npcTalk_loadThread(void* arg) {
+    NpcTalkCache* tc = (NpcTalkCache*) arg;
+    TalkChunk* it  = tc->pending;
+    TalkChunk* end = it + tc->pendingCount;
+    for (; it != end; ++it) {
+        FILE* fp = fopen(it->path, "rb");
+        if (fp) {
+            it->buf = cdi_loadPakChunk(fp, &it->ent);
+            fclose(fp);
+        }
+    }
+    return THREAD_RETURN;
+}
+
+static void npcTalk_waitLoad(NpcTalkCache* tc) {
+    if (tc->loading) {
+        thread_join(tc->loader);
+        tc->loading = 0;
+    }
+}
+
+static void npcTalk_dropPending(NpcTalkCache* tc) {
+    npcTalk_waitLoad(tc);
+    for (int i = 0; i < tc->pendingCount; ++i)
+        free(tc->pending[i].buf);
+    tc->pendingCount = 0;
+}
+
+/*
+ * Return the raw chunk for appId if it was prefetched, or NULL.
+ * The caller must free() the returned buffer.
+ */
+static uint8_t* npcTalk_takePending(NpcTalkCache* tc, uint32_t appId) {
+    npcTalk_waitLoad(tc);
+    TalkChunk* it  = tc->pending;
+    TalkChunk* end = it + tc->pendingCount;
+    for (; it != end; ++it) {
+        if (it->ent.appId == appId) {
+            uint8_t* buf = it->buf;
+            it->buf = NULL;
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+static int npcTalk_lookup(const NpcTalkCache* tc, uint32_t appId) {
+    for (int n = 0; n < TALK_CACHE_SIZE; ++n) {
+        if (tc->appId[n] == appId)
+            return n;
+    }
+    return -1;
+}
+
+/*
+ * Return the least recently used cache slot.
+ */
+static int npcTalk_victim(const NpcTalkCache* tc) {
+    int slot = 0;
+    for (int n = 1; n < TALK_CACHE_SIZE; ++n) {
+        if (tc->lastUse[n] < tc->lastUse[slot])
+            slot = n;
+    }
+    return slot;
+}
+
+//--------------------------------------
+
+#define SCRIPT_CACHE_SIZE   32
+
+/*
+ * Direct mapped cache of tokenized & bound scripts keyed by the script text.
+ */
+struct ScriptCache
+{
+    UIndex blkN;
+    uint32_t hash[SCRIPT_CACHE_SIZE];
+    char* text[SCRIPT_CACHE_SIZE];
+};
+
+static void scriptCache_init(ScriptCache* sc, UThread* ut) {
+    memset(sc, 0, sizeof(ScriptCache));
+
+    sc->blkN = ur_makeBlock(ut, SCRIPT_CACHE_SIZE);
+    ur_hold(sc->blkN);      // Keep forever.
+
+    UBuffer* blk = ur_buffer(sc->blkN);
+    for (int i = 0; i < SCRIPT_CACHE_SIZE; ++i)
+        ur_blkAppendNew(blk, UT_NONE);
+}
+
+static void scriptCache_free(ScriptCache* sc) {
+    for (int i = 0; i < SCRIPT_CACHE_SIZE; ++i)
+        free(sc->text[i]);
 }
 
 //--------------------------------------
@@ -93,6 +213,8 @@ struct ConfigData
     vector<Coords> moongateList;    // Moon phase map coordinates.
 
     TileRule* tileRules;
+    uint16_t* tileRuleIndex;    // Symbol to tileRules index + 1.
+    uint32_t tileRuleIndexSize;
     uint16_t tileRuleCount;
     int16_t  tileRuleDefault;
     Tileset* tileset;
@@ -118,6 +240,7 @@ struct ConfigBoron : public Config {
     size_t tocUsed;
     ConfigData xcd;
     UBuffer evalBuf;
+    ScriptCache evalCache;
     Symbol sym_hitFlash;
     Symbol sym_missFlash;
     Symbol sym_random;
@@ -831,9 +954,14 @@ static Weapon* conf_weapon(const ConfigBoron* cfg, int type, UBlockIt& bi) {
 
 #include "script_boron.cpp"
 
+/*
+ * Format and evaluate a script.  The compiled script is cached so repeated
+ * calls with the same arguments are only parsed once.
+ */
 const void* Config::scriptEvalArg(const char* fmt, ...)
 {
-    UBuffer* buf = &static_cast<ConfigBoron*>(this)->evalBuf;
+    ConfigBoron* cb = static_cast<ConfigBoron*>(this);
+    UBuffer* buf = &cb->evalBuf;
     int bufSize = ur_avail(buf);
     va_list arg;
     int n;
@@ -843,7 +971,7 @@ const void* Config::scriptEvalArg(const char* fmt, ...)
     va_end(arg);
 
     if (n > 0 && n < bufSize)
-        return script_eval(CX->ut, buf->ptr.c, n);
+        return script_evalCached(cb->ut, &cb->evalCache, buf->ptr.c, n);
     return NULL;
 }
 
@@ -978,6 +1106,10 @@ ConfigBoron::ConfigBoron(const char* renderPath, const char* modulePath,
     backend = &xcd;
     xcd.creatureTileIndex = NULL;
     xcd.tileset = NULL;
+    xcd.tileRules = NULL;
+    xcd.tileRuleCount = 0;
+    xcd.tileRuleIndex = NULL;
+    xcd.tileRuleIndexSize = 0;
     memset(&xcd.usaveIds, 0, sizeof(xcd.usaveIds));
     ur_binInit(&evalBuf, 1024);
 
@@ -1011,6 +1143,7 @@ ConfigBoron::ConfigBoron(const char* renderPath, const char* modulePath,
     }
 
     npcTalk_init(&xcd.talk, ut);
+    scriptCache_init(&evalCache, ut);
 
 
     // Load primary elements.
@@ -1056,6 +1189,10 @@ ConfigBoron::ConfigBoron(const char* renderPath, const char* modulePath,
 #endif
             ++rule;
         }
+        // Search order matches the original linear scan; the first wins.
+        xcd.tileRuleIndex = symi_build(&xcd.tileRules->name,
+                                       rule - xcd.tileRules, sizeof(TileRule),
+                                       SYMI_FIRST, &xcd.tileRuleIndexSize);
     }
 
     // tileset (requires tileRules)
@@ -1068,10 +1205,10 @@ ConfigBoron::ConfigBoron(const char* renderPath, const char* modulePath,
         for (moduleId = 0; moduleId < tileCount; ++moduleId) {
             if (! conf_tile(this, tile, moduleId, bi))
                 break;
-            ts->nameMap[tile->name] = tile;     // Add tile to nameMap
             ++tile;
         }
         ts->tileCount = moduleId;
+        ts->indexNames();
     }
 
     // u4-save-ids
@@ -1144,10 +1281,13 @@ ConfigBoron::~ConfigBoron()
         delete *wit;
 
     delete[] xcd.tileRules;
+    free(xcd.tileRuleIndex);
     delete xcd.tileset;
     xcd.usaveIds.free();
     ur_binFree(&evalBuf);
+    scriptCache_free(&evalCache);
 
+    npcTalk_dropPending(&xcd.talk);
     mod_free(&mod);
     boron_freeEnv( ut );
 }
@@ -1183,8 +1323,13 @@ Config* configInit(const char* module, const char* soundtrack) {
             errorWarning("Cannot find module %s", soundtrack);
     }
 
-    return new ConfigBoron(renderFound ? rpath : NULL, mpath,
-                           stFound ? spath : NULL);
+    int64_t start = usecTicks();
+    Config* conf = new ConfigBoron(renderFound ? rpath : NULL, mpath,
+                                   stFound ? spath : NULL);
+    if (xu4.verbose)
+        printf("Config loaded in %.2f ms\n",
+               double(usecTicks() - start) * 0.001);
+    return conf;
 }
 
 void configFree(Config* conf) {
@@ -1324,39 +1469,80 @@ int Config::scriptItemId(Symbol name) {
 /*
  * Load an NPC Talk chunk from the game module (or overlay).
  * Return block buffer index or UR_INVALID_BUF.
+ *
+ * The returned block stays valid only until the next npcTalk() call as it
+ * may then be evicted from the cache.
  */
 int32_t Config::npcTalk(uint32_t appId) {
     NpcTalkCache& talk = CB->talk;
     UThread* ut = CX->ut;
     UCell* talkCell = ur_buffer(talk.blkN)->ptr.cell;
-    int n;
-    for (n = 0; n < TALK_CACHE_SIZE; ++n) {
-        if (talk.appId[n] == appId) {
-            talk.lastUsed = n;
-            return talkCell[n].series.buf;
-        }
+    int n = npcTalk_lookup(&talk, appId);
+    if (n >= 0) {
+        talk.lastUse[n] = ++talk.useCount;
+        return talkCell[n].series.buf;
     }
 
     const CDIEntry* ent = mod_findAppId(&CX->mod, appId);
     if (ent) {
-        uint8_t* buf;
-        UStatus ok;
-        FILE* fp = fopen(mod_path(&CX->mod, ent), "rb");
-        if (fp) {
-            buf = cdi_loadPakChunk(fp, ent);
-            fclose(fp);
-            if (buf) {
-                talk.lastUsed ^= 1;
-                talkCell += talk.lastUsed;
-                ok = ur_unserialize(ut, buf, buf + ent->bytes, talkCell);
-                free(buf);
-                return (ok == UR_OK) ? talkCell->series.buf : UR_INVALID_BUF;
+        uint8_t* buf = npcTalk_takePending(&talk, appId);
+        if (! buf) {
+            FILE* fp = fopen(mod_path(&CX->mod, ent), "rb");
+            if (fp) {
+                buf = cdi_loadPakChunk(fp, ent);
+                fclose(fp);
             }
         }
+        if (buf) {
+            UStatus ok;
+            n = npcTalk_victim(&talk);
+            talkCell += n;
+            ok = ur_unserialize(ut, buf, buf + ent->bytes, talkCell);
+            free(buf);
+            if (ok == UR_OK) {
+                talk.appId[n] = appId;
+                talk.lastUse[n] = ++talk.useCount;
+                return talkCell->series.buf;
+            }
+            ur_setId(talkCell, UT_NONE);
+            talk.appId[n] = 0;
+            talk.lastUse[n] = 0;
+        }
     }
     return UR_INVALID_BUF;
 }
 
+/*
+ * Begin reading the NPC Talk chunks for the given ids on a worker thread so
+ * that a following npcTalk() call for any of them does not hit the disk.
+ * Any chunks from a previous prefetch which were not used are discarded.
+ */
+void Config::npcTalkPrefetch(const uint32_t* appIds, int count) {
+    NpcTalkCache& talk = CB->talk;
+    const CDIEntry* ent;
+    TalkChunk* tc;
+
+    npcTalk_dropPending(&talk);
+
+    for (int i = 0; i < count; ++i) {
+        if (talk.pendingCount == TALK_PREFETCH_MAX)
+            break;
+        if (npcTalk_lookup(&talk, appIds[i]) >= 0)
+            continue;
+        ent = mod_findAppId(&CX->mod, appIds[i]);
+        if (ent) {
+            tc = talk.pending + talk.pendingCount++;
+            tc->ent  = *ent;
+            tc->path = mod_path(&CX->mod, ent);
+            tc->buf  = NULL;
+        }
+    }
+
+    // If the thread cannot be started npcTalk() will load synchronously.
+    if (talk.pendingCount)
+        talk.loading = thread_create(&talk.loader, npcTalk_loadThread, &talk);
+}
+
 /*
  * Return the data from a given source filename.
  * The caller must free() this buffer when finished with it.
@@ -1512,13 +1698,22 @@ const Creature* const* Config::creatureTable( uint32_t* plen ) const {
  * is returned.
  */
 const TileRule* Config::tileRule( Symbol name ) const {
-    const TileRule* it = CB->tileRules;
-    const TileRule* end = it + CB->tileRuleCount;
-    for (; it != end; ++it) {
-        if (it->name == name)
-            return it;
+    const ConfigData* cd = CB;
+    if (! cd->tileRuleIndex) {
+        // The index could not be allocated; the first rule wins.
+        const TileRule* it = cd->tileRules;
+        const TileRule* end = it + cd->tileRuleCount;
+        for (; it != end; ++it) {
+            if (it->name == name)
+                return it;
+        }
+    } else {
+        uint16_t n = symi_lookup(cd->tileRuleIndex, cd->tileRuleIndexSize,
+                                 name);
+        if (n)
+            return cd->tileRules + n - 1;
     }
-    return CB->tileRules + CB->tileRuleDefault;
+    return cd->tileRules + cd->tileRuleDefault;
 }
 
 const Tileset* Config::tileset() const {
@@ -1529,7 +1724,7 @@ const UltimaSaveIds* Config::usaveIds() const {
     return &CB->usaveIds;
 }
 
-extern bool loadMap(Map *map, FILE* sav);
+extern bool loadMap(Map *map, bool restore);
 
 Map* Config::map(uint32_t id) {
     if (id >= CB->mapList.size())
@@ -1538,7 +1733,7 @@ Map* Config::map(uint32_t id) {
     Map* rmap = CB->mapList[id];
     /* if the map hasn't been loaded yet, load it! */
     if (! rmap->data) {
-        if (! loadMap(rmap, NULL))
+        if (! loadMap(rmap, false))
             errorFatal("loadMap failed to read map #%d (type %d)",
                        rmap->id, rmap->type);
     }
@@ -1552,23 +1747,20 @@ Map* Config::restoreMap(uint32_t id) {
 
     Map* rmap = CB->mapList[id];
     if (! rmap->data) {
-        FILE* sav = NULL;
-        bool ok;
-
-        if (rmap->type == Map::DUNGEON) {
-            std::string path(xu4.settings->getUserPath() + DNGMAP_SAV);
-            sav = fopen(path.c_str(), "rb");
-        }
-        ok = loadMap(rmap, sav);
-        if (sav)
-            fclose(sav);
-        if (! ok)
+        if (! loadMap(rmap, true))
             errorFatal("loadMap failed to read \"%s\" (type %d)",
                        confString(rmap->fname), rmap->type);
     }
     return rmap;
 }
 
+// Return the music track of a map without loading it.
+int Config::mapMusic(uint32_t id) const {
+    if (id >= CB->mapList.size())
+        return 0;
+    return CB->mapList[id]->music;
+}
+
 const Coords* Config::moongateCoords(int phase) const {
     if (phase < (int) CB->moongateList.size())
         return &CB->moongateList[ phase ];
@@ -61,19 +61,17 @@ bool Creature::isAttackable() const  {
 }
 
 int Creature::getDamage() const {
-    int x = xu4_random(basehp >> 2);
-    return (x >> 4) * 10 + (x % 10);
+    return creature_damage(xu4_random(basehp >> 2));
 }
 
 int Creature::setInitialHp(int points) {
     if (points < 0)
-        hp = xu4_random(basehp) | (basehp / 2);
+        hp = creature_initialHp(xu4_random(basehp), basehp);
+    else if (points < 24)
+        hp = 24;    /* make sure the creature doesn't flee initially */
     else
         hp = points;
 
-    /* make sure the creature doesn't flee initially */
-    if (hp < 24) hp = 24;
-
     return hp;
 }
 
@@ -567,6 +565,15 @@ Creature *Creature::nearestOpponent(Map* map, int *dist, bool ranged) const {
     ObjectDeque::iterator i;
     bool jinx = (c->aura.getType() == Aura::JINX);
 
+    if (isCombatMap(map)) {
+        const CombatRoster* ros = static_cast<CombatMap*>(map)->syncRoster();
+        int self = roster_find(ros, this);
+        if (self >= 0) {
+            int n = roster_nearestOpponent(ros, self, ranged, jinx, dist);
+            return (n < 0) ? NULL : ros->handle[n];
+        }
+    }
+
     for (i = map->objects.begin(); i < map->objects.end(); i++) {
         if (!isCreature(*i))
             continue;
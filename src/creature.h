@@ -245,4 +245,25 @@ public:
 
 bool isCreature(Object *punknown);
 
+/*
+ * Combat rule formulas.  The random rolls are passed in so that the
+ * headless combat simulator can use its own generators.
+ */
+
+// roll: 0 to 255
+inline bool combat_attackHits(int roll, int attackBonus, int defense) {
+    return roll + attackBonus > defense;
+}
+
+// roll: 0 to (basehp / 4) - 1
+inline int creature_damage(int roll) {
+    return (roll >> 4) * 10 + (roll % 10);
+}
+
+// roll: 0 to basehp - 1
+inline int creature_initialHp(int roll, int basehp) {
+    int hp = roll | (basehp / 2);
+    return (hp < 24) ? 24 : hp;     // Make sure it doesn't flee initially.
+}
+
 #endif
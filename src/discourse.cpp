@@ -23,6 +23,10 @@ void pauseFollow(Person* npc) {
         npc->movement = MOVEMENT_FOLLOW_PAUSE;
 }
 
+#include "discourse_keyword.cpp"
+
+//--------------------------------------
+
 #include "discourse_tlk.cpp"
 #include "discourse_castle.cpp"
 
@@ -37,11 +41,30 @@ static const char* vendorGoods[] = {
     "healer", "inn", "guild", "stable"
 };
 
+/*
+ * Start loading the data for a resource in the background so that a
+ * following discourse_load() of it will not wait on the disk.
+ */
+void discourse_prefetch(const char* resource)
+{
+#ifdef CONF_MODULE
+    if (resource[0] == 'N' && resource[4] == '\0') {
+        const uint8_t* ub = (const uint8_t*) resource;
+        uint32_t id = CDI32(ub[0], ub[1], ub[2], ub[3]);
+        xu4.config->npcTalkPrefetch(&id, 1);
+    }
+#else
+    (void) resource;
+#endif
+}
+
 /*
  * Return error message or NULL if successful.
  */
 const char* discourse_load(Discourse* dis, const char* resource)
 {
+    dis->keywords = NULL;
+
 #ifdef CONF_MODULE
     if (resource[0] == 'N' && resource[4] == '\0') {
         const uint8_t* ub = (const uint8_t*) resource;
@@ -54,6 +77,7 @@ const char* discourse_load(Discourse* dis, const char* resource)
         dis->system = DISCOURSE_XU4_TALK;
         UThread* ut = xu4.config->boronThread();
         dis->convCount = ur_buffer(blkN)->used / DI_COUNT;
+        dis->keywords = talkIndexBoron(blkN, dis->convCount);
     } else
 #endif
     if (strcmp(resource, "vendors") == 0) {
@@ -94,6 +118,7 @@ const char* discourse_load(Discourse* dis, const char* resource)
             strings += 288;
         }
         dis->convCount = i;
+        dis->keywords = U4Talk_index((const U4Talk*) dis->conv.table, i);
 
         u4fclose(fh);
     }
@@ -103,6 +128,9 @@ const char* discourse_load(Discourse* dis, const char* resource)
 
 void discourse_free(Discourse* dis)
 {
+    free(dis->keywords);
+    dis->keywords = NULL;
+
     switch (dis->system) {
         case DISCOURSE_CASTLE:
         {
@@ -152,7 +180,7 @@ bool discourse_run(const Discourse* dis, uint16_t entry, Person* npc)
     {
         int32_t blkN = xu4.config->npcTalk(dis->conv.id);
         if (blkN) {
-            talkRunBoron(blkN, entry, npc);
+            talkRunBoron(dis, blkN, entry, npc);
             talked = true;
         }
     }
@@ -195,23 +223,38 @@ bool discourse_run(const Discourse* dis, uint16_t entry, Person* npc)
  */
 int discourse_findName(const Discourse* dis, const char* name)
 {
-    int i;
-    if (dis->system == DISCOURSE_U4_TLK) {
-        const U4Talk* tlk = (const U4Talk*) dis->conv.table;
-        for (i = 0; i < dis->convCount; ++i) {
-            if (strcmp(tlk->strings + tlk->name, name) == 0)
-                return i;
-            ++tlk;
-        }
-    } else if (dis->system == DISCOURSE_CASTLE) {
+    if (dis->system == DISCOURSE_CASTLE) {
         const U4Talk** tlkTable = (const U4Talk**) dis->conv.table;
-        for (i = 0; i < dis->convCount; ++i) {
+        for (int i = 0; i < dis->convCount; ++i) {
             const U4Talk* tlk = tlkTable[i];
             if (strcmp(tlk->strings + tlk->name, name) == 0)
                 return i;
         }
+        return -1;
+    }
+    return kwi_findName(dis->keywords, name);
+}
+
+/*
+ * Get the voice streams (one based Config::musicFile ids) used by the
+ * conversations.
+ *
+ * Return the number of ids stored.
+ */
+int discourse_voiceStreams(const Discourse* dis, uint16_t* ids, int limit)
+{
+#ifdef CONF_MODULE
+    if (dis->system == DISCOURSE_XU4_TALK) {
+        int32_t blkN = xu4.config->npcTalk(dis->conv.id);
+        if (blkN)
+            return talkVoicesBoron(blkN, dis->convCount, ids, limit);
     }
-    return -1;
+#else
+    (void) dis;
+    (void) ids;
+    (void) limit;
+#endif
+    return 0;
 }
 
 const char* discourse_name(const Discourse* dis, uint16_t entry)
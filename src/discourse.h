@@ -15,11 +15,14 @@ enum DiscourseSystem {
     DISCOURSE_VENDOR        // Boron/XML script
 };
 
+struct KeywordIndex;
+
 struct Discourse {
     union {
         void*    table;
         uint32_t id;
     } conv;
+    KeywordIndex* keywords;     // Topic & name lookup built by discourse_load.
     uint8_t  system;
     uint8_t  _pad;
     uint16_t convCount;
@@ -29,9 +32,11 @@ class Person;
 
 void        discourse_init(Discourse*);
 const char* discourse_load(Discourse*, const char* resource);
+void        discourse_prefetch(const char* resource);
 void        discourse_free(Discourse*);
 bool        discourse_run(const Discourse*, uint16_t entry, Person*);
 int         discourse_findName(const Discourse*, const char* name);
 const char* discourse_name(const Discourse*, uint16_t entry);
+int         discourse_voiceStreams(const Discourse*, uint16_t* ids, int limit);
 
 #endif
@@ -0,0 +1,300 @@
+/*
+ * discourse_keyword.cpp
+ *
+ * This is #included by discourse.cpp and by the util/kwbench benchmark.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//--------------------------------------
+// Keyword Index
+//
+// Topic keywords of all conversations are kept in one open addressing hash
+// table keyed by the first four lower case characters (U4 only ever checks
+// four) and the conversation number.  Any characters of a keyword beyond
+// the first four are stored in the tails string.  Character names are held
+// in the same table using KW_NAME_CONV.
+//
+// Hashing only pays off for conversations with many topics; a U4 .TLK
+// conversation has four to six.  The topics of each conversation are also
+// kept together in a list which is scanned when there are fewer than
+// KW_HASH_MIN of them, and only larger conversations go into the table.
+
+#define KW_NAME_CONV    0xffff
+#define KW_EMPTY        0xfffe
+
+// Minimum topics in a conversation for them to be hashed.
+#ifndef KW_HASH_MIN
+#define KW_HASH_MIN     16
+#endif
+
+struct KeywordEntry {
+    uint32_t key;       // First four characters, lower case & zero padded.
+    uint16_t conv;      // Conversation number, KW_NAME_CONV, or KW_EMPTY.
+    uint16_t value;     // Response (or conversation number for names).
+    uint16_t aux;
+    uint16_t tail;      // Offset of characters past the key in tails.
+    uint16_t len;       // Full keyword length.
+    uint16_t _pad;
+};
+
+struct KeywordIndex {
+    uint32_t mask;
+    uint32_t convCount;
+    const KeywordEntry* table;
+    const KeywordEntry* list;       // Topics in conversation & add order.
+    const uint32_t* convStart;      // List index of each conversation.
+    const char* tails;
+};
+
+struct KeywordBuilder {
+    std::vector<KeywordEntry> entries;
+    std::string tails;
+};
+
+static inline uint32_t kw_lower(uint8_t c) {
+    return (uint32_t(c - 'A') < 26u) ? c + 32 : c;
+}
+
+static uint32_t kw_packKey(const char* str, int len) {
+    uint32_t key = 0;
+    if (len > 4)
+        len = 4;
+    for (int i = 0; i < len; ++i)
+        key |= kw_lower((uint8_t) str[i]) << (i * 8);
+    return key;
+}
+
+/*
+ * Pack the first four characters of a nul terminated string.
+ */
+static inline uint32_t kw_packInput(const char* str) {
+    uint32_t key = 0;
+    for (int i = 0; i < 4 && str[i]; ++i)
+        key |= kw_lower((uint8_t) str[i]) << (i * 8);
+    return key;
+}
+
+// MurmurHash3 finalizer, which mixes every input bit into the low bits
+// used for the table index.
+static inline uint32_t kw_hash(uint32_t key, uint16_t conv) {
+    uint32_t h = key ^ (uint32_t(conv) << 16 | conv);
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    return h ^ (h >> 16);
+}
+
+/*
+ * Names are hashed on all their characters as many can share the same
+ * first four.
+ */
+static inline uint32_t kw_fnv(uint32_t h, char c) {
+    return (h ^ uint32_t(tolower((uint8_t) c))) * 16777619u;
+}
+
+static uint32_t kw_nameHash(const char* name, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; ++i)
+        h = kw_fnv(h, name[i]);
+    return kw_hash(h, KW_NAME_CONV);
+}
+
+static uint32_t kw_entryHash(const KeywordEntry* ent, const char* tails) {
+    if (ent->conv != KW_NAME_CONV)
+        return kw_hash(ent->key, ent->conv);
+
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < ent->len; ++i)
+        h = kw_fnv(h, (i < 4) ? char(ent->key >> (i * 8))
+                              : tails[ent->tail + i - 4]);
+    return kw_hash(h, KW_NAME_CONV);
+}
+
+static void kwb_add(KeywordBuilder* kb, int conv, const char* word, int len,
+                    int value, int aux) {
+    KeywordEntry ent;
+    ent.key   = kw_packKey(word, len);
+    ent.conv  = conv;
+    ent.value = value;
+    ent.aux   = aux;
+    ent.tail  = kb->tails.size();
+    ent.len   = len;
+    ent._pad  = 0;
+    if (len > 4)
+        kb->tails.append(word + 4, len - 4);
+    kb->entries.push_back(ent);
+}
+
+/*
+ * Return a new index which must be released with free(), or NULL if
+ * memory could not be allocated.
+ */
+static KeywordIndex* kwb_finish(const KeywordBuilder* kb) {
+    std::vector<KeywordEntry>::const_iterator it;
+    uint32_t convCount = 0;
+    uint32_t listCount = 0;
+    uint32_t hashCount = 0;
+    uint32_t i;
+
+    for (it = kb->entries.begin(); it != kb->entries.end(); ++it) {
+        if (it->conv != KW_NAME_CONV) {
+            ++listCount;
+            if (it->conv >= convCount)
+                convCount = it->conv + 1;
+        }
+    }
+
+    std::vector<uint32_t> topicCount(convCount + 1, 0);
+    for (it = kb->entries.begin(); it != kb->entries.end(); ++it) {
+        if (it->conv != KW_NAME_CONV)
+            ++topicCount[it->conv];
+    }
+    for (it = kb->entries.begin(); it != kb->entries.end(); ++it) {
+        if (it->conv == KW_NAME_CONV || topicCount[it->conv] >= KW_HASH_MIN)
+            ++hashCount;
+    }
+
+    uint32_t slots = 8;
+    while (slots < hashCount * 2)
+        slots *= 2;
+
+    size_t tableSize = slots * sizeof(KeywordEntry);
+    size_t listSize  = listCount * sizeof(KeywordEntry);
+    size_t startSize = (convCount + 1) * sizeof(uint32_t);
+    KeywordIndex* ki = (KeywordIndex*)
+        malloc(sizeof(KeywordIndex) + tableSize + listSize + startSize +
+               kb->tails.size());
+    if (! ki)
+        return NULL;
+
+    KeywordEntry* table = (KeywordEntry*) (ki + 1);
+    KeywordEntry* list = table + slots;
+    uint32_t* convStart = (uint32_t*) (list + listCount);
+    char* tails = (char*) (convStart + convCount + 1);
+
+    // Counting sort the topics by conversation, keeping the add order.
+    uint32_t start = 0;
+    for (i = 0; i <= convCount; ++i) {
+        convStart[i] = start;
+        start += topicCount[i];
+    }
+    for (i = 0; i < convCount; ++i)
+        topicCount[i] = convStart[i];
+
+    for (i = 0; i < slots; ++i)
+        table[i].conv = KW_EMPTY;
+
+    for (it = kb->entries.begin(); it != kb->entries.end(); ++it) {
+        if (it->conv != KW_NAME_CONV) {
+            list[topicCount[it->conv]++] = *it;
+            if (convStart[it->conv + 1] - convStart[it->conv] < KW_HASH_MIN)
+                continue;
+        }
+        i = kw_entryHash(&*it, kb->tails.data()) & (slots - 1);
+        while (table[i].conv != KW_EMPTY)
+            i = (i + 1) & (slots - 1);
+        table[i] = *it;
+    }
+
+    if (! kb->tails.empty())
+        memcpy(tails, kb->tails.data(), kb->tails.size());
+
+    ki->mask  = slots - 1;
+    ki->convCount = convCount;
+    ki->table = table;
+    ki->list  = list;
+    ki->convStart = convStart;
+    ki->tails = tails;
+    return ki;
+}
+
+/*
+ * Return true if input begins with the keyword of ent.  As keyword
+ * characters are never nul a shorter input cannot match.
+ */
+static inline bool kw_matchInput(const KeywordIndex* ki,
+                                 const KeywordEntry* ent, uint32_t inKey,
+                                 const char* input) {
+    if (ent->len >= 4)
+        return ent->key == inKey &&
+               (ent->len == 4 || strncasecmp(ki->tails + ent->tail,
+                                             input + 4, ent->len - 4) == 0);
+    return ent->key == (inKey & ((1u << (ent->len * 8)) - 1));
+}
+
+/*
+ * Return the topic of a conversation which input begins with or NULL if
+ * there is none.  When several topics match the one with the lowest value
+ * (the first in the conversation) is returned.
+ */
+static const KeywordEntry* kwi_lookup(const KeywordIndex* ki, int conv,
+                                      const char* input) {
+    if (! ki || uint32_t(conv) >= ki->convCount)
+        return NULL;
+
+    const KeywordEntry* best = NULL;
+    const KeywordEntry* ent;
+    const KeywordEntry* end;
+    uint32_t inKey = kw_packInput(input);
+
+    ent = ki->list + ki->convStart[conv];
+    end = ki->list + ki->convStart[conv + 1];
+    if (end - ent < KW_HASH_MIN) {
+        // The builders add topics in value order.
+        for (; ent != end; ++ent) {
+            if (kw_matchInput(ki, ent, inKey, input))
+                return ent;
+        }
+        return NULL;
+    }
+
+    int inLen = strlen(input);
+    int len = (inLen > 4) ? 4 : inLen;
+    for (; len >= 0; --len) {
+        uint32_t key = (len < 4) ? inKey & ((1u << (len * 8)) - 1) : inKey;
+        uint32_t i = kw_hash(key, conv) & ki->mask;
+        for (ent = ki->table + i; ent->conv != KW_EMPTY;
+             i = (i + 1) & ki->mask, ent = ki->table + i) {
+            if (ent->key != key || ent->conv != conv)
+                continue;
+            if (ent->len > 4) {
+                if (len != 4 || ent->len > inLen ||
+                    strncasecmp(ki->tails + ent->tail, input + 4,
+                                ent->len - 4) != 0)
+                    continue;
+            } else if (ent->len != len)
+                continue;
+            if (! best || ent->value < best->value)
+                best = ent;
+        }
+    }
+    return best;
+}
+
+/*
+ * Return the conversation number for a name or -1 if it is not found.
+ */
+static int kwi_findName(const KeywordIndex* ki, const char* name) {
+    if (! ki)
+        return -1;
+
+    const KeywordEntry* ent;
+    int len = strlen(name);
+    uint32_t key = kw_packKey(name, len);
+    uint32_t i = kw_nameHash(name, len) & ki->mask;
+    for (ent = ki->table + i; ent->conv != KW_EMPTY;
+         i = (i + 1) & ki->mask, ent = ki->table + i) {
+        if (ent->key == key && ent->conv == KW_NAME_CONV && ent->len == len &&
+            (len <= 4 ||
+             strncasecmp(ki->tails + ent->tail, name + 4, len - 4) == 0))
+            return ent->value;
+    }
+    return -1;
+}
@@ -332,14 +332,42 @@ int U4Talk_load(U4FILE *file, U4Talk* tlk, char* tlkBuf)
     return len;
 }
 
+/*
+ * Index the topics & names of all conversations.
+ * The keyword values are ordered to match the original topic test order.
+ */
+static KeywordIndex* U4Talk_index(const U4Talk* tlk, int count)
+{
+    KeywordBuilder kb;
+    const char* str;
+    for (int i = 0; i < count; ++i, ++tlk) {
+        str = tlk->strings + tlk->name;
+        kwb_add(&kb, KW_NAME_CONV, str, strlen(str), i, 0);
+        if (tlk->topic1) {
+            str = tlk->strings + tlk->topic1;
+            kwb_add(&kb, i, str, strlen(str), 0, QT_KEYWORD1);
+        }
+        if (tlk->topic2) {
+            str = tlk->strings + tlk->topic2;
+            kwb_add(&kb, i, str, strlen(str), 1, QT_KEYWORD2);
+        }
+        kwb_add(&kb, i, "job",  3, 2, QT_JOB);
+        kwb_add(&kb, i, "heal", 4, 3, QT_HEALTH);
+    }
+    return kwb_finish(&kb);
+}
+
 struct U4TalkState {
     TalkState state;
     const U4Talk* tlk;
+    const KeywordIndex* keywords;
+    int conv;
 };
 
 static const char* U4Talk_dialogue(TalkState* ts, int value, const char* input)
 {
-    const U4Talk* tlk = ((U4TalkState*) ts)->tlk;
+    const U4TalkState* uts = (const U4TalkState*) ts;
+    const U4Talk* tlk = uts->tlk;
 
 #define USTR(off)   (tlk->strings + tlk->off)
 #define QUEUE_ASK(TRIGGER) \
@@ -347,32 +375,16 @@ static const char* U4Talk_dialogue(TalkState* ts, int value, const char* input)
         ts->nextOp = OP_PAUSE_ASK;
 
     if (value == DS_KEYWORD) {
-        const char* topic;
-
-        if (tlk->topic1) {
-            topic = USTR(topic1);
-            if (strncasecmp(topic, input, strlen(topic)) == 0) {
-                QUEUE_ASK(QT_KEYWORD1);
-                return USTR(response1);
-            }
-        }
-
-        if (tlk->topic2) {
-            topic = USTR(topic2);
-            if (strncasecmp(topic, input, strlen(topic)) == 0) {
-                QUEUE_ASK(QT_KEYWORD2);
-                return USTR(response2);
+        const KeywordEntry* kw = kwi_lookup(uts->keywords, uts->conv, input);
+        if (kw) {
+            QUEUE_ASK(kw->aux)
+            switch (kw->value) {
+                case 0: return USTR(response1);
+                case 1: return USTR(response2);
+                case 2: return USTR(job);
+                case 3: return USTR(health);
             }
         }
-
-        if (strncasecmp("job", input, 3) == 0) {
-            QUEUE_ASK(QT_JOB)
-            return USTR(job);
-        }
-        if (strncasecmp("heal", input, 4) == 0) {
-            QUEUE_ASK(QT_HEALTH)
-            return USTR(health);
-        }
     } else {
         switch(value) {
             case DS_NAME:
@@ -401,6 +413,8 @@ void talkRunU4Tlk(const Discourse* disc, int conv, Person* person)
     U4TalkState ts;
 
     ts.tlk = ((const U4Talk*) disc->conv.table) + conv;
+    ts.keywords = disc->keywords;
+    ts.conv = conv;
     ts.state.person = person;
     ts.state.turnAway = ts.tlk->turnAway;
     ts.state.nextOp = OP_NOP;
@@ -429,9 +443,51 @@ struct BoronDialogue {
     UThread* ut;
     const UCell* values;
     const UCell* askCell;
+    const KeywordIndex* keywords;
+    int conv;
     UBlockIt topics;
 };
 
+/*
+ * Index the topics & names of all conversations in a talk block.
+ * Topic values are the cell offset in the topics block and aux is the
+ * voice line offset.
+ */
+static KeywordIndex* talkIndexBoron(int32_t discBlkN, int convCount)
+{
+    KeywordBuilder kb;
+    UThread* ut = xu4.config->boronThread();
+    const UCell* values = ur_buffer(discBlkN)->ptr.cell;
+    const UCell* cell;
+    USeriesIter si;
+    UBlockIt bi;
+    int voice;
+
+    for (int i = 0; i < convCount; ++i, values += DI_COUNT) {
+        ur_seriesSlice(ut, &si, values + DI_NAME);
+        kwb_add(&kb, KW_NAME_CONV, si.buf->ptr.c + si.it, si.end - si.it,
+                i, 0);
+
+        ur_blockIt(ut, &bi, values + DI_TOPICS);
+        voice = 0;
+        for (cell = bi.it; cell < bi.end; ) {
+            if (ur_is(cell, UT_STRING)) {
+                ur_seriesSlice(ut, &si, cell);
+                kwb_add(&kb, i, si.buf->ptr.c + si.it, si.end - si.it,
+                        cell - bi.it, voice);
+                cell += 2;
+                voice += 1;
+            } else if (ur_is(cell, UT_WORD)) {
+                // Skip (ask "Question?" ["Yes reply" "No reply"])
+                cell += 3;
+                voice += 3;
+            } else
+                ++cell;
+        }
+    }
+    return kwb_finish(&kb);
+}
+
 static inline bool wordQuestionHumility(UThread* ut, const UCell* cell)
 {
     return strcmp(ur_wordCStr(cell), "ask-humility") == 0;
@@ -445,36 +501,23 @@ static const char* dialogueBoron(TalkState* ts, int value, const char* input)
     UIndex n;
 
     if (value == DS_KEYWORD) {
-        int voiceLine = ts->startVoiceLn + VP_KEYWORD;
-        const UCell* cell = bd->topics.it;
-        const UCell* end  = bd->topics.end;
-
-        while (cell != end) {
-            if (ur_is(cell, UT_STRING)) {
-                ur_seriesSlice(ut, &si, cell);
-                n = si.end - si.it;
-                if (strncasecmp(si.buf->ptr.c + si.it, input, n) == 0) {
-                    ur_seriesSlice(ut, &si, ++cell);
-
-                    // Queue up any following question.
-                    ++cell;
-                    if (cell != end && ur_is(cell, UT_WORD)) {
-                        bd->askCell = cell;
-                        ts->askVoiceLn = voiceLine + 1;
-                        ts->nextOp = OP_PAUSE_ASK;
-                    }
-                    soundSpeakLine(ts->voiceStream, voiceLine);
-                    goto reply;
-                }
-                cell += 2;
-                voiceLine += 1;
-            } else if (ur_is(cell, UT_WORD)) {
-                // Skip (ask "Question?" ["Yes reply" "No reply"])
-                cell += 3;
-                voiceLine += 3;
-            }
+        const KeywordEntry* kw = kwi_lookup(bd->keywords, bd->conv, input);
+        if (! kw)
+            return NULL;
+
+        int voiceLine = ts->startVoiceLn + VP_KEYWORD + kw->aux;
+        const UCell* cell = bd->topics.it + kw->value;
+        ur_seriesSlice(ut, &si, ++cell);
+
+        // Queue up any following question.
+        ++cell;
+        if (cell != bd->topics.end && ur_is(cell, UT_WORD)) {
+            bd->askCell = cell;
+            ts->askVoiceLn = voiceLine + 1;
+            ts->nextOp = OP_PAUSE_ASK;
         }
-        return NULL;
+        soundSpeakLine(ts->voiceStream, voiceLine);
+        goto reply;
     }
 
     switch (value) {
@@ -511,7 +554,8 @@ reply:
     return si.buf->ptr.c + si.it;
 }
 
-void talkRunBoron(int32_t discBlkN, int conv, Person* person)
+void talkRunBoron(const Discourse* disc, int32_t discBlkN, int conv,
+                  Person* person)
 {
     BoronDialogue bd;
     UThread* ut = xu4.config->boronThread();
@@ -520,6 +564,8 @@ void talkRunBoron(int32_t discBlkN, int conv, Person* person)
     bd.ut = ut;
     bd.values = blk->ptr.cell + conv * DI_COUNT;
     bd.askCell = NULL;
+    bd.keywords = disc->keywords;
+    bd.conv = conv;
     ur_blockIt(ut, &bd.topics, bd.values + DI_TOPICS);
 
     {
@@ -538,6 +584,32 @@ void talkRunBoron(int32_t discBlkN, int conv, Person* person)
     runTalkDialogue(dialogueBoron, &bd.state);
 }
 
+static int talkVoicesBoron(int32_t discBlkN, int convCount, uint16_t* ids,
+                           int limit)
+{
+    UThread* ut = xu4.config->boronThread();
+    const UCell* data = ur_buffer(discBlkN)->ptr.cell + DI_DATA;
+    int count = 0;
+    int i, n, stream;
+
+    for (i = 0; i < convCount; ++i, data += DI_COUNT) {
+        stream = data->coord.n[1];
+        if (! stream)
+            continue;
+        ++stream;       // Config::musicFile() id is one based.
+        for (n = 0; n < count; ++n) {
+            if (ids[n] == stream)
+                break;
+        }
+        if (n == count) {
+            if (count == limit)
+                break;
+            ids[count++] = stream;
+        }
+    }
+    return count;
+}
+
 const char* talkNameBoron(int32_t discBlkN, int conv)
 {
     UThread* ut = xu4.config->boronThread();
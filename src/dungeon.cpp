@@ -288,6 +288,7 @@ bool dungeonHandleTrap(TrapType trap) {
 pit_damage:
         c->party->applyEffect(ALL_PLAYERS, dungeon, EFFECT_ROCKS);
         screenShake(3);     // NOTE: In the DOS version only the view shakes.
+        EventHandler::waitEffects();
         break;
     default: break;
     }
@@ -4,6 +4,8 @@
 
 #include <cassert>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <list>
 
@@ -21,48 +23,229 @@
 
 using std::string;
 
-#ifdef DEBUG
 #include "irecord.c"
-#endif
+#include "timedevent.cpp"
+
+extern int64_t usecTicks();
+extern void msecSleep(uint32_t);
+
+#define SIM_MAX_STEPS   8       // Limit on simulation catch-up per frame.
+#define SPIN_USEC       1500    // Busy wait this long before frame deadline.
+#define REPLAY_SPEED_MAX 64     // Fastest replay rate multiplier.
 
-static void frameSleepInit(FrameSleep* fs, int frameDuration) {
-    fs->frameInterval = frameDuration;
-    fs->realTime = 0;
-    for (int i = 0; i < 8; ++i)
-        fs->ftime[i] = frameDuration;
-    fs->ftimeSum = frameDuration * 8;
-    fs->ftimeIndex = 0;
-    fs->fsleep = frameDuration - 6;
+static void frameClockReset(FrameClock* fc) {
+    fc->lastTime = usecTicks();
+    fc->deadline = fc->lastTime + fc->frameInterval;
+    fc->simTime  = fc->frameInterval;   // Run one step immediately.
+    fc->frameDelta = 0.0f;
+}
+
+static void frameClockInit(FrameClock* fc, int framesPerSecond) {
+    fc->frameInterval = 1000000 / framesPerSecond;
+    fc->frames = fc->missed = 0;
+    fc->speed = 1;
+    frameClockReset(fc);
+}
+
+/*
+ * Accumulate the real time elapsed since the previous frame.
+ * The simulation time is scaled by the speed multiplier.
+ */
+static void frameClockBegin(FrameClock* fc) {
+    int64_t now = usecTicks();
+    int64_t elapsed = now - fc->lastTime;
+    int64_t limit = int64_t(fc->frameInterval) * SIM_MAX_STEPS;
+
+    fc->lastTime = now;
+    if (elapsed > limit)
+        elapsed = limit;
+    fc->simTime += uint32_t(elapsed) * fc->speed;
+    fc->frameDelta = float(elapsed) * 0.000001f;
+}
+
+/*
+ * Wait for the next frame deadline.  The thread sleeps until shortly before
+ * the deadline and then spins to hit it accurately.  Deadlines advance by a
+ * fixed interval so that the frame rate does not drift.  If screenSwapBuffers
+ * blocked on vsync past the deadline then no wait occurs.
+ *
+ * Return non-zero if waitTime has been reached or passed.
+ */
+static int frameClockWait(FrameClock* fc, int64_t waitTime) {
+    int64_t now = usecTicks();
+    int64_t deadline = fc->deadline;
+    int64_t remain = deadline - now;
+
+    ++fc->frames;
+    if (remain < 0) {
+        ++fc->missed;
+        // When more than a frame behind, resynchronize rather than rush
+        // through a series of late frames.
+        if (remain < -int64_t(fc->frameInterval))
+            deadline = now;
+    }
+    fc->deadline = deadline + fc->frameInterval;
+
+    if (waitTime && now >= waitTime)
+        return 1;
+    if (remain > SPIN_USEC)
+        msecSleep(uint32_t(remain - SPIN_USEC) / 1000);
+    while (usecTicks() < deadline)
+        ;
+    return 0;
+}
+
+static void effectTimerDone(void* data, uint32_t fid) {
+    ((QueuedEffect*) data)[fid - 1].done = 1;
 }
 
 /**
  * Constructs the event handler object.
  */
-EventHandler::EventHandler(int gameCycleDuration, int frameDuration) :
-    timerInterval(gameCycleDuration),
+EventHandler::EventHandler(int gameCyclesPerSecond, int framesPerSecond) :
+    tickUsec(1000000),
+    tickScale(gameCyclesPerSecond),
     runRecursion(0),
+    seekTurn(0),
+    replayTurn(0),
+    replayHold(false),
+    replayStep(false),
+    replayJumped(false),
+    replayDesync(false),
+    effectCount(0),
+    effectUsed(0),
     updateScreen(NULL)
 {
     controllerDone = ended = paused = false;
+    for (int i = 0; i < EFFECT_QUEUE_MAX; ++i)
+        effects[i].func = NULL;
     anim_init(&flourishAnim, 64, NULL, NULL);
-    anim_init(&fxAnim, 32, NULL, NULL);
-    frameSleepInit(&fs, frameDuration);
-
-#ifdef DEBUG
+    anim_init(&fxAnim, 32, effectTimerDone, effects);
+    frameClockInit(&fs, framesPerSecond);
     irec_init(&inputRec);
-#endif
 }
 
 EventHandler::~EventHandler() {
-#ifdef DEBUG
     irec_endRecording(&inputRec);
-#endif
+    // Always report if more than a tenth of the frames were late.
+    if (fs.missed && (xu4.verbose || fs.missed * 10 > fs.frames))
+        fprintf(stderr, "Missed %d of %d frame deadlines\n",
+                fs.missed, fs.frames);
     anim_free(&flourishAnim);
     anim_free(&fxAnim);
 }
 
+//----------------------------------------------------------------------------
+
+static void endEffect(QueuedEffect* fx) {
+    void (*func)(QueuedEffect*, float) = fx->func;
+    fx->func = NULL;
+    func(fx, 1.0f);
+}
+
+/*
+ * Start a visual effect.  The game does not wait for it; use waitEffects()
+ * where the rules require an effect to be seen before play continues.
+ *
+ * If the queue is full the effect is ended immediately.
+ */
+void EventHandler::queueEffect(const QueuedEffect* fx) {
+    QueuedEffect* it = effects;
+    QueuedEffect* end = effects + EFFECT_QUEUE_MAX;
+    float start[2] = { 0.0f, 0.0f };
+    float stop[2]  = { 1.0f, 0.0f };
+
+    for (; it != end; ++it) {
+        if (! it->func)
+            break;
+    }
+    if (it == end) {
+        QueuedEffect tmp = *fx;
+        tmp.func(&tmp, 1.0f);
+        return;
+    }
+
+    *it = *fx;
+    it->done = 0;
+    it->timer = ANIM_UNUSED;
+    if (fx->duration > 0.0f)
+        it->timer = anim_startLinearF2(&fxAnim, fx->duration,
+                                       (it - effects) + 1, start, stop);
+    if (it->timer == ANIM_UNUSED) {
+        endEffect(it);
+        return;
+    }
+
+    ++effectCount;
+    if (it - effects >= effectUsed)
+        effectUsed = (it - effects) + 1;
+}
+
+/*
+ * Advance the fxAnim animations and update queued effects.
+ * This is called once per rendered frame.
+ */
+void EventHandler::advanceEffects(float seconds) {
+    anim_advance(&fxAnim, seconds);
+
+    if (effectCount) {
+        QueuedEffect* it  = effects;
+        QueuedEffect* end = effects + effectUsed;
+        for (; it != end; ++it) {
+            if (! it->func)
+                continue;
+            if (it->done) {
+                // The timer has already been released by anim_advance.
+                endEffect(it);
+                --effectCount;
+            } else {
+                it->func(it, anim_valueF2(&fxAnim, it->timer)[0]);
+            }
+        }
+        if (! effectCount)
+            effectUsed = 0;
+    }
+}
+
+/*
+ * End all queued effects now.  This must be called before the map view
+ * changes.
+ */
+void EventHandler::finishEffects() {
+    QueuedEffect* it  = effects;
+    QueuedEffect* end = effects + effectUsed;
+    for (; it != end; ++it) {
+        if (it->func) {
+            if (! it->done)
+                anim_setState(&fxAnim, it->timer, ANIM_FREE);
+            endEffect(it);
+        }
+    }
+    effectCount = effectUsed = 0;
+}
+
+/*
+ * Rescale the partial tick time when the tick period changes.
+ */
+static uint32_t rescaleRunTime(uint32_t runTime, uint32_t from, uint32_t to) {
+    return uint32_t(uint64_t(runTime) * to / from);
+}
+
 void EventHandler::setTimerInterval(int msecs) {
-    timerInterval = msecs;
+    runTime = rescaleRunTime(runTime, tickScale, 1);
+    tickUsec  = msecs * 1000;
+    tickScale = 1;
+}
+
+/*
+ * Set the timedEvents rate.  The period is kept as the fraction
+ * 1000000 / ticksPerSecond usec so that rates which do not divide evenly
+ * into a second do not drift.
+ */
+void EventHandler::setTimerRate(int ticksPerSecond) {
+    runTime = rescaleRunTime(runTime, tickScale, ticksPerSecond);
+    tickUsec  = 1000000;
+    tickScale = ticksPerSecond;
 }
 
 void EventHandler::runController(Controller* con) {
@@ -225,61 +408,47 @@ bool EventHandler::runPause() {
 }
 
 /*
- * Return non-zero if waitTime has been reached or passed.
+ * Run fixed timestep simulation steps to catch up with real time.
+ * Each step processes any recorded input and advances timedEvents by
+ * one frameInterval, so the game cycle rate does not depend upon how long
+ * rendering takes.  Nothing is run while a replay is held.
  */
-static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
-    uint32_t now;
-    int32_t elapsed, elapsedLimit, frameAdjust;
-    int i;
+void EventHandler::simulate(Controller* waitCon) {
+    uint32_t interval = tickUsec ? tickUsec : fs.frameInterval * tickScale;
+    int steps = 0;
 
-    now = getTicks();
-    elapsed = now - fs->realTime;
-    fs->realTime = now;
-
-    elapsedLimit = fs->frameInterval * 8;
-    if (elapsed > elapsedLimit)
-        elapsed = elapsedLimit;
-
-    i = fs->ftimeIndex;
-    fs->ftimeSum += elapsed - fs->ftime[i];
-    fs->ftime[i] = elapsed;
-    fs->ftimeIndex = i ? i - 1 : FS_SAMPLES - 1;
-
-    frameAdjust = int(fs->frameInterval) - fs->ftimeSum / FS_SAMPLES;
-#if 0
-    // Adjust by 1 msec.
-    if (frameAdjust > 0) {
-        if (fs->fsleep < fs->frameInterval - 1)
-            ++fs->fsleep;
-    } else if (frameAdjust < 0) {
-        if (fs->fsleep)
-            --fs->fsleep;
-    }
-#else
-    // Adjust by 2 msec.
-    if (frameAdjust > 0) {
-        if (frameAdjust > 2)
-            frameAdjust = 2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        int limit = fs->frameInterval - 1;
-        fs->fsleep = (sa > limit) ? limit : sa;
-    } else if (frameAdjust < 0) {
-        if (frameAdjust < -2)
-            frameAdjust = -2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        fs->fsleep = (sa < 0) ? 0 : sa;
+    if (replayHold && ! replayStep) {
+        fs.simTime = 0;
+        return;
     }
-#endif
 
-    if (waitTime && now >= waitTime)
-        return 1;
-#if 0
-    printf("KR fsleep %d ela:%d avg:%d adj:%d\n",
-           fs->fsleep, elapsed, fs->ftimeSum / FS_SAMPLES, frameAdjust);
-#endif
-    if (fs->fsleep)
-        msecSleep(fs->fsleep);
-    return 0;
+    while (fs.simTime >= fs.frameInterval) {
+        if (++steps > SIM_MAX_STEPS * int(fs.speed)) {
+            fs.simTime = 0;     // Too far behind; drop the excess.
+            break;
+        }
+        fs.simTime -= fs.frameInterval;
+
+        int key;
+        while ((key = recordedKey())) {
+            if (waitCon)
+                waitCon->notifyKeyPressed(key);
+            else if (getController()->notifyKeyPressed(key) && updateScreen)
+                (*updateScreen)();
+        }
+        if (replayJumped)
+            break;      // Resume this step after the game is reloaded.
+        recordTick();
+
+        runTime += fs.frameInterval * tickScale;
+        while (runTime >= interval && ! replayJumped) {
+            runTime -= interval;
+            timedEvents.tick();
+        }
+
+        if (ended || controllerDone)
+            break;
+    }
 }
 
 /**
@@ -296,24 +465,16 @@ static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
 bool EventHandler::wait_msecs(unsigned int msec) {
     Controller waitCon;     // Base controller consumes key events.
     EventHandler* eh = xu4.eventHandler;
-    uint32_t waitTime = getTicks() + msec;
+    int64_t waitTime = usecTicks() + int64_t(msec) * 1000 / eh->fs.speed;
 
     while (! eh->ended) {
+        notify_dispatchPosts(&xu4.notifyBus);
         eh->handleInputEvents(&waitCon, NULL);
-#ifdef DEBUG
-        int key;
-        while ((key = eh->recordedKey()))
-            waitCon.notifyKeyPressed(key);
-        eh->recordTick();
-#endif
-        if (eh->runTime >= eh->timerInterval) {
-            eh->runTime -= eh->timerInterval;
-            eh->timedEvents.tick();
-        }
-        eh->runTime += eh->fs.frameInterval;
+        frameClockBegin(&eh->fs);
+        eh->simulate(&waitCon);
 
         screenSwapBuffers();
-        if (frameSleep(&eh->fs, waitTime))
+        if (frameClockWait(&eh->fs, waitTime))
             break;
     }
 
@@ -321,143 +482,211 @@ bool EventHandler::wait_msecs(unsigned int msec) {
 }
 
 /*
- * Execute the game with a deterministic loop until the current controller
- * is done or the game exits.
- *
- * \return true if game should exit.
+ * Record a checksum of the game state or, when replaying, verify that the
+ * state matches the recording.  The first difference is reported.
  */
-bool EventHandler::run() {
-    if (updateScreen)
-        (*updateScreen)();
-
-    if (! runRecursion) {
-        runTime = 0;
-        fs.realTime = getTicks();
-    }
-    ++runRecursion;
-
-resume:
-    while (! ended && ! controllerDone) {
-        handleInputEvents(NULL, updateScreen);
-#ifdef DEBUG
-        int key;
-        while ((key = recordedKey())) {
-            if (getController()->notifyKeyPressed(key) && updateScreen)
-                (*updateScreen)();
-        }
-        recordTick();
-#endif
-        if (runTime >= timerInterval) {
-            runTime -= timerInterval;
-            timedEvents.tick();
-        }
-        runTime += fs.frameInterval;
-
-        screenSwapBuffers();
-        frameSleep(&fs, 0);
+void EventHandler::checkState(uint32_t turn, uint32_t sum) {
+    if (replayDesync)
+        return;
+    if (! irec_checksum(&inputRec, turn, sum)) {
+        fprintf(stderr, "Replay desync at turn %u (state %08X, recorded %08X"
+                " for turn %u)\n", turn, sum, inputRec.sumValue,
+                inputRec.sumTurn);
+        replayDesync = true;
     }
+}
 
-    if (paused && ! runPause())
-        goto resume;
+/*
+ * Handle a live key press during replay.
+ *
+ *   +/-     Double or halve the replay speed.
+ *   Space   Hold or resume the replay.
+ *   . or s  Hold and then run one turn.
+ *   > or <  Jump to the next or previous keyframe.
+ *
+ * Keys which pause or quit the program are passed through.
+ *
+ * \return true if the key was consumed and must not be given to a controller.
+ */
+bool EventHandler::replayControl(int key) {
+    const IRecKeyframe* frames = inputRec.frames;
+    uint32_t i;
 
-    --runRecursion;
-    return ended;
-}
+    if (! replaying())
+        return false;
 
-//----------------------------------------------------------------------------
+    switch (key) {
+    case U4_PAUSE:
+    case U4_ALT + 'p':
+    case U4_ALT + 'x':
+    case U4_META + 'q':
+    case U4_META + 'x':
+        return false;
 
-/* TimedEvent functions */
-TimedEvent::TimedEvent(TimedEvent::Callback cb, int i, void *d) :
-    callback(cb),
-    data(d),
-    interval(i),
-    current(0)
-{}
+    case '+':
+    case '=':
+        if (fs.speed < REPLAY_SPEED_MAX)
+            fs.speed *= 2;
+        break;
+    case '-':
+        if (fs.speed > 1)
+            fs.speed /= 2;
+        break;
 
-TimedEvent::Callback TimedEvent::getCallback() const    { return callback; }
-void *TimedEvent::getData()                             { return data; }
+    case ' ':
+        replayHold = ! replayHold;
+        replayStep = false;
+        break;
+    case '.':
+    case 's':
+        replayHold = replayStep = true;
+        break;
 
-/**
- * Advances the timed event forward a tick.
- * When (current >= interval), then it executes its callback function.
- */
-void TimedEvent::tick() {
-    if (++current >= interval) {
-        (*callback)(data);
-        current = 0;
+    case '>':
+        for (i = 0; i < inputRec.frameCount; ++i) {
+            if (frames[i].turn > replayTurn) {
+                replaySeek(frames[i].turn);
+                break;
+            }
+        }
+        break;
+    case '<':
+        for (i = inputRec.frameCount; i > 0; --i) {
+            if (frames[i-1].turn < replayTurn) {
+                replaySeek(frames[i-1].turn);
+                break;
+            }
+        }
+        break;
     }
+    return true;
 }
 
-/**
- * Destructs a timed event manager object.
+/*
+ * Run the replay at maximum speed until the given turn is reached.
+ * The replay is then held.
  */
-TimedEventMgr::~TimedEventMgr() {
-    while(! events.empty()) {
-        delete events.front(), events.pop_front();
-    }
-    while(! deferredRemovals.empty()) {
-        delete deferredRemovals.front(), deferredRemovals.pop_front();
-    }
+void EventHandler::replaySeek(uint32_t turn) {
+    seekTurn = turn;
+    fs.speed = REPLAY_SPEED_MAX;
+    replayHold = replayStep = false;
 }
 
-/**
- * Adds a timed event to the event queue.
+/*
+ * Notify the replay controls that a game turn has ended.
  */
-void TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
-    events.push_back(new TimedEvent(callback, interval, data));
+void EventHandler::replayTurnDone(uint32_t turn) {
+    replayTurn = turn;
+    if (seekTurn && turn >= seekTurn) {
+        seekTurn = 0;
+        fs.speed = 1;
+        replayHold = true;
+    }
+    replayStep = false;
 }
 
-/**
- * Removes a timed event from the event queue.
+/*
+ * Jump to the keyframe which gets a seeking replay closest to its target.
+ * The caller must restore the keyframe data and reload the game so that
+ * the replay can continue from the time the keyframe was recorded.
+ *
+ * \param turn  The turn which has just ended.
+ * \param size  Set to the byte size of the returned data.
+ *
+ * \return Pointer to keyframe data or NULL if playing ahead is closer to
+ *         the target.
  */
-TimedEventMgr::List::iterator TimedEventMgr::remove(List::iterator i) {
-    if (isLocked()) {
-        deferredRemovals.push_back(*i);
-        return i;
-    }
-    else {
-        delete *i;
-        return events.erase(i);
-    }
-}
+const uint8_t* EventHandler::replaySeekKeyframe(uint32_t turn, uint32_t* size) {
+    const IRecKeyframe* frames = inputRec.frames;
+    const uint8_t* data;
+    uint32_t i;
+
+    if (! seekTurn || turn == seekTurn)
+        return NULL;
 
-void TimedEventMgr::remove(TimedEvent* event) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i) == event) {
-            remove(i);
+    for (i = inputRec.frameCount; i > 0; --i) {
+        if (frames[i-1].turn <= seekTurn)
             break;
-        }
     }
+    if (! i || (turn < seekTurn && frames[i-1].turn <= turn))
+        return NULL;
+
+    data = irec_seekKeyframe(&inputRec, i-1, size);
+    if (data) {
+        replayTurn = frames[i-1].turn;
+        replayJumped = true;
+        replayDesync = false;
+        if (replayTurn == seekTurn)
+            replayTurnDone(replayTurn);
+    }
+    return data;
 }
 
-void TimedEventMgr::remove(TimedEvent::Callback callback, void *data) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i)->getCallback() == callback && (*i)->getData() == data) {
-            remove(i);
-            break;
+/**
+ * Delays program execution until all queued effects have finished.
+ *
+ * \return true if game should exit.
+ */
+bool EventHandler::waitEffects() {
+    EventHandler* eh = xu4.eventHandler;
+    const QueuedEffect* it  = eh->effects;
+    const QueuedEffect* end = it + eh->effectUsed;
+    float remain = 0.0f;
+    float t;
+
+    for (; it != end; ++it) {
+        if (it->func && ! it->done) {
+            t = it->duration *
+                (1.0f - anim_valueF2(&eh->fxAnim, it->timer)[0]);
+            if (t > remain)
+                remain = t;
         }
     }
+
+    if (remain > 0.0f && wait_msecs((unsigned int) (remain * 1000.0f)))
+        return true;
+    eh->finishEffects();
+    return eh->ended;
 }
 
-/**
- * Runs each of the callback functions of the TimedEvents associated with this manager.
+/*
+ * Execute the game with a deterministic loop until the current controller
+ * is done or the game exits.
+ *
+ * \return true if game should exit.
  */
-void TimedEventMgr::tick() {
-    List::iterator i;
+bool EventHandler::run() {
+    if (updateScreen)
+        (*updateScreen)();
+
+    if (! runRecursion) {
+        // After a replay keyframe is loaded the runTime is already set.
+        if (replayJumped)
+            replayJumped = false;
+        else
+            runTime = 0;
+        frameClockReset(&fs);
+    }
+    ++runRecursion;
 
-    // Lock the event list so it cannot be modified during iteration.
-    locked = true;
+resume:
+    while (! ended && ! controllerDone) {
+        notify_dispatchPosts(&xu4.notifyBus);
+        handleInputEvents(NULL, updateScreen);
+        frameClockBegin(&fs);
+        simulate(NULL);
 
-    for (i = events.begin(); i != events.end(); i++)
-        (*i)->tick();
+        screenSwapBuffers();
+        frameClockWait(&fs, 0);
+    }
 
-    locked = false;
+    if (paused && ! runPause()) {
+        frameClockReset(&fs);
+        goto resume;
+    }
 
-    // Remove events that have been deferred for removal
-    for (i = deferredRemovals.begin(); i != deferredRemovals.end(); i++)
-        events.remove(*i);
+    --runRecursion;
+    return ended;
 }
 
 void EventHandler::pushMouseAreaSet(const MouseArea *mouseAreas) {
@@ -11,11 +11,11 @@
 
 #include "anim.h"
 #include "controller.h"
+#include "coords.h"
+#include "timedevent.h"
 #include "types.h"
 
-#ifdef DEBUG
 #include "irecord.h"
-#endif
 
 #define U4_UP           '['
 #define U4_DOWN         '/'
@@ -58,67 +58,34 @@ struct InputEvent {
 
 //----------------------------------------------------------------------------
 
-/**
- * A class for handling timed events.
- */
-class TimedEvent {
-public:
-    /* Typedefs */
-    typedef void (*Callback)(void *);
-
-    /* Constructors */
-    TimedEvent(Callback callback, int interval, void *data = NULL);
-
-    /* Member functions */
-    Callback getCallback() const;
-    void *getData();
-    void tick();
-
-    /* Properties */
-protected:
-    Callback callback;
-    void *data;
-    int interval;
-    int current;
+struct FrameClock {
+    int64_t  deadline;          // Usec time when the next frame is due.
+    int64_t  lastTime;          // Usec time of the previous frame.
+    uint32_t frameInterval;     // Microseconds between display updates.
+    uint32_t simTime;           // Usec of real time not yet simulated.
+    uint32_t frames;
+    uint32_t missed;            // Frames which began after their deadline.
+    float    frameDelta;        // Seconds elapsed for the current frame.
+    uint32_t speed;             // Simulation rate multiplier (for replays).
 };
 
-
-/**
- * A class for managing timed events
+/*
+ * A visual effect which runs for a fixed time without blocking the game.
+ * The function is called every frame with the fraction of the duration
+ * elapsed, and once with 1.0 when the effect ends.  The id, arg & pos
+ * members are for use by the function.
  */
-class TimedEventMgr {
-public:
-    typedef std::list<TimedEvent*> List;
-
-    TimedEventMgr() : locked(false) {}
-    ~TimedEventMgr();
-
-    /** Returns true if the event list is locked (in use) */
-    bool isLocked() const { return locked; }
-
-    void add(TimedEvent::Callback callback, int interval, void *data = NULL);
-    List::iterator remove(List::iterator i);
-    void remove(TimedEvent* event);
-    void remove(TimedEvent::Callback callback, void *data = NULL);
-    void tick();
-
-private:
-    /* Properties */
-    bool locked;
-    List events;
-    List deferredRemovals;
+struct QueuedEffect {
+    void (*func)(QueuedEffect*, float frac);
+    float  duration;            // Seconds
+    AnimId timer;               // fxAnim value which tracks the duration.
+    uint16_t done;
+    int    id;
+    int    arg;
+    Coords pos;
 };
 
-#define FS_SAMPLES  8
-
-struct FrameSleep {
-    uint32_t frameInterval;     // Milliseconds between display updates.
-    uint32_t realTime;
-    int ftime[FS_SAMPLES];      // Msec elapsed for past frames.
-    int ftimeSum;
-    uint16_t ftimeIndex;
-    uint16_t fsleep;            // Msec to sleep - adjusted slowly.
-};
+#define EFFECT_QUEUE_MAX    16
 
 typedef void(*updateScreenCallback)(void);
 
@@ -131,7 +98,7 @@ class TextView;
 class EventHandler {
 public:
     /* Constructors */
-    EventHandler(int gameCycleDuration, int frameDuration);
+    EventHandler(int gameCyclesPerSecond, int framesPerSecond);
     ~EventHandler();
 
     /* Static user input functions. */
@@ -146,6 +113,7 @@ public:
     static void waitAnyKey();
     static void waitAnyKeyTimeout();
     static bool wait_msecs(unsigned int msecs);
+    static bool waitEffects();
     static void ignoreInput();
 
     /* Static functions */
@@ -156,7 +124,10 @@ public:
 
     /* Member functions */
     void setTimerInterval(int msecs);
-    uint32_t getTimerInterval() const { return timerInterval; }
+    void setTimerRate(int ticksPerSecond);
+    uint32_t getTimerInterval() const { return tickUsec / (tickScale * 1000); }
+    float    getFrameDelta() const { return fs.frameDelta; }
+    uint32_t getMissedFrames() const { return fs.missed; }
     TimedEventMgr* getTimer();
 
     /* Event functions */
@@ -181,7 +152,7 @@ public:
     const _MouseArea* getMouseAreaSet() const;
     const _MouseArea* mouseAreaForPoint(int x, int y) const;
 
-#ifdef DEBUG
+    /* Input recording functions */
     bool beginRecording(const char* file, uint32_t seed) {
         return irec_beginRecording(&inputRec, file, seed);
     }
@@ -190,6 +161,8 @@ public:
         irec_recordKey(&inputRec, key & ~modMask, (key & modMask) >> 4);
     }
     int  recordedKey() {
+        if (replayJumped)
+            return 0;
         uint32_t keym = irec_recordedKey(&inputRec);
         return IREC_KEY(keym) | (IREC_MOD(keym) << 4);
     }
@@ -197,30 +170,61 @@ public:
     uint32_t replay(const char* file) {
         return irec_replay(&inputRec, file);
     }
-#endif
+    bool recordingInput() const { return inputRec.fd >= 0; }
+    void checkState(uint32_t turn, uint32_t sum);
+    void recordKeyframe(uint32_t turn, const void* data, uint32_t size) {
+        irec_recordKeyframe(&inputRec, turn, data, size);
+    }
+
+    /* Replay control functions */
+    bool replaying() const { return inputRec.mode == IREC_REPLAY; }
+    bool replayControl(int key);
+    void replaySeek(uint32_t turn);
+    void replayTurnDone(uint32_t turn);
+    const uint8_t* replayKeyframe(uint32_t turn, uint32_t* size) {
+        return irec_keyframe(&inputRec, turn, size);
+    }
+    const uint8_t* replaySeekKeyframe(uint32_t turn, uint32_t* size);
+    uint32_t getRunTime() const { return runTime; }
+    void setRunTime(uint32_t usec) { runTime = usec; }
 
     void advanceFlourishAnim() {
-        anim_advance(&flourishAnim, float(timerInterval) * 0.001f);
+        anim_advance(&flourishAnim, float(tickUsec) / tickScale * 0.000001f);
     }
 
+    /* Effect queue functions */
+    void queueEffect(const QueuedEffect*);
+    void advanceEffects(float seconds);
+    void finishEffects();
+    int  effectsQueued() const { return effectCount; }
+
     Animator flourishAnim;
     Animator fxAnim;
 
 protected:
     void handleInputEvents(Controller*, updateScreenCallback);
     bool runPause();
+    void simulate(Controller*);
 
-    FrameSleep fs;
-    uint32_t timerInterval;     // Milliseconds between timedEvents ticks.
-    uint32_t runTime;
+    FrameClock fs;
+    uint32_t tickUsec;          // Usec between timedEvents ticks * tickScale.
+    uint32_t tickScale;         // Divisor of tickUsec & runTime.
+    uint32_t runTime;           // Usec * tickScale simulated since last tick.
     int runRecursion;
+    uint32_t seekTurn;          // Replay target turn or zero if not seeking.
+    uint32_t replayTurn;        // Last turn completed during replay.
+    bool replayHold;            // Replay is paused between turns.
+    bool replayStep;            // Run replay until the next turn ends.
+    bool replayJumped;          // Keyframe loaded; game must be reloaded.
+    bool replayDesync;          // Replay desync has been reported.
     bool paused;
     bool controllerDone;
     bool ended;
-#ifdef DEBUG
     InputRecorder inputRec;
-#endif
     TimedEventMgr timedEvents;
+    int effectCount;
+    int effectUsed;
+    QueuedEffect effects[EFFECT_QUEUE_MAX];
     std::vector<Controller *> controllers;
     std::list<const _MouseArea*> mouseAreaSets;
     updateScreenCallback updateScreen;
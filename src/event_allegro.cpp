@@ -68,9 +68,9 @@ static void handleKeyDownEvent(const ALLEGRO_EVENT* event,
             break;
     }
 
-#ifdef DEBUG
+    if (xu4.eventHandler->replayControl(key))
+        return;
     xu4.eventHandler->recordKey(key);
-#endif
 
     if (xu4.verbose) {
         printf("key event: unicode = %d, sym = %d, mod = %d; translated = %d\n",
@@ -57,9 +57,9 @@ static void handleKeyDownEvent(const SDL_Event &event, Controller *controller, u
         key = U4_FKEY + (event.key.keysym.sym - SDLK_F1);
 #endif
 
-#ifdef DEBUG
+    if (xu4.eventHandler->replayControl(key))
+        return;
     xu4.eventHandler->recordKey(key);
-#endif
 
     if (xu4.verbose)
         printf("key event: unicode = %d, sym = %d, mod = %d; translated = %d\n",
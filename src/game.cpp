@@ -2,6 +2,7 @@
  * game.cpp
  */
 
+#include <cstring>
 #include "game.h"
 
 #include "camp.h"
@@ -13,6 +14,7 @@
 #include "death.h"
 #include "debug.h"
 #include "error.h"
+#include "filesystem.h"
 #include "image32.h"
 #include "gpu.h"
 #include "intro.h"
@@ -33,6 +35,8 @@
 #include "weapon.h"
 #include "xu4.h"
 
+extern "C" uint32_t murmurHash3_32(const uint8_t* data, int len, uint32_t seed);
+
 /*-----------------*/
 /* Functions BEGIN */
 
@@ -67,6 +71,31 @@ static void gameCreatureAttack(Creature *obj);
 
 Context *c = NULL;
 
+#define KEYFRAME_TURNS  50      // Turns between replay keyframes.
+
+/*
+ * Replay keyframe state which is not held in the saved game files.
+ * The SaveSet data follows this in the keyframe.
+ */
+struct GameKeyframe {
+    uint32_t seed;
+    uint32_t runTime;
+    int32_t  moonPhase;
+    int32_t  windDirection;
+    int32_t  windCounter;
+    int32_t  windLock;
+    int32_t  horseSpeed;
+    int32_t  auraType;
+    int32_t  auraDuration;
+    uint32_t commandTimer;
+    uint32_t size[SAVE_FILE_COUNT];
+};
+
+static GameKeyframe pendingKeyframe;    // Applied once the game is reloaded.
+static bool keyframePending = false;
+
+static void gameApplyKeyframe(const GameKeyframe*);
+
 static const MouseArea mouseAreas[] = {
     {3, {{  8,  8}, {  8, 184}, {96, 96}}, MC_WEST,  {U4_ENTER, 0, U4_LEFT}},
     {3, {{  8,  8}, {184,   8}, {96, 96}}, MC_NORTH, {U4_ENTER, 0, U4_UP}},
@@ -79,8 +108,13 @@ GameController::GameController() : TurnController(1),
     mapArea(BORDER_WIDTH, BORDER_HEIGHT, VIEWPORT_W, VIEWPORT_H),
     cutScene(false),
     borderAttr(NULL),
-    borderAttrLen(0)
+    borderAttrLen(0),
+    snapHead(0),
+    snapUsed(0),
+    snapUnflushed(0),
+    reloadSaveGame(false)
 {
+    memset(snapshots, 0, sizeof(snapshots));
     gs_listen(1<<SENDER_LOCATION | 1<<SENDER_PARTY, gameNotice, this);
 
     // Vendor scripts are shared by all cities.
@@ -95,6 +129,8 @@ GameController::~GameController() {
     discourse_free(&castleDisc);
 
     free(borderAttr);
+    for (int i = 0; i < SNAPSHOT_COUNT; ++i)
+        free(snapshots[i].set.buf);
 
     delete c;
     c = NULL;
@@ -103,8 +139,26 @@ GameController::~GameController() {
 bool GameController::present() {
     xu4.screenImage->fill(Image::black);
 
-    if (c == NULL || (xu4.intro && xu4.intro->hasInitiatedNewGame()))
-        return initContext();   // Loads current savegame
+    if (reloadSaveGame) {
+        // Restoring a snapshot; replace the current game.
+        reloadSaveGame = false;
+        delete c;
+        c = NULL;
+        delete xu4.saveGame;
+        xu4.saveGame = NULL;
+    }
+
+    if (c == NULL || (xu4.intro && xu4.intro->hasInitiatedNewGame())) {
+        bool loaded = initContext();    // Loads current savegame
+        saveGameRestoreFrom(NULL, NULL);
+        if (! loaded)
+            return false;
+        if (keyframePending) {
+            keyframePending = false;
+            gameApplyKeyframe(&pendingKeyframe);
+        }
+        return true;
+    }
 
     // Inits screen stuff without renewing game
     initScreenWithoutReloadingState();
@@ -115,6 +169,7 @@ bool GameController::present() {
 void GameController::conclude() {
     if (borderAttr)
         screenSetLayer(LAYER_HUD, NULL, NULL);
+    xu4.eventHandler->finishEffects();
     mapArea.clear();
     xu4.eventHandler->popMouseAreaSet();
     screenSetMouseCursor(MC_DEFAULT);
@@ -174,8 +229,6 @@ public:
  * Return true if loading is successful.
  */
 bool GameController::initContext() {
-    const Settings& settings = *xu4.settings;
-
     ProgressBar pb((320/2) - (200/2), (200/2), 200, 10, 0, 4);
     pb.setBorderColor(240, 240, 240);
     pb.setBorderWidth(1);
@@ -255,23 +308,15 @@ bool GameController::initContext() {
 
     /* load in monsters.sav */
     {
+    // A missing or short file is ignored rather than using a partial table.
     MonstersSav mons;
-    FILE* fp = fopen((settings.getUserPath() + MONSTERS_SAV).c_str(), "rb");
-    if (fp) {
-        saveGameMonstersRead(mons.table, fp);
-        fclose(fp);
+    if (saveGameMonstersLoad(mons.table, SAVE_MONSTERS))
         gameFixupObjects(map, mons.table);
-    }
 
     /* we have previous creature information as well, load it! */
-    if (c->location->prev) {
-        fp = fopen((settings.getUserPath() + OUTMONST_SAV).c_str(), "rb");
-        if (fp) {
-            saveGameMonstersRead(mons.table, fp);
-            fclose(fp);
-            gameFixupObjects(c->location->prev->map, mons.table);
-        }
-    }
+    if (c->location->prev &&
+        saveGameMonstersLoad(mons.table, SAVE_OUTMONST))
+        gameFixupObjects(c->location->prev->map, mons.table);
     }
 
     uniqueSpellSounds = soundDuration(SOUND_SPELL_A) > 0;
@@ -291,29 +336,17 @@ bool GameController::initContext() {
     return true;
 }
 
-/**
- * Saves the game state into party.sav and monsters.sav.
- * For dungeons dngmap.sav & outmonst.sav are also created.
+/*
+ * Serialize the game state into a SaveSet.
+ * Return false if memory could not be allocated.
  */
-int gameSave(const char* userPath) {
-    FILE *fp;
-    string sbuf(userPath);
-    size_t userPathLen = sbuf.size();
-    const char* basename;
+static bool gameSerialize(SaveSet* set) {
     const Location* loc = c->location;
     const Map* map = loc->map;
     SaveGame save = *c->saveGame;
     MonstersSav mons;
-
-#define openSaveFile(FN) \
-    basename = FN; \
-    sbuf.erase(userPathLen, string::npos); \
-    sbuf.append(basename); \
-    fp = fopen(sbuf.c_str(), "wb"); \
-    if (!fp) { \
-        screenMessage("Error opening %s\n", basename); \
-        return 0; \
-    }
+    uint8_t* dp;
+    bool inDungeon = loc->context & CTX_DUNGEON;
 
     /*************************************************/
     /* Make sure the savegame struct is accurate now */
@@ -338,45 +371,132 @@ int gameSave(const char* userPath) {
     /****************************************************/
 
 
-    openSaveFile(PARTY_SAV);
-    if (! save.write(fp))
-        goto write_error;
-    fclose(fp);
+    dp = saveSetAlloc(set, inDungeon ?
+                      map->width * map->height * map->levels : 0, inDungeon);
+    if (! dp)
+        return false;
 
+    dp = save.pack(dp);
 
-    openSaveFile(MONSTERS_SAV);
     if (map->type == Map::DUNGEON)
         map->fillMonsterTableDungeon(mons.table);
     else
         map->fillMonsterTable(mons.table);
-    if (! saveGameMonstersWrite(mons.table, fp))
-        goto write_error;
-    fclose(fp);
-
+    dp = saveGameMonstersPack(mons.table, dp);
 
     /**
-     * Write dngmap.sav & outmonst.sav
+     * Add dngmap.sav & outmonst.sav
      */
-    if (loc->context & CTX_DUNGEON) {
-        openSaveFile(DNGMAP_SAV);
+    if (inDungeon) {
         const uint8_t* data = static_cast<Dungeon*>((Map*) map)->fillRawMap();
-        size_t dataLen = map->width * map->height * map->levels;
-        fwrite(data, 1, dataLen, fp);
-        fclose(fp);
+        memcpy(dp, data, set->size[SAVE_DNGMAP]);
+        dp += set->size[SAVE_DNGMAP];
 
-
-        openSaveFile(OUTMONST_SAV);
         loc->prev->map->fillMonsterTable(mons.table);
-        if (! saveGameMonstersWrite(mons.table, fp))
-            goto write_error;
-        fclose(fp);
+        saveGameMonstersPack(mons.table, dp);
+    }
+    return true;
+}
+
+/**
+ * Saves the game state into party.sav and monsters.sav.
+ * For dungeons dngmap.sav & outmonst.sav are also created.
+ *
+ * The game state is serialized into memory and then written to disk by a
+ * background thread.
+ */
+int gameSave(const char* userPath) {
+    SaveSet set;
+    const char* failed;
+
+    // Report any error from the previous save.
+    failed = saveSetWait();
+    if (failed)
+        screenMessage("Error writing to %s\n", failed);
+
+    if (! gameSerialize(&set)) {
+        screenMessage("Error saving game\n");
+        return 0;
+    }
+
+    if (! saveSetWriteAsync(&set, userPath)) {
+        screenMessage("Error writing to %s\n", saveSetWait());
+        return 0;
     }
     return 1;
+}
 
-write_error:
-    fclose(fp);
-    screenMessage("Error writing to %s\n", basename);
-    return 0;
+/*
+ * Add the current game state to the ring of snapshots.  The oldest snapshot
+ * is replaced once the ring is full.  Every SNAPSHOT_FLUSH snapshots, a copy
+ * of the latest one is written to the autosave directory in the background.
+ * If the writer is still busy the flush is deferred to the next snapshot so
+ * that the game never waits on the disk.
+ */
+void GameController::takeSnapshot() {
+    Snapshot* snap = snapshots + snapHead;
+
+    free(snap->set.buf);
+    if (! gameSerialize(&snap->set)) {
+        snap->set.buf = NULL;
+        return;
+    }
+    snap->moves = c->saveGame->moves;
+
+    if (++snapHead == SNAPSHOT_COUNT)
+        snapHead = 0;
+    if (snapUsed < SNAPSHOT_COUNT)
+        ++snapUsed;
+
+    if (++snapUnflushed >= SNAPSHOT_FLUSH && ! saveSetBusy()) {
+        SaveSet copy = snap->set;
+        size_t size = 0;
+        for (int i = 0; i < SAVE_FILE_COUNT; ++i)
+            size += copy.size[i];
+
+        copy.buf = (uint8_t*) malloc(size);
+        if (copy.buf) {
+            string dir(xu4.settings->getUserPath() + "autosave/");
+            FileSystem::createDirectory(dir);
+            memcpy(copy.buf, snap->set.buf, size);
+
+            if (saveSetWait(SAVE_WRITE_AUTO))
+                screenMessage("Autosave failed!\n");
+            saveSetWriteAsync(&copy, dir.c_str(), SAVE_WRITE_AUTO);
+            snapUnflushed = 0;
+        }
+    }
+}
+
+/*
+ * Replace the current game with a previous snapshot.
+ *
+ * \param back  Number of snapshots to go back (0 is the latest).
+ *
+ * Return true if the game will be reloaded once this controller is done.
+ */
+bool GameController::restoreSnapshot(int back) {
+    if (back >= snapUsed)
+        return false;
+
+    int n = snapHead - 1 - back;
+    if (n < 0)
+        n += SNAPSHOT_COUNT;
+
+    // The game is reloaded from the snapshot in memory.
+    if (! saveGameRestoreFrom(snapshots[n].set.size, snapshots[n].set.buf)) {
+        screenMessage("Restore failed!\n");
+        return false;
+    }
+
+    // Drop any snapshots newer than the restored one.
+    snapHead = (n + 1) % SNAPSHOT_COUNT;
+    snapUsed -= back;
+    snapUnflushed = 0;
+
+    reloadSaveGame = true;
+    xu4.eventHandler->setControllerDone();
+    return true;
 }
 
 /**
@@ -427,6 +547,8 @@ void GameController::setMap(Map *map, bool saveLocation, const Portal *portal, T
     if (!turnCompleter)
         turnCompleter = this;
 
+    xu4.eventHandler->finishEffects();
+
     if (portal)
         coords = portal->start;
     else
@@ -484,6 +606,8 @@ int GameController::exitToParentMap() {
     Location* loc = c->location;
     if (loc && loc->prev) {
         Map* currentMap = loc->map;
+
+        xu4.eventHandler->finishEffects();
         Map* prevMap = loc->prev->map;
 
         // Create the balloon for Hythloth
@@ -538,6 +662,142 @@ static void gameCheckDrowning() {
     }
 }
 
+/*
+ * Hash the party, location and random number generator state.
+ * This is used to detect when a replay of recorded input diverges.
+ */
+static uint32_t gameStateChecksum() {
+    const Location* loc = c->location;
+    uint8_t buf[SAVEGAME_SIZE];
+    uint32_t state[6];
+
+    c->saveGame->pack(buf);
+
+    state[0] = loc->map->id;
+    state[1] = loc->coords.x;
+    state[2] = loc->coords.y;
+    state[3] = loc->coords.z;
+    state[4] = xu4.randomCount;
+    state[5] = xu4.randomLast;
+
+    return murmurHash3_32((const uint8_t*) state, sizeof(state),
+                          murmurHash3_32(buf, SAVEGAME_SIZE, 0));
+}
+
+/*
+ * Write a replay keyframe and reseed the random number generator.
+ * The seed is saved so that a replay can continue from the keyframe.
+ */
+static void gameRecordKeyframe(uint32_t turn) {
+    GameKeyframe kf;
+    SaveSet set;
+    uint32_t size = 0;
+
+    if (! gameSerialize(&set))
+        return;
+    for (int i = 0; i < SAVE_FILE_COUNT; ++i) {
+        kf.size[i] = set.size[i];
+        size += set.size[i];
+    }
+
+    uint8_t* buf = (uint8_t*) malloc(sizeof(kf) + size);
+    if (buf) {
+        kf.seed = (xu4.randomLast ^ (turn * 0x9E3779B9)) | 1;
+        kf.runTime = xu4.eventHandler->getRunTime();
+        kf.moonPhase = c->moonPhase;
+        kf.windDirection = c->windDirection;
+        kf.windCounter = c->windCounter;
+        kf.windLock = c->windLock;
+        kf.horseSpeed = c->horseSpeed;
+        kf.auraType = c->aura.getType();
+        kf.auraDuration = c->aura.getDuration();
+        kf.commandTimer = c->commandTimer;
+
+        memcpy(buf, &kf, sizeof(kf));
+        memcpy(buf + sizeof(kf), set.buf, size);
+        xu4.eventHandler->recordKeyframe(turn, buf, sizeof(kf) + size);
+        free(buf);
+
+        xu4_srandom(kf.seed);
+    }
+    free(set.buf);
+}
+
+static void gameApplyKeyframe(const GameKeyframe* kf) {
+    c->moonPhase = kf->moonPhase;
+    c->windDirection = kf->windDirection;
+    c->windCounter = kf->windCounter;
+    c->windLock = kf->windLock ? true : false;
+    c->horseSpeed = kf->horseSpeed;
+    c->aura.set(Aura::Type(kf->auraType), kf->auraDuration);
+    c->commandTimer = kf->commandTimer;
+    xu4_srandom(kf->seed);
+}
+
+/*
+ * Replace the current game with the state of a replay keyframe.
+ *
+ * Return true if the game will be reloaded once this controller is done.
+ */
+bool GameController::restoreKeyframe(const uint8_t* data, uint32_t size) {
+    GameKeyframe kf;
+    uint32_t total = sizeof(kf);
+
+    if (size < total)
+        return false;
+    memcpy(&kf, data, sizeof(kf));
+    for (int i = 0; i < SAVE_FILE_COUNT; ++i)
+        total += kf.size[i];
+    if (size != total || ! saveGameRestoreFrom(kf.size, data + sizeof(kf))) {
+        screenMessage("Restore failed!\n");
+        return false;
+    }
+
+    pendingKeyframe = kf;
+    keyframePending = true;
+    xu4.eventHandler->setRunTime(kf.runTime);
+
+    reloadSaveGame = true;
+    xu4.eventHandler->setControllerDone();
+    return true;
+}
+
+/*
+ * Check the game state against the input recording.  When recording,
+ * keyframes are also written.  During replay, keyframes are used to reseed
+ * the random number generator or to jump to a turn being sought.
+ */
+void GameController::recordTurn() {
+    EventHandler* eh = xu4.eventHandler;
+    uint32_t turn = c->saveGame->moves;
+    const uint8_t* data;
+    uint32_t size;
+
+    eh->checkState(turn, gameStateChecksum());
+
+    if (! eh->replaying()) {
+        if ((c->location->context & CTX_CAN_SAVE_GAME) &&
+            (turn % KEYFRAME_TURNS) == 0)
+            gameRecordKeyframe(turn);
+        return;
+    }
+
+    data = eh->replayKeyframe(turn, &size);
+    if (data && size >= sizeof(GameKeyframe)) {
+        GameKeyframe kf;
+        memcpy(&kf, data, sizeof(kf));
+        xu4_srandom(kf.seed);
+    }
+
+    // Jumps reload the game, so they are only done from the top controller.
+    if (eh->getController() == this) {
+        data = eh->replaySeekKeyframe(turn, &size);
+        if (data && restoreKeyframe(data, size))
+            return;
+    }
+    eh->replayTurnDone(turn);
+}
+
 /**
  * Terminates a game turn.  This performs the post-turn housekeeping
  * tasks like adjusting the party's food, incrementing the number of
@@ -616,34 +876,72 @@ void GameController::finishTurn() {
     }
 
 
+    int autosave = xu4.settings->autosaveTurns;
+    if (autosave && (c->location->context & CTX_CAN_SAVE_GAME) &&
+        (c->saveGame->moves % autosave) == 0)
+        takeSnapshot();
+
+    if (xu4.eventHandler->recordingInput())
+        recordTurn();
+
     /* draw a prompt */
     screenPrompt();
 }
 
+/*
+ * Return true if effect delays should be skipped because the fast combat
+ * setting is on and the party is in combat.
+ */
+bool gameFastEffects() {
+    return xu4.settings->fastCombat && (c->location->context & CTX_COMBAT);
+}
+
+/*
+ * Wait for queued effects to finish unless fast combat is in effect.
+ *
+ * \return true if game should exit.
+ */
+bool gameWaitEffects() {
+    if (gameFastEffects())
+        return false;
+    return EventHandler::waitEffects();
+}
+
+static void flashTileFunc(QueuedEffect* fx, float frac) {
+    if (frac < 1.0f)
+        return;
+#ifdef GPU_RENDER
+    xu4.game->mapArea.removeEffect(fx->id);
+#else
+    c->location->map->annotations.remove(fx->pos, MapTile(fx->arg));
+    screenTileUpdate(&xu4.game->mapArea, fx->pos);
+#endif
+}
+
 /**
  * Show an attack flash at x, y on the current map.
  * This is used for 'being hit' or 'being missed'
  * by weapons, cannon fire, spells, etc.
  */
 void GameController::flashTile(const Coords &coords, MapTile tile, int frames) {
+    QueuedEffect fx;
+
+    fx.func = flashTileFunc;
+    fx.duration = float(frames) /
+                  float(xu4.settings->screenAnimationFramesPerSecond);
+    fx.arg = tile.id;
+    fx.pos = coords;
 #ifdef GPU_RENDER
-    int fx = xu4.game->mapArea.showEffect(coords, tile.id);
+    fx.id = xu4.game->mapArea.showEffect(coords, tile.id);
 #else
-    Map* map = c->location->map;
-    map->annotations.add(coords, tile, true);
+    fx.id = 0;
+    c->location->map->annotations.add(coords, tile, true);
     screenTileUpdate(&xu4.game->mapArea, coords);
     screenUploadToGPU();
 #endif
 
-    EventHandler::wait_msecs(frames * 1000 /
-                             xu4.settings->screenAnimationFramesPerSecond);
-
-#ifdef GPU_RENDER
-    xu4.game->mapArea.removeEffect(fx);
-#else
-    map->annotations.remove(coords, tile);
-    screenTileUpdate(&xu4.game->mapArea, coords);
-#endif
+    xu4.eventHandler->queueEffect(&fx);
+    gameWaitEffects();
 }
 
 void GameController::flashTile(const Coords &coords, Symbol tilename, int timeFactor) {
@@ -719,7 +1017,8 @@ static void gameSpellCastSfx(int spell, int caster, int subject, int spellMp) {
     int time = int(10000.0 / xu4.settings->spellEffectSpeed  *
                    spellMp / MP_OF_LARGEST_SPELL);
     soundPlay(SOUND_PREMAGIC_MANA_JUMBLE, time);
-    EventHandler::wait_msecs(time);
+    if (! gameFastEffects())
+        EventHandler::wait_msecs(time);
 
     gameSpellEffect(spell, subject, SOUND_MAGIC);
 }
@@ -737,8 +1036,25 @@ static void gameSpellCastVoc(int spell, int caster, int subject, int spellMp) {
     gameSpellEffect(spell, subject, SOUND_MAGIC);
 }
 
-void gameSpellEffect(int spell, int player, Sound sound) {
+static int spellHighlights = 0;
+static bool spellPlayerHighlight = false;
+
+static void spellHighlightFunc(QueuedEffect* fx, float frac) {
+    (void) fx;
+    if (frac < 1.0f)
+        return;
+    // Overlapping spell effects keep the view inverted until the last ends.
+    if (--spellHighlights == 0) {
+        xu4.game->mapArea.unhighlight();
+        if (spellPlayerHighlight) {
+            spellPlayerHighlight = false;
+            c->stats->highlightPlayer(-1);
+        }
+    }
+}
 
+void gameSpellEffect(int spell, int player, Sound sound) {
+    QueuedEffect fx;
     int playLimit, time;
 
     if (sound == SOUND_MAGIC && xu4.game->uniqueSpellSounds) {
@@ -752,22 +1068,26 @@ void gameSpellEffect(int spell, int player, Sound sound) {
     }
     soundPlay(sound, playLimit);
 
-    if (player >= 0)
+    if (player >= 0) {
         c->stats->highlightPlayer(player);
+        spellPlayerHighlight = true;
+    }
 
     // Invert the screen while the sound plays.
     gameUpdateScreen();
     xu4.game->mapArea.highlight(0, 0, VIEWPORT_W * TILE_WIDTH, VIEWPORT_H * TILE_HEIGHT);
-    EventHandler::wait_msecs(time);
-    xu4.game->mapArea.unhighlight();
+    ++spellHighlights;
 
-    if (player >= 0)
-        c->stats->highlightPlayer(-1);
+    fx.func = spellHighlightFunc;
+    fx.duration = float(time) * 0.001f;
+    xu4.eventHandler->queueEffect(&fx);
+    gameWaitEffects();
 
     if (spell == 't') {     // Tremor
         gameUpdateScreen();
         soundPlay(SOUND_RUMBLE);
         screenShake(8);
+        gameWaitEffects();
     }
 }
 
@@ -919,6 +1239,7 @@ bool GameController::keyPressed(int key) {
             else valid = false;
 #else
             screenShake(8);
+            EventHandler::waitEffects();
 #endif
             break;
 
@@ -1011,8 +1332,7 @@ bool GameController::keyPressed(int key) {
                     settings.gameCyclesPerSecond = DEFAULT_CYCLES_PER_SECOND;
 
                 if (old_cycles != settings.gameCyclesPerSecond) {
-                    xu4.eventHandler->setTimerInterval(1000 /
-                                                settings.gameCyclesPerSecond);
+                    xu4.eventHandler->setTimerRate(settings.gameCyclesPerSecond);
 
                     if (settings.gameCyclesPerSecond == DEFAULT_CYCLES_PER_SECOND)
                         screenMessage("Speed: Normal\n");
@@ -1307,6 +1627,7 @@ bool GameController::keyPressed(int key) {
 
             screenMessage("\n"
                           "Alt-Q: Main Menu\n"
+                          "Alt-R: Restore\n"
                           "Alt-V: Version\n"
                           "Alt-X: Quit\n"
                           "\n"
@@ -1316,7 +1637,6 @@ bool GameController::keyPressed(int key) {
                           "\n"
                           "\n"
                           "\n"
-                          "\n"
                           );
             screenPrompt();
             break;
@@ -1347,6 +1667,29 @@ bool GameController::keyPressed(int key) {
             }
             break;
 
+        case 'r' + U4_ALT:
+            endTurn = false;
+            if (! snapUsed) {
+                screenMessage("No snapshots!\n");
+                break;
+            }
+            {
+            char choices[SNAPSHOT_COUNT + 3];
+            int i;
+            for (i = 0; i < snapUsed; ++i)
+                choices[i] = '1' + i;
+            choices[i++] = ' ';
+            choices[i++] = '\033';
+            choices[i] = '\0';
+
+            screenMessage("Restore snapshot 1-%d (newest first)? ", snapUsed);
+            char choice = EventHandler::readChoice(choices);
+            screenMessage("\n");
+            if (choice >= '1' && choice <= '8')
+                restoreSnapshot(choice - '1');
+            }
+            break;
+
         case 'v' + U4_ALT:
             screenMessage("XU4 %s\n", VERSION);
             endTurn = false;
@@ -11,6 +11,7 @@
 #include "discourse.h"
 #include "event.h"
 #include "map.h"
+#include "savegame.h"
 #include "sound.h"
 #include "tileview.h"
 #include "types.h"
@@ -75,6 +76,9 @@ public:
     bool initContext();
     void updateMoons(bool showmoongates);
 
+    void takeSnapshot();
+    bool restoreSnapshot(int back);
+
     static void flashTile(const Coords &coords, MapTile tile, int timeFactor);
     static void flashTile(const Coords &coords, Symbol tilename, int timeFactor);
 
@@ -104,13 +108,33 @@ private:
 
     bool createBalloon(Map *map);
 
+    void recordTurn();
+    bool restoreKeyframe(const uint8_t* data, uint32_t size);
+
+    struct Snapshot {
+        SaveSet set;
+        uint32_t moves;
+    };
+
+    enum {
+        SNAPSHOT_COUNT = 8,
+        SNAPSHOT_FLUSH = 4      // Write every Nth snapshot to disk.
+    };
+
     float* borderAttr;
     int borderAttrLen;
+    Snapshot snapshots[SNAPSHOT_COUNT];
+    uint16_t snapHead;          // Index of next slot to be written.
+    uint16_t snapUsed;
+    uint16_t snapUnflushed;
+    bool reloadSaveGame;
 };
 
 /* map and screen functions */
 void gameSetViewMode(ViewMode newMode);
 void gameUpdateScreen();
+bool gameFastEffects();
+bool gameWaitEffects();
 
 /* spell functions */
 void castSpell(int player = -1);
@@ -177,7 +177,7 @@ void GameBrowser::updateWidgetTip(const ScreenState* ss)
     }
 }
 
-#define NO_PARENT   255
+#define NO_PARENT   0xffff
 
 struct ModuleSortContext {
     const StringTable* st;
@@ -225,15 +225,6 @@ static int collectModFiles(const char* name, int type, void* user)
     return PDIR_CONTINUE;
 }
 
-static bool isExtensionOf(const char* name, const char* /*version*/,
-                          const StringTable* childModi)
-{
-    int len;
-    const char* rules = sst_stringL(childModi, MI_RULES, &len);
-    const char* pver = (const char*) memchr(rules, '/', len);
-    return (pver && memcmp(name, rules, pver - rules) == 0);
-}
-
 //#define TEST_LIST
 #ifdef TEST_LIST
 #define TEST_COUNT 6
@@ -342,23 +333,46 @@ static void readModuleList(StringTable* modFiles, StringTable* modFormat,
         }
     }
 
-    // Assign parents.
+    // Assign parents.  The base module names (without the .mod suffix) are
+    // hashed so each child finds its parent with a single lookup.
+
+    {
+    StringTable baseNames;
+    std::vector<uint16_t> baseFileI;
+    const char* rules;
+    const char* pver;
+    int n;
+
+    sst_init(&baseNames, 8, 16);
+    sst_enableHash(&baseNames);
 
     files = sst_strings(modFiles);
     for (const auto& it : infoList) {
         if (it.category == MOD_BASE) {
-            const char* name = files + sst_start(modFiles, it.modFileI);
-            //const char* version = sst_stringL(it.modi, MI_VERSION, &len);
-
-            for (auto& child : infoList) {
-                if (child.category == MOD_BASE)
-                    continue;
-                if (isExtensionOf(name, NULL, &child.modi))
-                    child.parent = it.modFileI;
-            }
+            n = sst_intern(&baseNames, files + sst_start(modFiles, it.modFileI),
+                           sst_len(modFiles, it.modFileI) - 4);
+            if (n == (int) baseFileI.size())
+                baseFileI.push_back(it.modFileI);
+            else
+                baseFileI[n] = it.modFileI;
         }
     }
 
+    for (auto& child : infoList) {
+        if (child.category == MOD_BASE)
+            continue;
+        rules = sst_stringL(&child.modi, MI_RULES, &len);
+        pver = (const char*) memchr(rules, '/', len);
+        if (pver) {
+            n = sst_lookup(&baseNames, rules, pver - rules);
+            if (n >= 0)
+                child.parent = baseFileI[n];
+        }
+    }
+
+    sst_free(&baseNames);
+    }
+
     // Build infoList with children sorted in alphabetical order under their
     // parents.
 
@@ -3,10 +3,10 @@
 
 struct ModuleInfo {
     StringTable modi;
+    uint16_t modFileI;
+    uint16_t parent;
     uint8_t resPathI;
-    uint8_t modFileI;
     uint8_t category;
-    uint8_t parent;
 };
 
 struct TxfHeader;
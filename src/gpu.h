@@ -38,7 +38,6 @@ struct WorkBuffer {
     WorkRegion region[2];
 };
 
-struct BlockingGroups;
 class Map;
 class TileView;
 
@@ -52,9 +51,12 @@ void     gpu_free(void* res);
 void     gpu_viewport(int x, int y, int w, int h);
 uint32_t gpu_makeTexture(const Image32* img);
 void     gpu_blitTexture(uint32_t tex, int x, int y, const Image32* img);
+void     gpu_blitTextureRect(uint32_t tex, const Image32* img,
+                             int x, int y, int w, int h);
 void     gpu_freeTexture(uint32_t id);
 uint32_t gpu_screenTexture(void* res);
 void     gpu_setTilesTexture(void* res, uint32_t tex, uint32_t mat, float vDim);
+void     gpu_setTileColors(void* res, const uint32_t* colors);
 void     gpu_drawTextureScaled(void* res, uint32_t tex);
 void     gpu_clear(void* res, const float* color);
 void     gpu_invertColors(void* res);
@@ -73,6 +75,6 @@ float*   gpu_emitQuad(float* attr, const float* drawRect, const float* uvRect);
 float*   gpu_emitQuadPq(float* attr, const float* drawRect, const float* uvRect,
                         float texP, float texQ);
 void     gpu_resetMap(void* res, const Map* map);
+void     gpu_updateMapData(void* res, const Map* map);
 void     gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
-                     const BlockingGroups* blocks,
-                     int cx, int cy, float scale);
+                     int updateShadows, int cx, int cy, float scale);
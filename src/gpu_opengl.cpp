@@ -732,8 +732,10 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     gr->shadowTrans  = glGetUniformLocation(sh, "transform");
     gr->shadowVport  = glGetUniformLocation(sh, "vport");
     gr->shadowViewer = glGetUniformLocation(sh, "viewer");
-    gr->shadowCounts = glGetUniformLocation(sh, "shape_count");
-    gr->shadowShapes = glGetUniformLocation(sh, "shapes");
+    gr->shadowCenter = glGetUniformLocation(sh, "center");
+
+    glUseProgram(sh);
+    glUniform1i(glGetUniformLocation(sh, "occluders"), GTU_OCCLUDER);
 
 
     // Create world shader.
@@ -816,6 +818,20 @@ void gpu_blitTexture(uint32_t tex, int x, int y, const Image32* img)
                     GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
 }
 
+/*
+ * Copy a rectangular area of an image to the same position in a texture.
+ * The caller must ensure the area lies inside both the image and texture.
+ */
+void gpu_blitTextureRect(uint32_t tex, const Image32* img,
+                         int x, int y, int w, int h)
+{
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, img->w);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, img->pixels + img->w * y + x);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 /*
  * Release texture created with gpu_makeTexture() or gpu_loadTexture().
  */
@@ -841,6 +857,17 @@ void gpu_setTilesTexture(void* res, uint32_t tex, uint32_t mat, float vDim)
     gr->tilesMat = mat;
     gr->tilesVDim = vDim;
 }
+
+/*
+ * Set the table of RGBA colors (indexed by VisualId) used to draw tiles
+ * in the low detail overview.  The table is managed by the caller and must
+ * remain valid until gpu_setTileColors is called again.
+ */
+void gpu_setTileColors(void* res, const uint32_t* colors)
+{
+    OpenGLResources* gr = (OpenGLResources*) res;
+    gr->tileColors = colors;
+}
 #endif
 
 /*
@@ -1266,11 +1293,11 @@ void gpu_resetMap(void* res, const Map* map)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
 
-    gr->blockCount = 0;
     gr->mapData    = map->data;
     gr->renderData = map->tileset->render;
     gr->mapW       = map->width;
     gr->mapH       = map->height;
+    gr->mapWrap    = (map->border_behavior == Map::BORDER_WRAP);
 
     // Initialize map chunks.
     assert(map->chunk_height == map->chunk_width);
@@ -1293,6 +1320,73 @@ void gpu_resetMap(void* res, const Map* map)
     // Clear chunk cache.
     memset(gr->mapChunkId, 0xff, CHUNK_CACHE_SIZE*sizeof(uint16_t));
     memset(gr->mapChunkFxUsed, 0, CHUNK_CACHE_SIZE*sizeof(uint16_t));
+
+    gpu_updateMapData(res, map);
+}
+
+/*
+ * Build the low detail overview texture (one texel per tile) used to draw
+ * the map when it is zoomed out.
+ */
+static void _updateOverview(OpenGLResources* gr, const Map* map)
+{
+    const TileId* it;
+    const TileId* end;
+    uint32_t* pixels;
+    uint32_t* dp;
+
+    if (! gr->tileColors)
+        return;
+
+    pixels = (uint32_t*) malloc(map->width * map->height * sizeof(uint32_t));
+    if (! pixels)
+        return;
+
+    dp  = pixels;
+    it  = map->data;
+    end = it + map->width * map->height;
+    for (; it != end; ++it)
+        *dp++ = gr->tileColors[ gr->renderData[ *it ].vid ];
+
+    gpu_defineTex(gr->overviewTex, map->width, map->height, pixels,
+                  GL_RGBA, GL_NEAREST);
+    free(pixels);
+}
+
+/*
+ * Upload the textures derived from the map data.  This must be called when
+ * the map data is modified.
+ *
+ * The occluder texture holds the opaque tile shapes sampled by the
+ * shadowcast shader.
+ */
+void gpu_updateMapData(void* res, const Map* map)
+{
+    OpenGLResources* gr = (OpenGLResources*) res;
+    uint8_t* grid;
+
+    _updateOverview(gr, map);
+
+    gr->blockCount = 0;
+    if (map->flags & NO_LINE_OF_SIGHT)
+        return;
+
+    grid = (uint8_t*) malloc(map->width * map->height);
+    if (! grid)
+        return;
+    gr->blockCount = map->queryBlocking(grid);
+
+    glActiveTexture(GL_TEXTURE0 + GTU_OCCLUDER);
+    glBindTexture(GL_TEXTURE_2D, gr->occluderTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, map->width, map->height,
+                 0, GL_RED, GL_UNSIGNED_BYTE, grid);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glActiveTexture(GL_TEXTURE0 + GTU_CMAP);
+
+    free(grid);
 }
 
 struct ChunkLoc {
@@ -1508,34 +1602,102 @@ used:
     return i;
 }
 
+/*
+ * Draw the map overview texture so that tile cx, cy is at the view center.
+ * Wrapping maps are drawn with neighbouring copies so the edges are filled.
+ */
+static void _drawOverview(OpenGLResources* gr, int cx, int cy,
+                          float scale, float scaleY)
+{
+    float matrix[16];
+    float mw = (float) gr->mapW;
+    float mh = (float) gr->mapH;
+    float ox, oy;
+    int i, j, n;
+
+    glUseProgram(gr->shadeColor);
+    glActiveTexture(GL_TEXTURE0 + GTU_CMAP);
+    glBindTexture(GL_TEXTURE_2D, gr->overviewTex);
+    glBindVertexArray(gr->vao[ GLOB_QUAD ]);
+
+    m4_loadIdentity(matrix);
+    matrix[0] = mw * scale * 0.5f;
+    matrix[5] = mh * scaleY * 0.5f;
+
+    n = gr->mapWrap ? 1 : 0;
+    for (j = -n; j <= n; ++j) {
+        for (i = -n; i <= n; ++i) {
+            // Center of the map rectangle relative to the view center.
+            ox = mw * (0.5f + i) - 0.5f - cx;
+            oy = mh * (0.5f + j) - 0.5f - cy;
+            matrix[kX] =  ox * scale;
+            matrix[kY] = -oy * scaleY;
+            glUniformMatrix4fv(gr->slocTrans, 1, GL_FALSE, matrix);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+    }
+
+    glUniformMatrix4fv(gr->slocTrans, 1, GL_FALSE, m4_identity);
+}
+
+// Tiles smaller than this are not drawn with full geometry in overview mode.
+#define LOD_MIN_TILE_PIXELS 8.0f
+
 /*
  * \param view          Pointer to TileView with a valid map.
  * \param tileUVs       Table of four floats (minU,minV,maxU,maxV) per tile.
- * \param blocks        Sets the occluder shapes for shadowcasting.
- *                      Pass NULL to reuse any previously set shapes.
+ * \param updateShadows Non-zero to recompute the shadow map for the
+ *                      viewer at cx, cy.  Pass zero to reuse the previous
+ *                      shadows.
  * \param cx            Map tile row to center view on.
  * \param cy            Map tile column to center view on.
  * \param scale         Normal = 2.0 / view->columns.
+ *
+ * When the view spans more tiles than the four cached chunks can cover,
+ * the map is drawn with the overview texture (one texel per tile) and full
+ * tile geometry is only used for the chunks around the center.  Shadows are
+ * not drawn in this overview mode.
  */
 void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
-                 const BlockingGroups* blocks,
-                 int cx, int cy, float scale)
+                 int updateShadows, int cx, int cy, float scale)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
     ChunkLoc cloc[4];   // Tile location of chunks on the map.
+    float scaleY = scale * view->aspect;
     int i, usedMask;
+    int halfW, halfH;
+    int overview = 0;
+    int detail = 1;
+
+    // Number of whole tiles visible from the center to the view edges.
+    halfW = (int) (1.0f / scale);
+    halfH = (int) (1.0f / scaleY);
+    {
+    int cdim = gr->mapChunkDim;
+    if (halfW * 2 + 1 > cdim || halfH * 2 + 1 > cdim) {
+        int limit = (cdim - 1) / 2;
+        overview = 1;
+        if (halfW > limit)
+            halfW = limit;
+        if (halfH > limit)
+            halfH = limit;
+        if (view->screenRect[2] * scale * 0.5f < LOD_MIN_TILE_PIXELS)
+            detail = 0;
+    }
+    }
 
     // Render shadows.
-    if (blocks) {
-        gr->blockCount = blocks->left + blocks->center + blocks->right;
+    if (updateShadows && ! overview) {
         if (gr->blockCount) {
             glUseProgram(gr->shadow);
             glUniformMatrix4fv(gr->shadowTrans, 1, GL_FALSE, m4_identity);
             glUniform4f(gr->shadowVport, 0.0f, 0.0f, SHADOW_DIM, SHADOW_DIM);
-            glUniform3f(gr->shadowViewer, 0.0f, 0.0f, 11.0f);
-            glUniform3i(gr->shadowCounts, blocks->left, blocks->center,
-                                          blocks->right);
-            glUniform3fv(gr->shadowShapes, gr->blockCount, blocks->tilePos);
+            glUniform3f(gr->shadowViewer, 0.0f, 0.0f, 2.0f / scale);
+            glUniform2i(gr->shadowCenter, cx, cy);
+
+            glActiveTexture(GL_TEXTURE0 + GTU_OCCLUDER);
+            glBindTexture(GL_TEXTURE_2D, gr->occluderTex);
+            glActiveTexture(GL_TEXTURE0 + GTU_CMAP);
 
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gr->shadowFbo);
             glViewport(0, 0, SHADOW_DIM, SHADOW_DIM);
@@ -1548,11 +1710,10 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
         }
     }
 
-    {
+    if (detail) {
     ChunkInfo ci;
     int bindex[4];  // Chunk vertex buffer index (0-3) at view corner.
     int left, top, right, bot;
-    int halfW, halfH;
 
     ci.gr = gr;
     ci.uvs = tileUVs;
@@ -1560,10 +1721,6 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
     ci.chunkLoc = cloc;
     ci.geoUsedMask = 0;
 
-    // FIXME: Apply scale.
-    halfW = view->columns / 2;
-    halfH = view->rows / 2;
-
     left  = cx - halfW;
     right = cx + halfW;
     top   = cy - halfH;
@@ -1586,16 +1743,21 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
         _obtainChunkGeo(&ci, right, bot, 1);
 
     usedMask = ci.geoUsedMask;
-    }
+    } else
+        usedMask = 0;
 
     {
     const int* vrect = view->screenRect;
     glViewport(vrect[0], vrect[1], vrect[2], vrect[3]);
     }
 
+    if (overview) {
+        glDisable(GL_BLEND);
+        _drawOverview(gr, cx, cy, scale, scaleY);
+    }
+
     {
     float matrix[16];
-    float scaleY = scale * view->aspect;
     int fxUsed = 0;
 
     gr->time = ((float) getTicks()) * 0.001;
@@ -1606,7 +1768,7 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
     glUseProgram(gr->shadeWorld);
     glUniform2f(gr->worldScroll, gr->tilesVDim, gr->time);
     glActiveTexture(GL_TEXTURE0 + GTU_SHADOW);
-    if (gr->blockCount)
+    if (gr->blockCount && ! overview)
         glBindTexture(GL_TEXTURE_2D, gr->shadowTex);
     else
         glBindTexture(GL_TEXTURE_2D, gr->whiteTex);
@@ -37,7 +37,8 @@ enum GLTextureUnit {
     GTU_MATERIAL,
     GTU_NOISE,
     GTU_SHADOW,
-    GTU_SCALER_LUT
+    GTU_SCALER_LUT,
+    GTU_OCCLUDER
 };
 
 struct DrawList {
@@ -56,7 +57,7 @@ struct MapFx {
     AnimId anim;
 };
 
-#define TEXTURE_COUNT  6
+#define TEXTURE_COUNT  8
 
 struct OpenGLResources {
     GLuint screenTex;
@@ -65,6 +66,8 @@ struct OpenGLResources {
     GLuint guiTex;
     GLuint noiseTex;
     GLuint shadowTex;
+    GLuint occluderTex;
+    GLuint overviewTex;
     GLuint shadowFbo;
     GLuint vbo[ GLOB_COUNT ];
     GLuint vao[ GLOB_COUNT ];
@@ -95,8 +98,7 @@ struct OpenGLResources {
     GLint  shadowTrans;
     GLint  shadowVport;
     GLint  shadowViewer;
-    GLint  shadowCounts;
-    GLint  shadowShapes;
+    GLint  shadowCenter;
 
     GLuint shadeWorld;
     GLint  worldTrans;
@@ -105,17 +107,19 @@ struct OpenGLResources {
 
     GLuint tilesTex;            // Managed by user.
     GLuint tilesMat;            // Managed by user.
+    const uint32_t* tileColors; // Managed by user.
     float  tilesVDim;
     float  time;
     DrawList dl[5];
     float* dptr;
     const TileId* mapData;
     const TileRenderData* renderData;
-    int    blockCount;
+    int    blockCount;          // Number of opaque tiles on map.
     GLsizei mapChunkVertCount;
     uint16_t mapW;
     uint16_t mapH;
     uint16_t mapChunkDim;       // Size in tiles (width & height are the same).
+    uint16_t mapWrap;           // Map::BORDER_WRAP
     uint16_t mapChunkId[4];     // Chunk X,Y of associated GLOB_MAP_CHUNK.
     uint16_t mapChunkFxUsed[4];
     MapFx mapChunkFx[4*CHUNK_FX_LIMIT];
@@ -19,6 +19,7 @@
 */
 
 #include <assert.h>
+#include <cstdlib>
 #include <cstring>
 #include "image32.h"
 #include "gpu.h"
@@ -57,15 +58,192 @@ typedef struct {
 static const float button_uvs[4] = { 2.0f, 3.0f, 90.0f, 35.0f };
 
 //----------------------------------------------------------------------------
+// Text run cache
+//
+// Glyph quads generated by txf_genText are saved relative to the starting
+// pen position so that re-emitting the same text with the same font, size,
+// color & margin only requires a copy and an offset.
+
+extern "C" uint32_t murmurHash3_32(const uint8_t* data, int len, uint32_t seed);
+
+#define TEXT_CACHE_SIZE     128     // Must be a power of two.
+#define TEXT_CACHE_MAXLEN   256     // Longer strings are not cached.
+
+struct TextRunKey {
+    const TxfHeader* tf;
+    const TxfHeader* const* fontTable;
+    TxfControlFunc lowChar;
+    const TxfGlyph* prev;
+    float prScale;
+    float psize;
+    float lineSpacing;
+    float colorIndex;
+    float marginOff;        // marginL - x
+    float marginROff;       // marginR - x
+    uint32_t seed;
+    int emitTris;
+};
 
-float* gui_emitText(TxfDrawState* ds, float* attr, const char* text,
-                    uint32_t len)
+struct TextRun {
+    TextRunKey key;
+    char* text;
+    float* attr;            // Vertex positions relative to the start pen.
+    uint32_t len;
+    int quads;
+    int floats;             // Number of floats in attr.
+    // State after the text is emitted.
+    const TxfHeader* tf;
+    const TxfGlyph* prev;
+    float psize;
+    float lineSpacing;
+    float colorIndex;
+    float dx, dy;
+    float xMax;             // Relative to start x.
+};
+
+static TextRun textCache[TEXT_CACHE_SIZE];
+
+/*
+ * Free all cached text runs.  This must be called if any fonts are freed.
+ */
+void gui_clearTextCache()
 {
-    int quads = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
+    TextRun* it  = textCache;
+    TextRun* end = it + TEXT_CACHE_SIZE;
+    for (; it != end; ++it) {
+        free(it->text);
+        free(it->attr);
+    }
+    memset(textCache, 0, sizeof(textCache));
+}
+
+static void textRun_key(TextRunKey* key, const TxfDrawState* ds,
+                        uint32_t seed)
+{
+    memset(key, 0, sizeof(TextRunKey));     // Clear any padding.
+    key->tf         = ds->tf;
+    key->fontTable  = ds->fontTable;
+    key->lowChar    = ds->lowChar;
+    key->prev       = ds->prev;
+    key->prScale    = ds->prScale;
+    key->psize      = ds->psize;
+    key->lineSpacing = ds->lineSpacing;
+    key->colorIndex = ds->colorIndex;
+    key->marginOff  = ds->marginL - ds->x;
+    key->marginROff = ds->marginR - ds->x;
+    key->seed       = seed;
+    key->emitTris   = ds->emitTris;
+}
+
+static float* textRun_emit(TxfDrawState* ds, float* attr, const char* text,
+                           uint32_t len, uint32_t seed)
+{
+    TextRunKey key;
+    TextRun* run;
+    const float* sp;
+    float* dp;
+    float* dend;
+    float startX, startY, prevXMax;
+    int quads;
+
+    if (len > TEXT_CACHE_MAXLEN) {
+        quads = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
                             (const uint8_t*) text, len);
+        return attr + (quads * 6 * ATTR_COUNT);
+    }
+
+    textRun_key(&key, ds, seed);
+    run = textCache + (murmurHash3_32((const uint8_t*) text, len,
+                            murmurHash3_32((const uint8_t*) &key,
+                                           sizeof(key), len))
+                       & (TEXT_CACHE_SIZE - 1));
+    startX = ds->x;
+    startY = ds->y;
+
+    if (run->text && run->len == len &&
+        memcmp(&run->key, &key, sizeof(key)) == 0 &&
+        memcmp(run->text, text, len) == 0) {
+        // Cache hit.
+        dp   = attr;
+        dend = dp + run->floats;
+        memcpy(dp, run->attr, run->floats * sizeof(float));
+        for (; dp != dend; dp += ATTR_COUNT) {
+            dp[0] += startX;
+            dp[1] += startY;
+        }
+
+        ds->tf          = run->tf;
+        ds->prev        = run->prev;
+        ds->psize       = run->psize;
+        ds->lineSpacing = run->lineSpacing;
+        ds->colorIndex  = run->colorIndex;
+        ds->x = startX + run->dx;
+        ds->y = startY + run->dy;
+        if (ds->xMax < startX + run->xMax)
+            ds->xMax = startX + run->xMax;
+        return attr + (run->quads * 6 * ATTR_COUNT);
+    }
+
+    // Generate & save the run.
+    prevXMax = ds->xMax;
+    ds->xMax = startX;
+    quads = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
+                        (const uint8_t*) text, len);
+
+    free(run->text);
+    free(run->attr);
+    run->key   = key;
+    run->len   = len;
+    run->quads = quads;
+    run->floats = quads * (ds->emitTris ? 6 : 4) * ATTR_COUNT;
+    run->text  = (char*) malloc(len ? len : 1);
+    run->attr  = (float*) malloc(run->floats * sizeof(float) + 1);
+    if (! run->text || ! run->attr) {
+        free(run->text);
+        free(run->attr);
+        run->text = NULL;
+        run->attr = NULL;
+    } else {
+        memcpy(run->text, text, len);
+        dp = run->attr;
+        dend = dp + run->floats;
+        for (sp = attr; dp != dend; dp += ATTR_COUNT, sp += ATTR_COUNT) {
+            memcpy(dp, sp, ATTR_COUNT * sizeof(float));
+            dp[0] -= startX;
+            dp[1] -= startY;
+        }
+        run->tf          = ds->tf;
+        run->prev        = ds->prev;
+        run->psize       = ds->psize;
+        run->lineSpacing = ds->lineSpacing;
+        run->colorIndex  = ds->colorIndex;
+        run->dx   = ds->x - startX;
+        run->dy   = ds->y - startY;
+        run->xMax = ds->xMax - startX;
+    }
+
+    if (ds->xMax < prevXMax)
+        ds->xMax = prevXMax;
     return attr + (quads * 6 * ATTR_COUNT);
 }
 
+/*
+ * Emit triangles for a string.  Previously generated glyphs are re-used when
+ * the same text is drawn with the same font, size, color & margin.
+ */
+float* gui_emitText(TxfDrawState* ds, float* attr, const char* text,
+                    uint32_t len)
+{
+    // The result of custom control functions can only be cached by the
+    // caller as it must know what state they depend upon.
+    if (ds->lowChar != txf_controlChar) {
+        int quads = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
+                                (const uint8_t*) text, len);
+        return attr + (quads * 6 * ATTR_COUNT);
+    }
+    return textRun_emit(ds, attr, text, len, 0);
+}
+
 float* gui_emitQuadCi(float* attr, const float* rect, float colorIndex)
 {
     float uvs[4];
@@ -214,6 +392,34 @@ static const uint8_t* list_controlChar(TxfDrawState* ds, const uint8_t* it,
     return txf_controlChar(ds, it, end);
 }
 
+/*
+ * Return a text cache seed for the list cell styles used by a line.
+ */
+static uint32_t list_cacheSeed(const ListDrawState* ds, const char* text,
+                               uint32_t len)
+{
+    float style[1 + 3 * 4];
+    float* sp = style;
+    const ListCellStyle* cell = ds->cell;
+    const char* end = text + len;
+    int cells = 1;
+
+    for (; text != end; ++text) {
+        if (*text == '\t' && cells < 4)
+            ++cells;
+    }
+
+    // Tab stops are absolute so they are made relative to the first cell.
+    *sp++ = ds->psizeList;
+    for (int i = 0; i < cells; ++i, ++cell) {
+        *sp++ = cell->tabStop - ds->cell[0].tabStop;
+        *sp++ = cell->fontScale;
+        *sp++ = (float) (ds->selected ? cell->selColor : cell->color);
+    }
+    return murmurHash3_32((const uint8_t*) style,
+                          (sp - style) * sizeof(float), ds->selected);
+}
+
 /*
  * Emit triangles for each line of text in a StringTable.
  *
@@ -239,7 +445,8 @@ float* gui_emitListItems(float* attr, ListDrawState* ds, StringTable* st,
         ds->tabCount = 0;
         list_applyCellStyle(ds, 0);
 
-        attr = gui_emitText(ds, attr, strings + it->start, it->len);
+        attr = textRun_emit(ds, attr, strings + it->start, it->len,
+                            list_cacheSeed(ds, strings + it->start, it->len));
     }
 
     ds->lowChar = origCtrl;
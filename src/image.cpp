@@ -10,6 +10,10 @@
 
 #include "support/image32.c"
 
+// Report changes to the screen so that only modified areas get uploaded.
+#define DAMAGE(img,x,y,w,h) \
+    if ((img) == xu4.screenImage) screenMarkDirty(x,y,w,h)
+
 union RgbaInt {
     RGBA col;
     uint32_t u32;
@@ -63,6 +67,7 @@ void Image::putPixel(int x, int y, int r, int g, int b, int a) {
     RgbaInt ri;
     rgba_set(ri.col, r, g, b, a);
     pixels[ y*w + x ] = ri.u32;
+    DAMAGE(this, x, y, 1, 1);
 }
 
 void Image::makeColorTransparent(const RGBA& bgColor, int haloSize, int shadowOpacity)
@@ -130,6 +135,7 @@ void Image::performTransparencyHack(const RGBA& transColor,
  */
 void Image::putPixelIndex(int x, int y, uint32_t index) {
     pixels[ y*w + x ] = index;
+    DAMAGE(this, x, y, 1, 1);
 }
 
 /**
@@ -137,6 +143,7 @@ void Image::putPixelIndex(int x, int y, uint32_t index) {
  */
 void Image::fill(const RGBA& col) {
     image32_fill(this, &col);
+    DAMAGE(this, 0, 0, w, h);
 }
 
 /**
@@ -150,6 +157,7 @@ void Image::fillRect(int x, int y, int rw, int rh, int r, int g, int b, int a) {
     int blitW, blitH;
 
     rgba_set(ri.col, r, g, b, a);
+    DAMAGE(this, x, y, rw, rh);
 
     blitW = rw;
     if ((blitW + x) > int(w))
@@ -201,6 +209,7 @@ void Image::getPixelIndex(int x, int y, unsigned int &index) const {
  */
 void Image::draw(int x, int y) const {
     image32_blit(xu4.screenImage, x, y, this, blending);
+    screenMarkDirty(x, y, w, h);
 }
 
 /**
@@ -209,6 +218,20 @@ void Image::draw(int x, int y) const {
  */
 void Image::drawSubRect(int x, int y, int rx, int ry, int rw, int rh) const {
     image32_blitRect(xu4.screenImage, x, y, this, rx, ry, rw, rh, blending);
+    screenMarkDirty(x, y, rw, rh);
+}
+
+/** Draws the image onto another image. */
+void Image::drawOn(Image *d, int x, int y) const {
+    image32_blit(d, x, y, this, blending);
+    DAMAGE(d, x, y, w, h);
+}
+
+/** Draws a piece of the image onto another image. */
+void Image::drawSubRectOn(Image *d, int x, int y,
+                          int rx, int ry, int rw, int rh) const {
+    image32_blitRect(d, x, y, this, rx, ry, rw, rh, blending);
+    DAMAGE(d, x, y, rw, rh);
 }
 
 /**
@@ -236,6 +259,7 @@ void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
     // Clip position and source rect to positive values.
     CLIP_SUB(dx, sx, sw, w, dest->w)
     CLIP_SUB(dy, sy, sh, h, dest->h)
+    screenMarkDirty(dx, dy, sw, sh);
 
     srow = pixels + w * sy + sx;
     drow = dest->pixels + dest->w * dy + dx;
@@ -302,6 +326,7 @@ void Image::drawSubRectInvertedOn(Image *dest, int x, int y, int rx, int ry, int
     // Clip position and source rect to positive values.
     CLIP_SUB(x, rx, rw, w, dest->w)
     CLIP_SUB(y, ry, rh, h, dest->h)
+    DAMAGE(dest, x, y, rw, rh);
 
     srow = pixels + w * ry + rx;
     drow = dest->pixels + dest->w * y + x;
@@ -328,6 +353,7 @@ void Image::drawHighlight(int rx, int ry, int rw, int rh) {
 
     assert((rx+rw) <= w);
     assert((ry+rh) <= h);
+    DAMAGE(this, rx, ry, rw, rh);
 
     while (rh--) {
         cp = crow;
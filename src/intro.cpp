@@ -245,6 +245,7 @@ IntroController::IntroController() :
     speedMenu.add(MI_SPEED_05, new IntMenuItem("Inn Rest Length           %3d sec",  2,  6,/*'i'*/  0, &settingsChanged.innTime, 1, MAX_INN_TIME, 1));
     speedMenu.add(MI_SPEED_06, new IntMenuItem("Shrine Meditation Length  %3d sec",  2,  7,/*'s'*/  0, &settingsChanged.shrineTime, 1, MAX_SHRINE_TIME, 1));
     speedMenu.add(MI_SPEED_07, new IntMenuItem("Screen Shake Interval     %3d msec", 2,  8,/*'r'*/  2, &settingsChanged.shakeInterval, MIN_SHAKE_INTERVAL, MAX_SHAKE_INTERVAL, 10));
+    speedMenu.add(MI_SPEED_08, new BoolMenuItem("Fast Combat               %s",      2,  9,/*'f'*/  0, &settingsChanged.fastCombat));
     speedMenu.add(USE_SETTINGS,                "\010 Use These Settings",            2, 11,/*'u'*/  2);
     speedMenu.add(CANCEL,                      "\010 Cancel",                        2, 12,/*'c'*/  2);
     speedMenu.addShortcutKey(CANCEL, ' ');
@@ -321,6 +322,11 @@ bool IntroController::init() {
     justInitiatedNewGame = false;
     introMusic = MUSIC_TOWNS;
 
+    // Decode the sound effects while the title screens run.  This is done
+    // before the group is set so that the buffers are kept for the game.
+    uint16_t voices[1] = { VOICE_GYPSY };
+    soundPreload(voices, 1);
+
     uint16_t saveGroup = xu4_setResourceGroup(StageIntro);
 
     // sigData is referenced during Titles initialization
@@ -394,7 +400,7 @@ void IntroController::deleteIntro() {
 #ifdef GPU_RENDER
     // Ensure that any running map animations are freed.
     Animator* fa = &xu4.eventHandler->flourishAnim;
-    if (fa->used)
+    if (fa->cycleCount || fa->linearCount)
         anim_clear(fa);
 #else
     delete [] objectStateTable;
@@ -1185,9 +1191,9 @@ void IntroController::timerFired() {
     if (beastiesVisible)
         drawBeasties();
 
-    if (xu4_random(2) && ++beastie1Cycle >= IntroBinData::BEASTIE1_FRAMES)
+    if (xu4_randomFx(2) && ++beastie1Cycle >= IntroBinData::BEASTIE1_FRAMES)
         beastie1Cycle = 0;
-    if (xu4_random(2) && ++beastie2Cycle >= IntroBinData::BEASTIE2_FRAMES)
+    if (xu4_randomFx(2) && ++beastie2Cycle >= IntroBinData::BEASTIE2_FRAMES)
         beastie2Cycle = 0;
 
     screenUploadToGPU();
@@ -1407,8 +1413,7 @@ void IntroController::updateSpeedMenu(MenuEvent &event) {
             xu4.settings->write();
 
             // re-initialize events
-            xu4.eventHandler->setTimerInterval(1000 /
-                                        xu4.settings->gameCyclesPerSecond);
+            xu4.eventHandler->setTimerRate(xu4.settings->gameCyclesPerSecond);
             break;
         case CANCEL:
             // discard settings
@@ -2125,8 +2130,7 @@ bool IntroController::updateTitle()
         if (title == titles.end())
         {
             // reset the timer to the pre-titles granularity
-            xu4.eventHandler->setTimerInterval(1000 /
-                                        xu4.settings->gameCyclesPerSecond);
+            xu4.eventHandler->setTimerRate(xu4.settings->gameCyclesPerSecond);
 
             // make sure the titles only appear when the app first loads
             bSkipTitles = true;
@@ -284,6 +284,7 @@ int moveObject(Map *map, Creature *obj, const Coords& avatar) {
         ! MAP_IS_OOB(map, new_coords))
     {
         obj->coords = new_coords;
+        ++objectMoveRev;
     }
     return 1;
 }
@@ -218,7 +218,8 @@ bool map_outOfBounds(const Map* map, const Coords& c) {
  */
 
 Map::Map() {
-    _pad = 0;
+    dataRev = 0;
+    objectsRev = 0;
     width = 0;
     height = 0;
     levels = 1;
@@ -246,77 +247,25 @@ const char* Map::getName() const {
 }
 
 /*
- * Build BlockingGroups for use by the shadow casting shader.
+ * Fill a grid of width * height bytes with the Tile::opaque shape of each
+ * tile on the first level of the map.  This is used as the occluder
+ * texture by the shadow casting shader.
+ *
+ * Return the number of opaque tiles.
  */
-void Map::queryBlocking(BlockingGroups* bg, int sx, int sy, int vw, int vh) const {
-    const Tile* tile;
-    int centerX, leftEndX, maxX;
-    int centerY, maxY;
-    int x, y, di;
-    int count;
-    float* pos = bg->tilePos;
-    float* posEnd = pos + BLOCKING_POS_SIZE;
-
-    centerX = sx + vw / 2;
-    centerY = sy + vw / 2;
-
-    // Initialize counts in case the function aborts (buffer_full).
-    bg->left = bg->center = bg->right = 0;
-
-    // Handle negative start positions.
-    if (sx < 0) {
-        vw += sx;   // Subtracts sx.
-        sx = 0;
-    }
-    if (sy < 0) {
-        vh += sy;   // Subtracts sy.
-        sy = 0;
-    }
-
-    maxX = sx + vw;
-    if (maxX > width)
-        maxX = width;
-    maxY = sy + vh;
-    if (maxY > height)
-        maxY = height;
-
-#define BLOCKING_COLUMN \
-    for (di = sy * width + x, y = sy; y < maxY; di += width, ++y) { \
-        tile = tileset->get(data[di]); \
-        if (tile->opaque) { \
-            if (pos == posEnd) \
-                goto buffer_full; \
-            *pos++ = (float) (x - centerX); \
-            *pos++ = (float) (y - centerY); \
-            *pos++ = (float) tile->opaque; \
-            ++count; \
-        } \
-    }
+int Map::queryBlocking(uint8_t* grid) const {
+    const TileId* it  = data;
+    const TileId* end = it + width * height;
+    int count = 0;
+    uint8_t opaque;
 
-    // Gather blocking tiles in column left to right order.
-
-    leftEndX = (centerX < width) ? centerX : width;
-    count = 0;
-    for (x = sx; x < leftEndX; ++x) {
-        BLOCKING_COLUMN
-    }
-    bg->left = count;
-
-    count = 0;
-    if (centerX < width) {
-        BLOCKING_COLUMN
+    for (; it != end; ++it) {
+        opaque = tileset->get(*it)->opaque;
+        *grid++ = opaque;
+        if (opaque)
+            ++count;
     }
-    bg->center = count;
-
-    count = 0;
-    for (++x; x < maxX; ++x) {
-        BLOCKING_COLUMN
-    }
-    bg->right = count;
-    return;
-
-buffer_full:
-    fprintf(stderr, "Map::queryBlocking pos buffer full!\n" );
+    return count;
 }
 
 /*
@@ -490,6 +439,7 @@ const Tile* Map::tileTypeAt(const Coords &coords, int withObjects) const {
 void Map::setTileAt(const Coords& coords, TileId tid) {
     int i = (coords.z * width * height) + (coords.y * width) + coords.x;
     data[i] = tid;
+    ++dataRev;
 }
 
 /**
@@ -575,6 +525,7 @@ Creature *Map::addCreature(const Creature *creature, const Coords& coords) {
 
     /* place the creature on the map */
     objects.push_back(m);
+    ++objectsRev;
     return m;
 }
 
@@ -583,6 +534,7 @@ Creature *Map::addCreature(const Creature *creature, const Coords& coords) {
  */
 Object *Map::addObject(Object *obj, Coords coords) {
     objects.push_back(obj);
+    ++objectsRev;
     return obj;
 }
 
@@ -594,6 +546,7 @@ Object *Map::addObject(MapTile tile, MapTile prevtile, const Coords& coords) {
     obj->placeOnMap(this, coords);
 
     objects.push_back(obj);
+    ++objectsRev;
 
     return obj;
 }
@@ -616,6 +569,7 @@ bool Map::removeObject(const Object *rem, bool deleteObject) {
             if (deleteObject && ! isPartyMember(*i))
                 delete (*i);
             objects.erase(i);
+            ++objectsRev;
             return true;
         }
     }
@@ -626,6 +580,7 @@ ObjectDeque::iterator Map::removeObject(ObjectDeque::iterator rem, bool deleteOb
     /* Party members persist through different maps, so don't delete them! */
     if (!isPartyMember(*rem) && deleteObject)
         delete (*rem);
+    ++objectsRev;
     return objects.erase(rem);
 }
 
@@ -694,6 +649,7 @@ void Map::clearObjects() {
             delete *o;
     }
     objects.clear();
+    ++objectsRev;
 }
 
 /**
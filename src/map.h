@@ -34,12 +34,6 @@ typedef std::deque<const Object *> CObjectDeque;
 #define WITH_GROUND_OBJECTS 1
 #define WITH_OBJECTS        2
 
-#define BLOCKING_POS_SIZE   128*3
-struct BlockingGroups {
-    int left, center, right;
-    float tilePos[BLOCKING_POS_SIZE];
-};
-
 /**
  * Map class
  */
@@ -70,7 +64,7 @@ public:
     // Member functions
     virtual const char* getName() const;
 
-    void queryBlocking(BlockingGroups*, int sx, int sy, int vw, int vh) const;
+    int  queryBlocking(uint8_t* grid) const;
     void queryVisible(const Coords &coords, int radius,
                       void (*func)(const Coords*, VisualId, void*),
                       void* user, const Object** focus) const;
@@ -112,7 +106,8 @@ public:
     MapId           id;
     uint8_t         type;
     uint8_t         border_behavior;    // BorderBehavior
-    uint8_t         _pad;
+    uint8_t         dataRev;            // Incremented when data changes.
+    uint16_t        objectsRev;         // Incremented when objects change.
     uint16_t        width,
                     height,
                     levels;
@@ -13,6 +13,8 @@
 #include "error.h"
 #include "mapmgr.h"
 #include "person.h"
+#include "savegame.h"
+#include "sound.h"
 #include "u4file.h"
 #include "xu4.h"
 
@@ -335,15 +337,17 @@ static void initDungeonRoom(Dungeon *dng, int room) {
 }
 
 /**
- * Loads a dungeon map from the 'dng' file (and dngmap.sav if provided).
+ * Loads a dungeon map from the 'dng' file (and dngmap.sav if restore is set
+ * and the saved game has one).
  */
-static bool loadDungeonMap(Map *map, U4FILE *uf, FILE *sav) {
+static bool loadDungeonMap(Map *map, U4FILE *uf, bool restore) {
     Dungeon *dungeon = dynamic_cast<Dungeon*>(map);
     const UltimaSaveIds* usaveIds = xu4.config->usaveIds();
     char padding[7];
     unsigned int i, j;
     uint8_t* rawMap;
     size_t bytes;
+    int n;
 
     // NOTE: Changes here must work in tandem with Dungeon::unloadRooms()!
 
@@ -358,8 +362,9 @@ static bool loadDungeonMap(Map *map, U4FILE *uf, FILE *sav) {
     bytes = DNG_HEIGHT * DNG_WIDTH * dungeon->levels;
     dungeon->rawMap.reserve(bytes);
     rawMap = &dungeon->rawMap.front();
-    if (sav) {
-        i = fread(rawMap, 1, bytes, sav);
+    n = restore ? saveGameReadFile(SAVE_DNGMAP, rawMap, bytes) : -1;
+    if (n >= 0) {
+        i = n;
         u4fseek(uf, bytes, SEEK_CUR);
     } else {
         i = u4fread(rawMap, 1, bytes, uf);
@@ -504,6 +509,13 @@ static bool loadDungeonMap(Map *map, U4FILE *uf, FILE *sav) {
 
 #ifdef CONF_MODULE
 static bool loadCityXu4(Map* map, U4FILE* uf, size_t npcCount) {
+    City* city = dynamic_cast<City*>(map);
+
+    // All the city Persons share one talk chunk; read it while the map
+    // and NPCs are being loaded.
+    const char* tlkName = xu4.config->confString(city->tlk_fname);
+    discourse_prefetch(tlkName);
+
     if (! loadMapData(map, uf, Tile::sym.grass))
         return false;
 
@@ -513,7 +525,6 @@ static bool loadCityXu4(Map* map, U4FILE* uf, size_t npcCount) {
 
     size_t n = u4fread(npcBuffer, sizeof(Xu4MapNpc), npcCount, uf);
     if (n == npcCount) {
-        City* city = dynamic_cast<City*>(map);
         const Xu4MapNpc* npc = npcBuffer;
         for (size_t i = 0; i < npcCount; ++i) {
             //printf("NPC %ld %d,%d %d\n", i, npc->x, npc->y, npc->role);
@@ -539,10 +550,12 @@ static bool loadCityXu4(Map* map, U4FILE* uf, size_t npcCount) {
         }
         ok = true;
 
-        const char* err = discourse_load(&city->disc,
-                                    xu4.config->confString(city->tlk_fname));
+        const char* err = discourse_load(&city->disc, tlkName);
         if (err)
             errorFatal(err);
+
+        uint16_t voices[8];
+        soundPreload(voices, discourse_voiceStreams(&city->disc, voices, 8));
     }
 
     delete[] npcBuffer;
@@ -550,7 +563,7 @@ static bool loadCityXu4(Map* map, U4FILE* uf, size_t npcCount) {
 }
 #endif
 
-bool loadMap(Map *map, FILE* sav) {
+bool loadMap(Map *map, bool restore) {
     U4FILE* uf;
     bool ok = false;
 
@@ -600,7 +613,7 @@ bool loadMap(Map *map, FILE* sav) {
                 break;
 
             case Map::DUNGEON:
-                ok = loadDungeonMap(map, uf, sav);
+                ok = loadDungeonMap(map, uf, restore);
                 break;
 
             case Map::WORLD:
@@ -37,6 +37,7 @@ void mod_init(Module* mod, int layers)
     ur_arrInit(&mod->fileIndex, sizeof(HashEntry), 64);
     sst_init(&mod->modulePaths, layers, 128);
     memset(&mod->category, MOD_UNKNOWN, 4);
+    memset(&mod->sorted, 0, 4);
 }
 
 void mod_free(Module* mod)
@@ -46,22 +47,42 @@ void mod_free(Module* mod)
     sst_free(&mod->modulePaths);
 }
 
-static void mod_registerFile(Module* mod, uint32_t hash, int entryIndex)
+/*
+ * Return the position of hash in the sorted fileIndex, or where it would
+ * be inserted.
+ */
+static uint32_t mod_fileSlot(const Module* mod, uint32_t hash)
 {
-    HashEntry* fi  = FILE_INDEX(mod);
-    HashEntry* end = fi + mod->fileIndex.used;
-    while (fi != end) {
-        if (fi->hash == hash) {
-            // Overwrite existing HashEntry.
-            fi->entry = entryIndex;
-            return;
-        }
-        ++fi;
+    const HashEntry* fi = FILE_INDEX(mod);
+    uint32_t lo = 0;
+    uint32_t hi = mod->fileIndex.used;
+    uint32_t mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (fi[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
+    return lo;
+}
 
-    // Append new HashEntry.
+static void mod_registerFile(Module* mod, uint32_t hash, int entryIndex)
+{
     UBuffer* buf = &mod->fileIndex;
-    ur_arrExpand1(HashEntry, buf, fi);
+    uint32_t n = mod_fileSlot(mod, hash);
+    HashEntry* fi = FILE_INDEX(mod) + n;
+
+    if (n < (uint32_t) buf->used && fi->hash == hash) {
+        // Overwrite existing HashEntry.
+        fi->entry = entryIndex;
+        return;
+    }
+
+    // Insert new HashEntry, keeping the index sorted by hash.
+    ur_arrExpand(buf, n, 1);
+    fi = FILE_INDEX(mod) + n;
     fi->hash  = hash;
     fi->entry = entryIndex;
 }
@@ -73,9 +94,17 @@ typedef struct
     uint8_t* modiBuf;
     FILE* fp;
     int tocLen;
+    int sorted;
 }
 ModuleLoader;
 
+static const CDIEntry* ml_findAppId(const ModuleLoader* ml, uint32_t id)
+{
+    if (ml->sorted)
+        return cdi_searchAppId(ml->toc, ml->tocLen, id);
+    return cdi_findAppId(ml->toc, ml->tocLen, id);
+}
+
 static void mod_closeModule(ModuleLoader* ml)
 {
     free(ml->toc);
@@ -115,8 +144,9 @@ static const char* mod_openModule(ModuleLoader* ml, const char* filename,
         return "No module TOC";
     }
     ml->tocLen = ml->header.bytes / sizeof(CDIEntry);
+    ml->sorted = cdi_isSortedTOC(ml->toc, ml->tocLen);
 
-    ent = cdi_findAppId(ml->toc, ml->tocLen, APPID_MODI);
+    ent = ml_findAppId(ml, APPID_MODI);
     if (ent) {
         ml->modiBuf = cdi_loadPakChunk(ml->fp, ent);
         if (! ml->modiBuf) {
@@ -285,6 +315,8 @@ const char* mod_addLayer(Module* mod, const char* filename,
     }
 
     mod->category[layerNum] = (hasMusic && ! nonMusic) ? MOD_SOUNDTRACK : cat;
+    mod->sorted[layerNum] = ml.sorted;
+    mod->layerStart[layerNum] = start;
     }
 
     // Append module path.
@@ -293,7 +325,7 @@ const char* mod_addLayer(Module* mod, const char* filename,
 #define NO_PTR(ptr, msg)    if (! ptr) { error = msg; goto fail_layer; }
 
     // Add fileIndex entries for FNAM strings.
-    ent = cdi_findAppId(ml.toc, ml.tocLen, CDI32('F','N','A','M'));
+    ent = ml_findAppId(&ml, CDI32('F','N','A','M'));
     if (ent) {
         uint8_t* fnamBuf = cdi_loadPakChunk(ml.fp, ent);
         NO_PTR(fnamBuf, "Read FNAM failed");
@@ -327,7 +359,7 @@ const char* mod_addLayer(Module* mod, const char* filename,
                 }
                 appId = CDI32(a, b, (extIdMask | (i >> 8)), (i & 0xff));
 
-                ent = cdi_findAppId(ml.toc, ml.tocLen, appId);
+                ent = ml_findAppId(&ml, appId);
                 if (ent)
                     mod_registerFile(mod, hash, start + (ent - ml.toc));
             }
@@ -337,7 +369,7 @@ const char* mod_addLayer(Module* mod, const char* filename,
 
     // Process CONF chunk.
     if (config) {
-        ent = cdi_findAppId(ml.toc, ml.tocLen, APPID_CONF);
+        ent = ml_findAppId(&ml, APPID_CONF);
         NO_PTR(ent, "Module CONF not found");
         error = config(ml.fp, ent, user);
         //if (error) goto fail_layer;
@@ -362,6 +394,7 @@ void mod_removeLayer(Module* mod)
     paths->storeUsed = paths->table[layer].start;
 
     mod->category[layer] = MOD_UNKNOWN;
+    mod->sorted[layer] = 0;
 
     const CDIEntry* ent = (CDIEntry*) mod->entries.ptr.v;
     const CDIEntry* it  = ent + mod->entries.used;
@@ -384,15 +417,40 @@ const char* mod_path(const Module* mod, const CDIEntry* ent)
     return sst_stringL(&mod->modulePaths, i, &len);
 }
 
+/*
+ * Return the last entry with the given appId in the topmost layer which has
+ * one, or NULL if not found.
+ */
 const CDIEntry* mod_findAppId(const Module* mod, uint32_t id)
 {
-    // Search in reverse order.
-    const CDIEntry* end = ENTRIES(mod) - 1;
-    const CDIEntry* it  = end + mod->entries.used;
-    while (it != end) {
-        if (it->appId == id)
-            return it;
-        --it;
+    // Search layers in reverse order.
+    const CDIEntry* ent = ENTRIES(mod);
+    const CDIEntry* it;
+    const CDIEntry* end = ent + mod->entries.used;
+    const CDIEntry* found;
+    int layer = mod->modulePaths.used;
+
+    while (layer) {
+        --layer;
+        it = ent + mod->layerStart[layer];
+        if (mod->sorted[layer]) {
+            found = cdi_searchAppId(it, end - it, id);
+            if (found) {
+                // Duplicates are sorted in file order; the last one wins as
+                // with the reverse scan of unsorted layers.
+                while (found + 1 != end && found[1].appId == id)
+                    ++found;
+                return found;
+            }
+        } else {
+            found = end;
+            while (found != it) {
+                --found;
+                if (found->appId == id)
+                    return found;
+            }
+        }
+        end = it;
     }
     return NULL;
 }
@@ -400,13 +458,10 @@ const CDIEntry* mod_findAppId(const Module* mod, uint32_t id)
 const CDIEntry* mod_fileEntry(const Module* mod, const char* filename)
 {
     uint32_t hash = hashFunc(filename, strlen(filename));
-    const HashEntry* fi  = FILE_INDEX(mod);
-    const HashEntry* end = fi + mod->fileIndex.used;
-    while (fi != end) {
-        if (fi->hash == hash)
-            return ENTRIES(mod) + fi->entry;
-        ++fi;
-    }
+    uint32_t n = mod_fileSlot(mod, hash);
+    const HashEntry* fi = FILE_INDEX(mod) + n;
+    if (n < (uint32_t) mod->fileIndex.used && fi->hash == hash)
+        return ENTRIES(mod) + fi->entry;
     return NULL;
 }
 
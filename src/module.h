@@ -9,7 +9,9 @@ typedef struct
     UBuffer entries;            // Master CDIEntry array
     UBuffer fileIndex;          // Master FNAM index into entries
     StringTable modulePaths;    // Layer file names
+    uint32_t layerStart[4];     // First entries index of each layer.
     uint8_t category[4];        // ModuleCategory for each modulePaths entry.
+    uint8_t sorted[4];          // Non-zero if layer TOC is sorted by appId.
 }
 Module;
 
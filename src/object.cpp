@@ -13,6 +13,8 @@
 
 extern bool isPartyMember(const Object*);
 
+uint32_t objectMoveRev = 0;
+
 Object::Object(Type type) :
   tile(0),
   prevTile(0),
@@ -43,6 +45,7 @@ void Object::placeOnMap(Map* map, const Coords& pos) {
         ++onMaps;
 
     coords = prevCoords = pos;
+    ++objectMoveRev;
 
     /* Start frame animation */
     if (animId == ANIM_UNUSED) {
@@ -19,6 +19,9 @@ typedef enum {
 
 class Map;
 
+// Incremented whenever the coords of any Object change.
+extern uint32_t objectMoveRev;
+
 class Object {
 public:
     enum Type {
@@ -36,6 +39,7 @@ public:
     void updateCoords(const Coords& c) {
         prevCoords = coords;
         coords = c;
+        ++objectMoveRev;
     }
 
     void placeOnMap(Map*, const Coords&);
@@ -370,12 +370,24 @@ bool PartyMember::applyDamage(Map* map, int damage, bool) {
     return true;
 }
 
-int PartyMember::getAttackBonus() const {
+int player_attackBonus(const SaveGamePlayerRecord* player) {
     if (xu4.config->weapon(player->weapon)->alwaysHits() || player->dex >= 40)
     return 255;
     return player->dex;
 }
 
+int player_maxDamage(const SaveGamePlayerRecord* player) {
+    int maxDamage = xu4.config->weapon(player->weapon)->damage;
+    maxDamage += player->str;
+    if (maxDamage > 255)
+        maxDamage = 255;
+    return maxDamage;
+}
+
+int PartyMember::getAttackBonus() const {
+    return player_attackBonus(player);
+}
+
 int PartyMember::getDefense() const {
     return xu4.config->armor(player->armor)->defense;
 }
@@ -397,14 +409,7 @@ bool PartyMember::dealDamage(Map* map, Creature *m, int damage) {
  * Calculate damage for an attack.
  */
 int PartyMember::getDamage() {
-    int maxDamage;
-
-    maxDamage = xu4.config->weapon(player->weapon)->damage;
-    maxDamage += player->str;
-    if (maxDamage > 255)
-        maxDamage = 255;
-
-    return xu4_random(maxDamage);
+    return xu4_random(player_maxDamage(player));
 }
 
 /**
@@ -222,5 +222,7 @@ private:
 };
 
 bool isPartyMember(const Object *punknown);
+int  player_attackBonus(const SaveGamePlayerRecord*);
+int  player_maxDamage(const SaveGamePlayerRecord*);
 
 #endif
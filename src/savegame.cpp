@@ -4,198 +4,182 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "savegame.h"
 
 
-static int writeInt(uint32_t i, FILE *f) {
-    if (fputc(i & 0xff, f) == EOF ||
-        fputc((i >> 8) & 0xff, f) == EOF ||
-        fputc((i >> 16) & 0xff, f) == EOF ||
-        fputc((i >> 24) & 0xff, f) == EOF)
-        return 0;
-    return 1;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BIG_ENDIAN
+#endif
+
+static inline uint8_t* packInt(uint8_t* dp, uint32_t i) {
+    dp[0] = i;
+    dp[1] = i >> 8;
+    dp[2] = i >> 16;
+    dp[3] = i >> 24;
+    return dp + 4;
 }
 
-static int writeShort(uint16_t s, FILE *f) {
-    if (fputc(s & 0xff, f) == EOF ||
-        fputc((s >> 8) & 0xff, f) == EOF)
-        return 0;
-    return 1;
+static inline uint8_t* packShort(uint8_t* dp, uint16_t s) {
+    dp[0] = s;
+    dp[1] = s >> 8;
+    return dp + 2;
 }
 
-static int writeChar(uint8_t c, FILE *f) {
-    if (fputc(c, f) == EOF)
-        return 0;
-    return 1;
+// Pack an array of shorts in little-endian order.
+static uint8_t* packShorts(uint8_t* dp, const void* src, int count) {
+#ifdef HOST_BIG_ENDIAN
+    const uint16_t* it = (const uint16_t*) src;
+    for (int i = 0; i < count; ++i)
+        dp = packShort(dp, it[i]);
+    return dp;
+#else
+    memcpy(dp, src, count * 2);
+    return dp + count * 2;
+#endif
 }
 
-static int readInt(uint32_t *i, FILE *f) {
-    *i = fgetc(f);
-    *i |= (fgetc(f) << 8);
-    *i |= (fgetc(f) << 16);
-    *i |= (fgetc(f) << 24);
-    return 1;
+static inline uint32_t unpackInt(const uint8_t* sp) {
+    return sp[0] | (sp[1] << 8) | (sp[2] << 16) | ((uint32_t) sp[3] << 24);
 }
 
-static int readShort(uint16_t *s, FILE *f) {
-    *s = fgetc(f);
-    *s |= (fgetc(f) << 8);
-    return 1;
+static inline uint16_t unpackShort(const uint8_t* sp) {
+    return sp[0] | (sp[1] << 8);
 }
 
-static int readChar(uint8_t *c, FILE *f) {
-    *c = fgetc(f);
-    return 1;
+// Unpack an array of little-endian shorts.
+static const uint8_t* unpackShorts(const uint8_t* sp, void* dst, int count) {
+#ifdef HOST_BIG_ENDIAN
+    uint16_t* it = (uint16_t*) dst;
+    for (int i = 0; i < count; ++i, sp += 2)
+        it[i] = unpackShort(sp);
+    return sp;
+#else
+    memcpy(dst, sp, count * 2);
+    return sp + count * 2;
+#endif
 }
 
 
-int SaveGame::write(FILE *f) const {
+/*
+ * Serialize to the PARTY.SAV format.  The buffer must hold SAVEGAME_SIZE
+ * bytes.  Return a pointer to the end of the data.
+ */
+uint8_t* SaveGame::pack(uint8_t* dp) const {
     int i;
 
-    if (!writeInt(unknown1, f) ||
-        !writeInt(moves, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!players[i].write(f))
-            return 0;
-    }
-
-    if (!writeInt(food, f) ||
-        !writeShort(gold, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!writeShort(karma[i], f))
-            return 0;
-    }
-
-    if (!writeShort(torches, f) ||
-        !writeShort(gems, f) ||
-        !writeShort(keys, f) ||
-        !writeShort(sextants, f))
-        return 0;
-
-    for (i = 0; i < ARMR_MAX; i++) {
-        if (!writeShort(armor[i], f))
-            return 0;
-    }
+    dp = packInt(dp, unknown1);
+    dp = packInt(dp, moves);
 
-    for (i = 0; i < WEAP_MAX; i++) {
-        if (!writeShort(weapons[i], f))
-            return 0;
-    }
-
-    for (i = 0; i < REAG_MAX; i++) {
-        if (!writeShort(reagents[i], f))
-            return 0;
-    }
-
-    for (i = 0; i < SPELL_MAX; i++) {
-        if (!writeShort(mixtures[i], f))
-            return 0;
-    }
-
-    if (!writeShort(items, f) ||
-        !writeChar(x, f) ||
-        !writeChar(y, f) ||
-        !writeChar(stones, f) ||
-        !writeChar(runes, f) ||
-        !writeShort(members, f) ||
-        !writeShort(transport, f) ||
-        !writeShort(balloonstate, f) ||
-        !writeShort(trammelphase, f) ||
-        !writeShort(feluccaphase, f) ||
-        !writeShort(shiphull, f) ||
-        !writeShort(lbintro, f) ||
-        !writeShort(lastcamp, f) ||
-        !writeShort(lastreagent, f) ||
-        !writeShort(lastmeditation, f) ||
-        !writeShort(lastvirtue, f) ||
-        !writeChar(dngx, f) ||
-        !writeChar(dngy, f) ||
-        !writeShort(orientation, f) ||
-        !writeShort(dnglevel, f) ||
-        !writeShort(location, f))
-        return 0;
+    for (i = 0; i < 8; i++)
+        dp = players[i].pack(dp);
+
+    dp = packInt(dp, food);
+    dp = packShort(dp, gold);
+    dp = packShorts(dp, karma, VIRT_MAX);
+    dp = packShort(dp, torches);
+    dp = packShort(dp, gems);
+    dp = packShort(dp, keys);
+    dp = packShort(dp, sextants);
+    dp = packShorts(dp, armor, ARMR_MAX);
+    dp = packShorts(dp, weapons, WEAP_MAX);
+    dp = packShorts(dp, reagents, REAG_MAX);
+    dp = packShorts(dp, mixtures, SPELL_MAX);
+    dp = packShort(dp, items);
+    *dp++ = x;
+    *dp++ = y;
+    *dp++ = stones;
+    *dp++ = runes;
+    dp = packShort(dp, members);
+    dp = packShort(dp, transport);
+    dp = packShort(dp, balloonstate);
+    dp = packShort(dp, trammelphase);
+    dp = packShort(dp, feluccaphase);
+    dp = packShort(dp, shiphull);
+    dp = packShort(dp, lbintro);
+    dp = packShort(dp, lastcamp);
+    dp = packShort(dp, lastreagent);
+    dp = packShort(dp, lastmeditation);
+    dp = packShort(dp, lastvirtue);
+    *dp++ = dngx;
+    *dp++ = dngy;
+    dp = packShort(dp, orientation);
+    dp = packShort(dp, dnglevel);
+    dp = packShort(dp, location);
+    return dp;
+}
 
-    return 1;
+int SaveGame::write(FILE *f) const {
+    uint8_t buf[SAVEGAME_SIZE];
+    pack(buf);
+    return fwrite(buf, 1, SAVEGAME_SIZE, f) == SAVEGAME_SIZE;
 }
 
-int SaveGame::read(FILE *f) {
+/*
+ * Deserialize from the PARTY.SAV format.  The buffer must hold SAVEGAME_SIZE
+ * bytes.  Return a pointer to the end of the data.
+ */
+const uint8_t* SaveGame::unpack(const uint8_t* sp) {
     int i;
 
-    if (!readInt(&unknown1, f) ||
-        !readInt(&moves, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!players[i].read(f))
-            return 0;
-    }
+    unknown1 = unpackInt(sp);
+    moves    = unpackInt(sp + 4);
+    sp += 8;
 
-    if (!readInt((unsigned int*)&food, f) ||
-        !readShort((unsigned short*)&gold, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!readShort((unsigned short*)&(karma[i]), f))
-            return 0;
-    }
-
-    if (!readShort((unsigned short*)&torches, f) ||
-        !readShort((unsigned short*)&gems, f) ||
-        !readShort((unsigned short*)&keys, f) ||
-        !readShort((unsigned short*)&sextants, f))
-        return 0;
-
-    for (i = 0; i < ARMR_MAX; i++) {
-        if (!readShort((unsigned short*)&(armor[i]), f))
-            return 0;
-    }
-
-    for (i = 0; i < WEAP_MAX; i++) {
-        if (!readShort((unsigned short*)&(weapons[i]), f))
-            return 0;
-    }
-
-    for (i = 0; i < REAG_MAX; i++) {
-        if (!readShort((unsigned short*)&(reagents[i]), f))
-            return 0;
-    }
-
-    for (i = 0; i < SPELL_MAX; i++) {
-        if (!readShort((unsigned short*)&(mixtures[i]), f))
-            return 0;
-    }
-
-    if (!readShort(&items, f) ||
-        !readChar(&x, f) ||
-        !readChar(&y, f) ||
-        !readChar(&stones, f) ||
-        !readChar(&runes, f) ||
-        !readShort(&members, f) ||
-        !readShort(&transport, f) ||
-        !readShort(&balloonstate, f) ||
-        !readShort(&trammelphase, f) ||
-        !readShort(&feluccaphase, f) ||
-        !readShort(&shiphull, f) ||
-        !readShort(&lbintro, f) ||
-        !readShort(&lastcamp, f) ||
-        !readShort(&lastreagent, f) ||
-        !readShort(&lastmeditation, f) ||
-        !readShort(&lastvirtue, f) ||
-        !readChar(&dngx, f) ||
-        !readChar(&dngy, f) ||
-        !readShort(&orientation, f) ||
-        !readShort(&dnglevel, f) ||
-        !readShort(&location, f))
-        return 0;
+    for (i = 0; i < 8; i++)
+        sp = players[i].unpack(sp);
+
+    food = unpackInt(sp);
+    gold = unpackShort(sp + 4);
+    sp = unpackShorts(sp + 6, karma, VIRT_MAX);
+    torches  = unpackShort(sp);
+    gems     = unpackShort(sp + 2);
+    keys     = unpackShort(sp + 4);
+    sextants = unpackShort(sp + 6);
+    sp = unpackShorts(sp + 8, armor, ARMR_MAX);
+    sp = unpackShorts(sp, weapons, WEAP_MAX);
+    sp = unpackShorts(sp, reagents, REAG_MAX);
+    sp = unpackShorts(sp, mixtures, SPELL_MAX);
+    items  = unpackShort(sp);
+    x      = sp[2];
+    y      = sp[3];
+    stones = sp[4];
+    runes  = sp[5];
+    sp += 6;
+    members        = unpackShort(sp);
+    transport      = unpackShort(sp + 2);
+    balloonstate   = unpackShort(sp + 4);
+    trammelphase   = unpackShort(sp + 6);
+    feluccaphase   = unpackShort(sp + 8);
+    shiphull       = unpackShort(sp + 10);
+    lbintro        = unpackShort(sp + 12);
+    lastcamp       = unpackShort(sp + 14);
+    lastreagent    = unpackShort(sp + 16);
+    lastmeditation = unpackShort(sp + 18);
+    lastvirtue     = unpackShort(sp + 20);
+    dngx = sp[22];
+    dngy = sp[23];
+    sp += 24;
+    orientation = unpackShort(sp);
+    dnglevel    = unpackShort(sp + 2);
+    location    = unpackShort(sp + 4);
 
     /* workaround of U4DOS bug to retain savegame compatibility */
     if (location == 0 && dnglevel == 0)
         dnglevel = 0xFFFF;
 
+    return sp + 6;
+}
+
+/*
+ * Read PARTY.SAV with a single block read.
+ * Return zero if the file is too short.
+ */
+int SaveGame::read(FILE *f) {
+    uint8_t buf[SAVEGAME_SIZE];
+    if (fread(buf, 1, SAVEGAME_SIZE, f) != SAVEGAME_SIZE)
+        return 0;
+    unpack(buf);
     return 1;
 }
 
@@ -255,71 +239,41 @@ void SaveGame::init(const SaveGamePlayerRecord *avatarInfo) {
     location = 0;
 }
 
-int SaveGamePlayerRecord::write(FILE *f) const {
-    int i;
-
-    if (!writeShort(hp, f) ||
-        !writeShort(hpMax, f) ||
-        !writeShort(xp, f) ||
-        !writeShort(str, f) ||
-        !writeShort(dex, f) ||
-        !writeShort(intel, f) ||
-        !writeShort(mp, f) ||
-        !writeShort(unknown, f) ||
-        !writeShort((unsigned short)weapon, f) ||
-        !writeShort((unsigned short)armor, f))
-        return 0;
-
-    for (i = 0; i < 16; i++) {
-        if (!writeChar(name[i], f))
-            return 0;
-    }
+uint8_t* SaveGamePlayerRecord::pack(uint8_t* dp) const {
+    dp = packShorts(dp, &hp, 8);    // hp to unknown
+    dp = packShort(dp, weapon);
+    dp = packShort(dp, armor);
+    memcpy(dp, name, 16);
+    dp += 16;
+    *dp++ = sex;
+    *dp++ = klass;
+    *dp++ = status;
+    return dp;
+}
 
-    if (!writeChar((unsigned char)sex, f) ||
-        !writeChar((unsigned char)klass, f) ||
-        !writeChar((unsigned char)status, f))
-        return 0;
+int SaveGamePlayerRecord::write(FILE *f) const {
+    uint8_t buf[SAVEGAME_PLAYER_SIZE];
+    pack(buf);
+    return fwrite(buf, 1, SAVEGAME_PLAYER_SIZE, f) == SAVEGAME_PLAYER_SIZE;
+}
 
-    return 1;
+const uint8_t* SaveGamePlayerRecord::unpack(const uint8_t* sp) {
+    sp = unpackShorts(sp, &hp, 8);  // hp to unknown
+    weapon = (WeaponType) unpackShort(sp);
+    armor  = (ArmorType) unpackShort(sp + 2);
+    memcpy(name, sp + 4, 16);
+    sp += 20;
+    sex    = (SexType) sp[0];
+    klass  = (ClassType) sp[1];
+    status = (StatusType) sp[2];
+    return sp + 3;
 }
 
 int SaveGamePlayerRecord::read(FILE *f) {
-    int i;
-    unsigned char ch;
-    unsigned short s;
-
-    if (!readShort(&hp, f) ||
-        !readShort(&hpMax, f) ||
-        !readShort(&xp, f) ||
-        !readShort(&str, f) ||
-        !readShort(&dex, f) ||
-        !readShort(&intel, f) ||
-        !readShort(&mp, f) ||
-        !readShort(&unknown, f))
-        return 0;
-
-    if (!readShort(&s, f))
-        return 0;
-    weapon = (WeaponType) s;
-    if (!readShort(&s, f))
-        return 0;
-    armor = (ArmorType) s;
-
-    for (i = 0; i < 16; i++) {
-        if (!readChar((unsigned char *) &(name[i]), f))
-            return 0;
-    }
-
-    if (!readChar(&ch, f))
-        return 0;
-    sex = (SexType) ch;
-    if (!readChar(&ch, f))
-      return 0;
-    klass = (ClassType) ch;
-    if (!readChar(&ch, f))
+    uint8_t buf[SAVEGAME_PLAYER_SIZE];
+    if (fread(buf, 1, SAVEGAME_PLAYER_SIZE, f) != SAVEGAME_PLAYER_SIZE)
         return 0;
-    status = (StatusType) ch;
-
+    unpack(buf);
     return 1;
 }
 
@@ -345,55 +299,73 @@ void SaveGamePlayerRecord::init() {
     status = STAT_GOOD;
 }
 
-int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f) {
-    int i, max;
-
-    if (monsterTable) {
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].tile, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].x, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].y, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevTile, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevx, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevy, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].level, f)) return 0;
-        for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].unused, f)) return 0;
-    }
-    else {
-        max = MONSTERTABLE_SIZE * 8;
-        for (i = 0; i < max; i++)
-            if (!writeChar((unsigned char)0, f)) return 0;
+/*
+ * Serialize to the MONSTERS.SAV format.  The buffer must hold
+ * MONSTERTABLE_BYTES.  If monsterTable is NULL then an empty table is packed.
+ * Return a pointer to the end of the data.
+ */
+uint8_t* saveGameMonstersPack(const SaveGameMonsterRecord *monsterTable,
+                              uint8_t* dp) {
+    int i;
+
+    if (! monsterTable) {
+        memset(dp, 0, MONSTERTABLE_BYTES);
+        return dp + MONSTERTABLE_BYTES;
     }
-    return 1;
+
+#define PACK_COLUMN(field) \
+    for (i = 0; i < MONSTERTABLE_SIZE; i++) \
+        *dp++ = monsterTable[i].field
+
+    PACK_COLUMN(tile);
+    PACK_COLUMN(x);
+    PACK_COLUMN(y);
+    PACK_COLUMN(prevTile);
+    PACK_COLUMN(prevx);
+    PACK_COLUMN(prevy);
+    PACK_COLUMN(level);
+    PACK_COLUMN(unused);
+    return dp;
 }
 
-int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
+int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f) {
+    uint8_t buf[MONSTERTABLE_BYTES];
+    saveGameMonstersPack(monsterTable, buf);
+    return fwrite(buf, 1, MONSTERTABLE_BYTES, f) == MONSTERTABLE_BYTES;
+}
+
+/*
+ * Deserialize from the MONSTERS.SAV format.  The buffer must hold
+ * MONSTERTABLE_BYTES.  Return a pointer to the end of the data.
+ */
+const uint8_t* saveGameMonstersUnpack(SaveGameMonsterRecord *monsterTable,
+                                      const uint8_t* sp) {
     int i;
 
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].tile, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].x, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].y, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].prevTile, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].prevx, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].prevy, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].level, f)) return 0;
-    for (i = 0; i < MONSTERTABLE_SIZE; i++)
-        if (!readChar(&monsterTable[i].unused, f)) return 0;
+#define UNPACK_COLUMN(field) \
+    for (i = 0; i < MONSTERTABLE_SIZE; i++) \
+        monsterTable[i].field = *sp++
+
+    UNPACK_COLUMN(tile);
+    UNPACK_COLUMN(x);
+    UNPACK_COLUMN(y);
+    UNPACK_COLUMN(prevTile);
+    UNPACK_COLUMN(prevx);
+    UNPACK_COLUMN(prevy);
+    UNPACK_COLUMN(level);
+    UNPACK_COLUMN(unused);
+    return sp;
+}
 
+/*
+ * Read MONSTERS.SAV with a single block read.
+ * Return zero if the file is too short.
+ */
+int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
+    uint8_t buf[MONSTERTABLE_BYTES];
+    if (fread(buf, 1, MONSTERTABLE_BYTES, f) != MONSTERTABLE_BYTES)
+        return 0;
+    saveGameMonstersUnpack(monsterTable, buf);
     return 1;
 }
 
@@ -407,11 +379,19 @@ int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
  */
 SaveGame* saveGameLoad() {
     SaveGame* sg = NULL;
-    FILE* fp = fopen((xu4.settings->getUserPath() + PARTY_SAV).c_str(), "rb");
-    if (fp) {
+    uint8_t buf[SAVEGAME_SIZE];
+    int n;
+
+    saveSetRecover(xu4.settings->getUserPath().c_str());
+
+    n = saveGameReadFile(SAVE_PARTY, buf, SAVEGAME_SIZE);
+    if (n >= 0) {
+        if (n != SAVEGAME_SIZE) {
+            xu4.errorMessage = "Saved game is damaged!";
+            return NULL;
+        }
         sg = new SaveGame;
-        sg->read(fp);
-        fclose(fp);
+        sg->unpack(buf);
 
         // Make sure there are players in party.sav --
         // In the Ultima Collection CD, party.sav exists, but does
@@ -431,6 +411,327 @@ SaveGame* saveGameLoad() {
     }
     return sg;
 }
+
+static const char* saveFileNames[SAVE_FILE_COUNT] = {
+    PARTY_SAV, MONSTERS_SAV, DNGMAP_SAV, OUTMONST_SAV
+};
+
+static SaveSet restoreSet;      // Set while loading a restored game.
+
+/*
+ * Load the saved game from a copy of SaveSet data rather than the files in
+ * the user path.  This restores a snapshot or keyframe without any disk
+ * access and without replacing the player's saved game.
+ * Pass NULL data to go back to the user path once the game is loaded.
+ *
+ * Return false if memory could not be allocated.
+ */
+bool saveGameRestoreFrom(const uint32_t* size, const uint8_t* data) {
+    size_t total = 0;
+    int i;
+
+    free(restoreSet.buf);
+    restoreSet.buf = NULL;
+    if (! data)
+        return true;
+
+    for (i = 0; i < SAVE_FILE_COUNT; ++i) {
+        restoreSet.size[i] = size[i];
+        total += size[i];
+    }
+    restoreSet.buf = (uint8_t*) malloc(total);
+    if (! restoreSet.buf)
+        return false;
+    memcpy(restoreSet.buf, data, total);
+    return true;
+}
+
+/*
+ * Read the start of a saved game file from the restore data or the user
+ * path.
+ *
+ * \param fileId    SaveFileId
+ * \param dst       Buffer for up to bytes of the file.
+ *
+ * Return the number of bytes read or -1 if the file does not exist.
+ */
+int saveGameReadFile(int fileId, void* dst, size_t bytes) {
+    if (restoreSet.buf) {
+        const uint8_t* sp = restoreSet.buf;
+        for (int i = 0; i < fileId; ++i)
+            sp += restoreSet.size[i];
+        if (! restoreSet.size[fileId])
+            return -1;
+        if (bytes > restoreSet.size[fileId])
+            bytes = restoreSet.size[fileId];
+        memcpy(dst, sp, bytes);
+        return bytes;
+    }
+
+    std::string path(xu4.settings->getUserPath() + saveFileNames[fileId]);
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (! fp)
+        return -1;
+    bytes = fread(dst, 1, bytes, fp);
+    fclose(fp);
+    return bytes;
+}
+
+/*
+ * Load MONSTERS.SAV or OUTMONST.SAV.
+ * Return zero if the file does not exist or is too short.
+ */
+int saveGameMonstersLoad(SaveGameMonsterRecord *monsterTable, int fileId) {
+    uint8_t buf[MONSTERTABLE_BYTES];
+    if (saveGameReadFile(fileId, buf, MONSTERTABLE_BYTES) != MONSTERTABLE_BYTES)
+        return 0;
+    saveGameMonstersUnpack(monsterTable, buf);
+    return 1;
+}
+
+//--------------------------------------
+// Asynchronous save writer
+
+#include <string>
+#include "support/threads.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SAVE_COMMIT     "save.commit"
+
+struct SaveWriter {
+    SaveSet set;
+    std::string dir;
+    const char* error[SAVE_WRITE_KINDS];    // Name of file not written.
+    Thread thread;
+    int kind;               // SaveWriteKind of the current set.
+    uint32_t done;          // Set by the thread when the write is finished.
+    bool running;
+};
+
+static SaveWriter saveWriter;
+
+/*
+ * Allocate a buffer for all the files in a SaveSet.  The party & monster
+ * files are always included.
+ *
+ * \param dngmapSize   Bytes in DNGMAP.SAV, or zero if not in a dungeon.
+ * \param outmonst     Set if OUTMONST.SAV is to be written.
+ *
+ * Return pointer to the SaveSet buffer or NULL if memory allocation failed.
+ */
+uint8_t* saveSetAlloc(SaveSet* ss, uint32_t dngmapSize, bool outmonst) {
+    ss->size[SAVE_PARTY]    = SAVEGAME_SIZE;
+    ss->size[SAVE_MONSTERS] = MONSTERTABLE_BYTES;
+    ss->size[SAVE_DNGMAP]   = dngmapSize;
+    ss->size[SAVE_OUTMONST] = outmonst ? MONSTERTABLE_BYTES : 0;
+    ss->buf = (uint8_t*) malloc(SAVEGAME_SIZE + 2 * MONSTERTABLE_BYTES +
+                                dngmapSize);
+    return ss->buf;
+}
+
+static bool syncFile(FILE* fp) {
+    if (fflush(fp) != 0)
+        return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+static bool writeFileSync(const char* path, const void* data, size_t len) {
+    FILE* fp = fopen(path, "wb");
+    if (! fp)
+        return false;
+    bool ok = (fwrite(data, 1, len, fp) == len) && syncFile(fp);
+    return (fclose(fp) == 0) && ok;
+}
+
+static bool replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING |
+                                 MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// Ensure that renames in a directory are on disk.
+static void syncDirectory(const std::string& dir) {
+#ifndef _WIN32
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+/*
+ * Rename the temporary files of a committed set to their final names.
+ * Return the name of the file which failed or NULL if successful.
+ */
+static const char* saveSetRename(const std::string& dir, int fileMask,
+                                 bool recovering) {
+    std::string tmp, dst;
+    int i;
+
+    for (i = 0; i < SAVE_FILE_COUNT; ++i) {
+        if (fileMask & (1 << i)) {
+            dst = dir + saveFileNames[i];
+            tmp = dst + ".tmp";
+            // When recovering, some files may have already been renamed.
+            if (! replaceFile(tmp.c_str(), dst.c_str()) && ! recovering)
+                return saveFileNames[i];
+        }
+    }
+    syncDirectory(dir);
+
+    dst = dir + SAVE_COMMIT;
+    remove(dst.c_str());
+    return NULL;
+}
+
+/*
+ * Write each file of the set to a temporary, then record the set in a commit
+ * file before renaming the temporaries.  If this is interrupted then
+ * saveSetRecover() will either finish the renames (if the commit file exists)
+ * or discard the temporaries, so the save files are always updated as a set.
+ *
+ * Return the name of the file which failed or NULL if successful.
+ */
+static const char* saveSetWriteFiles(const SaveSet* ss, const std::string& dir)
+{
+    std::string path;
+    const uint8_t* data = ss->buf;
+    uint8_t fileMask = 0;
+    int i;
+
+    for (i = 0; i < SAVE_FILE_COUNT; ++i) {
+        if (ss->size[i]) {
+            path = dir + saveFileNames[i] + ".tmp";
+            if (! writeFileSync(path.c_str(), data, ss->size[i]))
+                return saveFileNames[i];
+            data += ss->size[i];
+            fileMask |= 1 << i;
+        }
+    }
+
+    path = dir + SAVE_COMMIT;
+    if (! writeFileSync(path.c_str(), &fileMask, 1))
+        return SAVE_COMMIT;
+    syncDirectory(dir);
+
+    return saveSetRename(dir, fileMask, false);
+}
+
+static THREAD_FUNC saveWriterThread(void* arg) {
+    SaveWriter* sw = (SaveWriter*) arg;
+    sw->error[sw->kind] = saveSetWriteFiles(&sw->set, sw->dir);
+    atomicStore(&sw->done, 1);
+    return THREAD_RETURN;
+}
+
+// Wait for the writer thread without touching the error status.
+static void saveSetJoin(SaveWriter* sw) {
+    if (sw->running) {
+        thread_join(sw->thread);
+        sw->running = false;
+        free(sw->set.buf);
+        sw->set.buf = NULL;
+    }
+}
+
+/*
+ * Write a SaveSet to disk on a background thread.  Any previous write is
+ * waited for first.  The SaveSet buffer is taken over by the writer and
+ * will be freed when the write completes.
+ *
+ * Return false if the files could not be written.  The name of the failed
+ * file can then be obtained from saveSetWait() with the same kind.
+ */
+bool saveSetWriteAsync(SaveSet* ss, const char* userPath, int kind) {
+    SaveWriter* sw = &saveWriter;
+
+    saveSetJoin(sw);
+
+    sw->set = *ss;
+    sw->dir = userPath;
+    sw->kind = kind;
+    sw->error[kind] = NULL;
+    ss->buf = NULL;
+
+    sw->done = 0;
+    if (thread_create(&sw->thread, saveWriterThread, sw)) {
+        sw->running = true;
+        return true;
+    }
+
+    // No thread available; write it now.
+    sw->error[kind] = saveSetWriteFiles(&sw->set, sw->dir);
+    free(sw->set.buf);
+    sw->set.buf = NULL;
+    return sw->error[kind] == NULL;
+}
+
+/*
+ * Wait for any background save to complete.
+ *
+ * Return the name of the file which failed to be written, or NULL if the last
+ * write of the given kind was successful.  The error is cleared.
+ */
+const char* saveSetWait(int kind) {
+    SaveWriter* sw = &saveWriter;
+    const char* error;
+
+    saveSetJoin(sw);
+    error = sw->error[kind];
+    sw->error[kind] = NULL;
+    return error;
+}
+
+/*
+ * Return true if a background save is still being written.
+ */
+bool saveSetBusy() {
+    const SaveWriter* sw = &saveWriter;
+    return sw->running && ! atomicLoad(&sw->done);
+}
+
+/*
+ * Complete or discard any save set write which was interrupted (e.g. by a
+ * power failure).
+ */
+void saveSetRecover(const char* userPath) {
+    std::string dir(userPath);
+    std::string path(dir + SAVE_COMMIT);
+    FILE* fp;
+    int fileMask;
+    int i;
+
+    saveSetJoin(&saveWriter);
+
+    fp = fopen(path.c_str(), "rb");
+    if (fp) {
+        fileMask = fgetc(fp);
+        fclose(fp);
+        if (fileMask != EOF) {
+            saveSetRename(dir, fileMask, true);
+            return;
+        }
+        remove(path.c_str());
+    }
+
+    for (i = 0; i < SAVE_FILE_COUNT; ++i) {
+        path = dir + saveFileNames[i] + ".tmp";
+        remove(path.c_str());
+    }
+}
 #endif
 
 //--------------------------------------
@@ -16,6 +16,10 @@
 #define MONSTERTABLE_SIZE               32
 #define MONSTERTABLE_CREATURES_SIZE     8
 #define MONSTERTABLE_OBJECTS_SIZE       (MONSTERTABLE_SIZE - MONSTERTABLE_CREATURES_SIZE)
+#define MONSTERTABLE_BYTES              (MONSTERTABLE_SIZE * 8)
+
+#define SAVEGAME_PLAYER_SIZE    39      // Bytes on disk
+#define SAVEGAME_SIZE           502     // Bytes on disk
 
 /**
  * The list of all weapons.  These values are used in both the
@@ -166,6 +170,8 @@ enum Rune {
  * The Ultima IV savegame player record data.
  */
 struct SaveGamePlayerRecord {
+    uint8_t* pack(uint8_t* dp) const;
+    const uint8_t* unpack(const uint8_t* sp);
     int write(FILE *f) const;
     int read(FILE *f);
     void init();
@@ -202,6 +208,8 @@ typedef struct _SaveGameMonsterRecord {
  * Represents the on-disk contents of PARTY.SAV.
  */
 struct SaveGame {
+    uint8_t* pack(uint8_t* dp) const;
+    const uint8_t* unpack(const uint8_t* sp);
     int write(FILE *f) const;
     int read(FILE *f);
     void init(const SaveGamePlayerRecord *avatarInfo);
@@ -244,10 +252,51 @@ struct SaveGame {
     uint16_t location;
 };
 
+uint8_t* saveGameMonstersPack(const SaveGameMonsterRecord *monsterTable,
+                              uint8_t* dp);
 int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f);
 int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f);
+const uint8_t* saveGameMonstersUnpack(SaveGameMonsterRecord *monsterTable,
+                                      const uint8_t* sp);
 SaveGame* saveGameLoad();
 
+enum SaveFileId {
+    SAVE_PARTY,
+    SAVE_MONSTERS,
+    SAVE_DNGMAP,
+    SAVE_OUTMONST,
+    SAVE_FILE_COUNT
+};
+
+/**
+ * The serialized contents of a complete set of save files.
+ * The file data is stored sequentially in buf (in SaveFileId order).
+ */
+struct SaveSet {
+    uint8_t* buf;
+    uint32_t size[SAVE_FILE_COUNT];     // Zero if file is not written.
+};
+
+/**
+ * The kinds of SaveSet writes.  Each keeps its own error status so that
+ * one does not report or hide the failure of another.
+ */
+enum SaveWriteKind {
+    SAVE_WRITE_GAME,        // Manual save to the user path.
+    SAVE_WRITE_AUTO,        // Autosave snapshot.
+    SAVE_WRITE_KINDS
+};
+
+uint8_t* saveSetAlloc(SaveSet*, uint32_t dngmapSize, bool outmonst);
+bool saveSetWriteAsync(SaveSet*, const char* userPath,
+                       int kind = SAVE_WRITE_GAME);
+const char* saveSetWait(int kind = SAVE_WRITE_GAME);
+bool saveSetBusy();
+void saveSetRecover(const char* userPath);
+bool saveGameRestoreFrom(const uint32_t* size, const uint8_t* data);
+int  saveGameReadFile(int fileId, void* dst, size_t bytes);
+int  saveGameMonstersLoad(SaveGameMonsterRecord *monsterTable, int fileId);
+
 class Config;
 class Tileset;
 
@@ -2,6 +2,7 @@
  * screen.cpp
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdarg>
 #include <cfloat>
@@ -17,6 +18,7 @@
 #include "error.h"
 #include "event.h"
 #include "game.h"
+#include "gui.h"
 #include "imagemgr.h"
 #include "settings.h"
 #include "stats.h"
@@ -35,6 +37,12 @@ struct RenderLayer {
     void* data;
 };
 
+struct DirtyRect {
+    int16_t x, y, x2, y2;
+};
+
+#define DIRTY_MAX   8
+
 static const float colorBlack[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
 static const char* fontFiles[] = {
@@ -80,17 +88,23 @@ struct Screen {
     short needPrompt;
     short colorFG;
     uint16_t clearCount;
+    uint16_t dirtyCount;
+    DirtyRect dirty[DIRTY_MAX];     // Areas of screenImage not yet uploaded.
+    int16_t cursorTexX;             // Cursor cell in screen texture or -1.
+    int16_t cursorTexY;
     uint8_t uploadScreen;
     uint8_t layersAvail;
 #ifdef GPU_RENDER
     ImageInfo* textureInfo;
+    uint32_t* tileColors;   // Average color of each textureInfo sub-image.
     TileView* renderMapView;
     VisualId focusReticle;
     int mapId;          // Tracks map changes.
     int blockX;         // Tracks changes to view point.
     int blockY;
-    BlockingGroups* blockingUpdate;
-    BlockingGroups blockingGroups;
+    float blockScale;
+    uint8_t mapDataRev; // Tracks changes to map data.
+    uint8_t shadowUpdate;
 #else
     uint8_t blockingGrid[VIEWPORT_W * VIEWPORT_H];
     uint8_t screenLos[VIEWPORT_W * VIEWPORT_H];
@@ -101,6 +115,8 @@ struct Screen {
         memset(layers, 0, sizeof(RenderLayer) * layerCount);
         uploadScreen = 0;
         layersAvail = layerCount;
+        cursorTexX = cursorTexY = -1;
+        setAllDirty();
 
         gemLayout = NULL;
         dungeonGemLayout = NULL;
@@ -117,11 +133,13 @@ struct Screen {
         state.aspectW = state.aspectH = 0;
         state.cursorX = state.cursorY = 0;
         state.cursorVisible = false;
+        state.uploadBytes = 0;
 
         needPrompt = 1;
         colorFG = FONT_COLOR_INDEX(FG_WHITE);
 #ifdef GPU_RENDER
         textureInfo = NULL;
+        tileColors = NULL;
         renderMapView = NULL;
 #endif
         txf[0] = NULL;
@@ -129,6 +147,7 @@ struct Screen {
     }
 
     ~Screen() {
+        gui_clearTextCache();
         if (txf[0]) {
             free(txf[0]);
             free(txf[1]);
@@ -138,6 +157,13 @@ struct Screen {
         delete[] msgBuffer;
         delete[] layers;
     }
+
+    void setAllDirty() {
+        dirty[0].x = dirty[0].y = 0;
+        dirty[0].x2 = U4_SCREEN_W;
+        dirty[0].y2 = U4_SCREEN_H;
+        dirtyCount = 1;
+    }
 };
 
 #define XU4_SCREEN  ((Screen*) xu4.screen)
@@ -176,11 +202,56 @@ static void initDungeonTileChars(std::map<string, int>& dungeonTileChars) {
     dungeonTileChars["sleep_field"] = '^';
 }
 
+#ifdef GPU_RENDER
+/*
+ * Return a table with the average color of each sub-image, ignoring
+ * transparent pixels.  These colors are used to draw the zoomed out map.
+ */
+static uint32_t* averageSubImageColors(const ImageInfo* info) {
+    const Image* img = info->image;
+    const SubImage* it  = info->subImages;
+    const SubImage* end = it + info->subImageCount;
+    uint32_t* colors = new uint32_t[info->subImageCount];
+    uint32_t* cp = colors;
+    const RGBA* pp;
+    const RGBA* prow;
+    uint32_t sum[3], count;
+    int x, y;
+
+    for (; it != end; ++it) {
+        sum[0] = sum[1] = sum[2] = count = 0;
+        prow = (const RGBA*) (img->pixels + img->w * it->y + it->x);
+        for (y = 0; y < it->height; ++y) {
+            pp = prow;
+            for (x = 0; x < it->width; ++x, ++pp) {
+                if (pp->a) {
+                    sum[0] += pp->r;
+                    sum[1] += pp->g;
+                    sum[2] += pp->b;
+                    ++count;
+                }
+            }
+            prow += img->w;
+        }
+
+        RGBA* col = (RGBA*) cp++;
+        if (count) {
+            rgba_setp(col, sum[0] / count, sum[1] / count, sum[2] / count,
+                      255);
+        } else {
+            rgba_setp(col, 0, 0, 0, 255);
+        }
+    }
+    return colors;
+}
+#endif
+
 static void screenInit_data(Screen* scr, Settings& settings) {
 #ifdef GPU_RENDER
     scr->mapId = -1;
     scr->blockX = scr->blockY = -1;
-    scr->blockingUpdate = NULL;
+    scr->blockScale = 0.0f;
+    scr->shadowUpdate = 0;
 #endif
 
     xu4.imageMgr = new ImageMgr;
@@ -207,6 +278,9 @@ static void screenInit_data(Screen* scr, Settings& settings) {
         }
 
         gpu_setTilesTexture(xu4.gpu, tinfo->tex, matId, tinfo->tileTexCoord[3]);
+
+        scr->tileColors = averageSubImageColors(tinfo);
+        gpu_setTileColors(xu4.gpu, scr->tileColors);
         scr->focusReticle = tinfo->subImageIndex.find(symbol[2])->second;
     }
     }
@@ -235,6 +309,12 @@ static void screenInit_data(Screen* scr, Settings& settings) {
 static void screenDelete_data(Screen* scr) {
     Tileset::unloadImages();
 
+#ifdef GPU_RENDER
+    gpu_setTileColors(xu4.gpu, NULL);
+    delete[] scr->tileColors;
+    scr->tileColors = NULL;
+#endif
+
     delete scr->state.tileanims;
     scr->state.tileanims = NULL;
 
@@ -299,6 +379,10 @@ void screenReInit() {
     screenInit_data(screen, *xu4.settings); // Load new backgrounds, etc.
     clearBorders(screen);
 
+    // The screen texture may have been re-created.
+    screen->setAllDirty();
+    screen->cursorTexX = -1;
+
     //gs_emitMessage(SENDER_DISPLAY, &screen->state);
 }
 
@@ -705,26 +789,23 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
     // Reset map rendering data when the location changes.
     if (sp->mapId != map->id) {
         sp->mapId = map->id;
+        sp->mapDataRev = map->dataRev;
         sp->blockX = -1;
         gpu_resetMap(xu4.gpu, map);
+    } else if (sp->mapDataRev != map->dataRev) {
+        sp->mapDataRev = map->dataRev;
+        sp->blockX = -1;
+        gpu_updateMapData(xu4.gpu, map);
     }
 
-    // Update the map render position & remake the blocking groups if
-    // the view has moved.
-    if (sp->blockX != center.x || sp->blockY != center.y) {
+    // Update the map render position & recompute the shadows if the view
+    // has moved or been zoomed.
+    if (sp->blockX != center.x || sp->blockY != center.y ||
+        sp->blockScale != view->scale) {
         sp->blockX = center.x;
         sp->blockY = center.y;
-
-        if ((map->flags & NO_LINE_OF_SIGHT) == 0) {
-            BlockingGroups* blocks = &sp->blockingGroups;
-            map->queryBlocking(blocks,
-                               center.x - view->columns / 2,
-                               center.y - view->rows / 2,
-                               view->columns, view->rows);
-            sp->blockingUpdate = blocks;
-            //printf("KR groups %d,%d,%d\n",
-            //       blocks->left, blocks->center, blocks->right);
-        }
+        sp->blockScale = view->scale;
+        sp->shadowUpdate = 1;
     }
 
     {
@@ -738,7 +819,8 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
     rd.cy = center.y;
     rd.attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_OBJ);
 
-    map->queryVisible(center, view->columns / 2, emitSprite, &rd, &focusObj);
+    map->queryVisible(center, int(1.0f / view->scale), emitSprite, &rd,
+                      &focusObj);
 
     if (focusObj) {
         if ((screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND) % 2) {
@@ -826,13 +908,105 @@ void screenUpdate(TileView *view, bool showmap, bool blackout) {
 
 /**
  * Transfer the contents of the screenImage to the GPU.
+ * Only the areas marked with screenMarkDirty() are sent.
  * This function will be removed after GPU rendering is fully implemented.
  */
 void screenUploadToGPU() {
     XU4_SCREEN->uploadScreen = 1;
 }
 
-static void screenUploadCursor(Screen* sp, uint32_t stex) {
+/**
+ * Record that an area of the screenImage has been modified and must be
+ * uploaded to the GPU on the next screenRender().
+ *
+ * Overlapping or adjacent areas are merged.  If the rectangle list is full
+ * then the new area is merged with whichever rectangle grows the least.
+ */
+void screenMarkDirty(int x, int y, int w, int h) {
+    Screen* sp = XU4_SCREEN;
+    DirtyRect* it;
+    DirtyRect* end;
+    DirtyRect* best;
+    int x2 = x + w;
+    int y2 = y + h;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x2 > U4_SCREEN_W)
+        x2 = U4_SCREEN_W;
+    if (y2 > U4_SCREEN_H)
+        y2 = U4_SCREEN_H;
+    if (x >= x2 || y >= y2)
+        return;
+
+    it  = sp->dirty;
+    end = it + sp->dirtyCount;
+    for (; it != end; ++it) {
+        if (x <= it->x2 && x2 >= it->x && y <= it->y2 && y2 >= it->y)
+            goto merge;
+    }
+
+    if (sp->dirtyCount < DIRTY_MAX) {
+        it = sp->dirty + sp->dirtyCount;
+        ++sp->dirtyCount;
+        it->x  = x;
+        it->y  = y;
+        it->x2 = x2;
+        it->y2 = y2;
+        return;
+    }
+
+    {
+    int area, growth;
+    int minGrowth = U4_SCREEN_W * U4_SCREEN_H + 1;
+    best = sp->dirty;
+    for (it = sp->dirty; it != end; ++it) {
+        area = (it->x2 - it->x) * (it->y2 - it->y);
+        growth = (std::max(x2, int(it->x2)) - std::min(x, int(it->x))) *
+                 (std::max(y2, int(it->y2)) - std::min(y, int(it->y))) - area;
+        if (growth < minGrowth) {
+            minGrowth = growth;
+            best = it;
+        }
+    }
+    it = best;
+    }
+
+merge:
+    if (x < it->x)
+        it->x = x;
+    if (y < it->y)
+        it->y = y;
+    if (x2 > it->x2)
+        it->x2 = x2;
+    if (y2 > it->y2)
+        it->y2 = y2;
+}
+
+/*
+ * Send the dirty areas of the screenImage to the screen texture.
+ * Return the number of bytes uploaded.
+ */
+static uint32_t screenUploadDirty(Screen* sp, uint32_t stex) {
+    const Image32* img = xu4.screenImage;
+    const DirtyRect* it  = sp->dirty;
+    const DirtyRect* end = it + sp->dirtyCount;
+    uint32_t bytes = 0;
+    int w, h;
+
+    for (; it != end; ++it) {
+        w = it->x2 - it->x;
+        h = it->y2 - it->y;
+        gpu_blitTextureRect(stex, img, it->x, it->y, w, h);
+        bytes += w * h * 4;
+    }
+    sp->dirtyCount = 0;
+    return bytes;
+}
+
+static uint32_t screenUploadCursor(Screen* sp, uint32_t stex) {
     int phase =                             // Rotations per second
     //  (sp->state.currentCycle >> 1) & 3;  // 0.5 DOS (normal)
         sp->state.currentCycle & 3;         // 1.0 C64, DOS (combat)
@@ -846,24 +1020,38 @@ static void screenUploadCursor(Screen* sp, uint32_t stex) {
     Image32 cimg;
     cimg.pixels = charset->pixels + (cdim * cdim * cursorChar);
     cimg.w = cimg.h = cdim;
-    gpu_blitTexture(stex, sp->state.cursorX * cdim, sp->state.cursorY * cdim,
-                    &cimg);
+    sp->cursorTexX = sp->state.cursorX * cdim;
+    sp->cursorTexY = sp->state.cursorY * cdim;
+    gpu_blitTexture(stex, sp->cursorTexX, sp->cursorTexY, &cimg);
+    return cdim * cdim * 4;
 }
 
 void screenRender() {
     Screen* sp = XU4_SCREEN;
     void* gpu = xu4.gpu;
     ScreenState* ss = &sp->state;
-    int offsetY = ss->aspectY;
+    int offsetY;
+
+    if (xu4.eventHandler)
+        xu4.eventHandler->advanceEffects(xu4.eventHandler->getFrameDelta());
+    offsetY = ss->aspectY;
 
+    ss->uploadBytes = 0;
     if (sp->uploadScreen) {
         sp->uploadScreen = 0;
 
+        // Restore the screenImage pixels under the previous cursor.
+        if (sp->cursorTexX >= 0) {
+            int cdim = sp->charsetInfo->image->width();
+            screenMarkDirty(sp->cursorTexX, sp->cursorTexY, cdim, cdim);
+            sp->cursorTexX = -1;
+        }
+
         uint32_t stex = gpu_screenTexture(xu4.gpu);
-        gpu_blitTexture(stex, 0, 0, xu4.screenImage);
+        ss->uploadBytes = screenUploadDirty(sp, stex);
 
         if (sp->state.cursorVisible)
-            screenUploadCursor(sp, stex);
+            ss->uploadBytes += screenUploadCursor(sp, stex);
     }
 
     if (ss->vertOffset) {
@@ -886,12 +1074,11 @@ void screenRender() {
             gpu_setScissor(view->scissor);
 
         gpu_drawMap(gpu, view, sp->textureInfo->tileTexCoord,
-                    sp->blockingUpdate, sp->blockX, sp->blockY, view->scale);
-        sp->blockingUpdate = NULL;
+                    sp->shadowUpdate, sp->blockX, sp->blockY, view->scale);
+        sp->shadowUpdate = 0;
 
         gpu_drawTris(gpu, GPU_DLIST_VIEW_OBJ);
 
-        anim_advance(&xu4.eventHandler->fxAnim, 1.0f / 24.0f);
         view->updateEffects((float) sp->blockX,
                             (float) sp->blockY,
                             sp->textureInfo->tileTexCoord);
@@ -1542,20 +1729,28 @@ void screenEraseTextArea(int x, int y, int width, int height) {
 /**
  * Do the tremor spell effect where the screen shakes.
  */
+static void screenShakeFunc(QueuedEffect* fx, float frac) {
+    // The view is shifted down during the first half of each iteration.
+    int half = int(frac * float(fx->arg * 2));
+    XU4_SCREEN->state.vertOffset = (frac < 1.0f && ! (half & 1)) ? fx->id : 0;
+}
+
+/*
+ * Start shaking the screen.  This does not wait for the shaking to end;
+ * call EventHandler::waitEffects() to do that.
+ */
 void screenShake(int iterations) {
-    if (xu4.settings->screenShakes) {
+    if (xu4.settings->screenShakes && iterations > 0) {
         Screen* scr = XU4_SCREEN;
-        int shakeOffset = scr->state.aspectH / U4_SCREEN_H;
-
-        for (int i = 0; i < iterations; i++) {
-            // shift the screen down and make the top row black
-            scr->state.vertOffset = shakeOffset;
-            EventHandler::wait_msecs(xu4.settings->shakeInterval);
-
-            // shift the screen back up
-            scr->state.vertOffset = 0;
-            EventHandler::wait_msecs(xu4.settings->shakeInterval);
-        }
+        QueuedEffect fx;
+
+        fx.func = screenShakeFunc;
+        fx.duration = float(iterations * 2 * xu4.settings->shakeInterval) *
+                      0.001f;
+        fx.id  = scr->state.aspectH / U4_SCREEN_H;
+        fx.arg = iterations;
+        scr->state.vertOffset = fx.id;
+        xu4.eventHandler->queueEffect(&fx);
     }
 }
 
@@ -101,6 +101,7 @@ struct ScreenState {
     int16_t cursorX;
     int16_t cursorY;
     bool cursorVisible;
+    uint32_t uploadBytes;   // Screen texture bytes sent by last screenRender.
 };
 
 #define SCR_CYCLE_PER_SECOND 4
@@ -115,6 +116,7 @@ bool screenLayerUsed(int layer);
 void screenSwapBuffers();
 void screenWait(int numberOfAnimationFrames);
 void screenUploadToGPU();
+void screenMarkDirty(int x, int y, int w, int h);
 
 void screenIconify(void);
 
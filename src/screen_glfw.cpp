@@ -228,9 +228,9 @@ static void keyHandler(GLFWwindow* win, int token, int scancode, int action, int
     else if (mods & GLFW_MOD_SUPER)
         key += U4_META;
 
-#ifdef DEBUG
+    if (xu4.eventHandler->replayControl(key))
+        return;
     xu4.eventHandler->recordKey(key);
-#endif
     if (xu4.verbose)
         printf("key event: token %d, mod 0x%x; translated %d\n", token, mods, key);
 
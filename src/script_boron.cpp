@@ -47,16 +47,56 @@ static void script_reportError(UThread* ut, const UCell* ex)
     ur_strFree(&str);
 }
 
-static const UCell* script_eval(UThread* ut, char* script, int len)
+extern "C" uint32_t murmurHash3_32(const uint8_t* data, int len, uint32_t seed);
+
+/*
+ * Evaluate script text, re-using the tokenized & bound block if the same
+ * text has been run before.
+ */
+static const UCell* script_evalCached(UThread* ut, ScriptCache* sc,
+                                      const char* script, int len)
 {
-    UCell* res = boron_evalUtf8(ut, script, len);
-    if (! res) {
-        const UCell* ex = ur_exception(ut);
-        if (ur_is(ex, UT_ERROR))
-            script_reportError(ut, ex);
-        boron_reset(ut);
+    uint32_t hash = murmurHash3_32((const uint8_t*) script, len, 0x5c41);
+    int slot = hash & (SCRIPT_CACHE_SIZE - 1);
+    UCell* cell = ur_buffer(sc->blkN)->ptr.cell + slot;
+    char* text = sc->text[slot];
+
+    if (! text || sc->hash[slot] != hash || strcmp(text, script) != 0) {
+        free(text);
+        sc->text[slot] = NULL;
+        if (! ur_tokenize(ut, script, script + len, cell)) {
+            ur_setId(cell, UT_NONE);
+            goto fail;
+        }
+        boron_bindDefault(ut, cell->series.buf);
+
+        text = (char*) malloc(len + 1);
+        if (text) {
+            memcpy(text, script, len);
+            text[len] = '\0';
+            sc->hash[slot] = hash;
+            sc->text[slot] = text;
+        }
+    }
+
+    {
+    UCell* res = ur_stackTop(ut);
+#if BORON_VERSION > 0x020008
+    if (boron_evalBlock(ut, cell->series.buf, res) == UR_OK)
+#else
+    if (boron_doBlock(ut, cell, res) == UR_OK)
+#endif
+        return res;
+    }
+
+fail:
+    {
+    const UCell* ex = ur_exception(ut);
+    if (ur_is(ex, UT_ERROR))
+        script_reportError(ut, ex);
+    boron_reset(ut);
     }
-    return res;
+    return NULL;
 }
 
 /*-cf-
@@ -223,6 +223,7 @@ bool Settings::read() {
     gemLayout             = DEFAULT_GEM_LAYOUT;
     lineOfSight           = DEFAULT_LINEOFSIGHT;
     screenShakes          = DEFAULT_SCREEN_SHAKES;
+    fastCombat            = DEFAULT_FAST_COMBAT;
     gamma                 = DEFAULT_GAMMA;
     musicVol              = DEFAULT_MUSIC_VOLUME;
     soundVol              = DEFAULT_SOUND_VOLUME;
@@ -244,6 +245,7 @@ bool Settings::read() {
     shakeInterval         = DEFAULT_SHAKE_INTERVAL;
     titleSpeedRandom      = DEFAULT_TITLE_SPEED_RANDOM;
     titleSpeedOther       = DEFAULT_TITLE_SPEED_OTHER;
+    autosaveTurns         = DEFAULT_AUTOSAVE_TURNS;
 
 #if 0
     pauseForEachMovement  = DEFAULT_PAUSE_FOR_EACH_MOVEMENT;
@@ -305,6 +307,8 @@ bool Settings::read() {
             gemLayout = val;
         else if (VALUE("screenShakes="))
             screenShakes = toInt(val);
+        else if (VALUE("fastCombat="))
+            fastCombat = toInt(val);
         else if (VALUE("gamma="))
             gamma = toInt(val);
         else if (VALUE("musicVol="))
@@ -341,6 +345,8 @@ bool Settings::read() {
             shrineTime = toInt(val);
         else if (VALUE("shakeInterval="))
             shakeInterval = toInt(val);
+        else if (VALUE("autosaveTurns="))
+            autosaveTurns = toInt(val);
         else if (VALUE("titleSpeedRandom="))
             titleSpeedRandom = toInt(val);
         else if (VALUE("titleSpeedOther="))
@@ -438,7 +444,9 @@ bool Settings::write() {
             "shrineTime=%d\n"
             "shakeInterval=%d\n"
             "titleSpeedRandom=%d\n"
-            "titleSpeedOther=%d\n",
+            "titleSpeedOther=%d\n"
+            "autosaveTurns=%d\n"
+            "fastCombat=%d\n",
             scale,
             fullscreen,
             screenGetFilterNames()[ filter ],
@@ -464,7 +472,9 @@ bool Settings::write() {
             shrineTime,
             shakeInterval,
             titleSpeedRandom,
-            titleSpeedOther);
+            titleSpeedOther,
+            autosaveTurns,
+            fastCombat);
 
     // Enhancements Options
     fprintf(settingsFile,
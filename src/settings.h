@@ -55,6 +55,8 @@
 #define DEFAULT_LOGGING                 ""
 #define DEFAULT_TITLE_SPEED_RANDOM      150
 #define DEFAULT_TITLE_SPEED_OTHER       30
+#define DEFAULT_AUTOSAVE_TURNS          0
+#define DEFAULT_FAST_COMBAT             false
 
 #define DEFAULT_PAUSE_FOR_EACH_TURN     100
 #define DEFAULT_PAUSE_FOR_EACH_MOVEMENT 10
@@ -115,6 +117,7 @@ public:
     int                 musicVol;
     unsigned int        scale;
     bool                screenShakes;
+    bool                fastCombat;     // Do not wait for combat effects.
     int                 gamma;
     int                 shakeInterval;
     bool                shortcutCommands;
@@ -124,6 +127,7 @@ public:
     bool                volumeFades;
     int                 titleSpeedRandom;
     int                 titleSpeedOther;
+    int                 autosaveTurns;  // Turns between snapshots (0 = off).
     uint8_t             battleDiff;     // Used by Creature
     uint8_t             filter;         // Defined by screen
     uint8_t             lineOfSight;    // Defined by screen
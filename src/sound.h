@@ -68,10 +68,22 @@ enum MusicTrack {
     VOICE_SPELL = 31
 };
 
+/*
+ * Posted to SENDER_SOUND when the soundPreload() worker has finished.
+ */
+struct SoundEvent {
+    uint16_t serial;        // Incremented by each soundPreload().
+    uint16_t buffers;       // Sound buffers decoded.
+    uint16_t streams;       // Voice & music files read ahead.
+    uint16_t _pad;
+    uint32_t usec;          // Duration of the preload.
+};
+
 int soundInit(void);
 void soundDelete(void);
 void soundSuspend(int halt);
 void soundFreeResourceGroup(uint16_t group);
+void soundPreload(const uint16_t* voiceIds, int voiceCount);
 
 void soundPlay(Sound sound, int specificDurationInTicks = -1);
 void soundSpeakLine(int streamId, int line, bool wait = false);
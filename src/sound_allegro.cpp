@@ -282,6 +282,21 @@ static bool sound_load(Sound sound) {
     return true;
 }
 
+/*
+ * Load all sound effect samples now so that the first soundPlay() of each
+ * does not wait on decoding.  Allegro samples are loaded on the calling
+ * thread and the voice streams are not read ahead.
+ */
+void soundPreload(const uint16_t* /*voiceIds*/, int /*voiceCount*/) {
+    if (! audioFunctional)
+        return;
+
+    for (int i = 0; i < SOUND_MAX; ++i) {
+        if (sa_samples[i] == NULL && config_soundFile(i))
+            sound_load((Sound) i);
+    }
+}
+
 void soundPlay(Sound sound, int durationLimitMSec) {
     ASSERT(sound < SOUND_MAX, "Attempted to play an invalid sound in soundPlay()");
 
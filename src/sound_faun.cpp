@@ -3,6 +3,7 @@
  */
 
 #include <faun.h>
+#include <stdio.h>
 #include <string.h>
 #include "sound.h"
 
@@ -11,8 +12,13 @@
 #include "debug.h"
 #include "error.h"
 #include "event.h"
+#include "portal.h"
 #include "settings.h"
 #include "xu4.h"
+#include "support/threads.h"
+
+extern uint32_t getTicks();
+extern int64_t usecTicks();
 
 #define config_soundFile(id)    xu4.config->soundFile(id)
 #define config_musicFile(id)    xu4.config->musicFile(id)
@@ -21,18 +27,101 @@
 #define SOURCE_LIMIT    8
 #define SID_END         7
 #define SID_SPEECH  SOURCE_LIMIT
-#define SID_MUSIC   SOURCE_LIMIT+1
+#define SID_MUSIC   SOURCE_LIMIT+1    // Two streams used as music decks.
+#define STREAM_LIMIT    3
 #define BUFFER_MS_FAILED    1
 
+// Estimated size of decoded 16-bit stereo samples at 44.1 kHz.
+#define BUFFER_BYTES_PER_MS 176
+
+// Limit for the estimated memory used by sound buffers.  May be set at
+// build time.
+#ifndef SOUND_BUFFER_BUDGET
+#define SOUND_BUFFER_BUDGET (24*1024*1024)
+#endif
+
+#define VOICE_PRELOAD_MAX   8
+#define MUSIC_PREFETCH_MAX  6
+#define MUSIC_PREFETCH_BYTES    (256*1024)  // About 15 seconds of Vorbis.
+#define MUSIC_CROSSFADE_MS  1500
+
+struct SoundFile {
+    const char* path;       // NULL if there is nothing to load.
+    uint32_t offset;
+    uint32_t bytes;
+};
+
+struct SoundPreload {
+    Thread loader;
+    int loading;
+    int listenerId;
+    uint16_t serial;
+    uint16_t group;
+    uint16_t voiceCount;
+    uint16_t musicCount;
+    uint16_t pendingCount;  // Tracks queued while the loader was busy.
+    uint16_t pending[MUSIC_PREFETCH_MAX];
+    SoundFile sound[BUFFER_LIMIT];
+    SoundFile voice[VOICE_PRELOAD_MAX];
+    SoundFile music[MUSIC_PREFETCH_MAX];
+};
+
+/*
+ * Time from soundPlay() until the source is queued on the mixer.
+ * The output device latency is not included as Faun does not report it.
+ */
+struct SoundLatency {
+    uint32_t plays;
+    uint32_t coldPlays;     // Plays which had to load the buffer.
+    uint32_t maxUsec;
+    uint64_t totalUsec;
+};
+
 static int currentTrack;
+static int musicDeck;               // Deck (0 or 1) playing currentTrack.
 static int currentDialog;
 static int musicEnabled;
 static int nextSource;              // Use sources in round-robin order.
 static int musicFadeMs;             // Minimizes calls to faun_setParameter.
 static float soundVolume = 0.0f;
 static float musicVolume = 0.0f;
-static uint16_t bufferMs[BUFFER_LIMIT];
+static uint32_t bufferMs[BUFFER_LIMIT];         // Zero until loaded.
+static uint32_t bufferClaim[BUFFER_LIMIT];      // Set by the loading thread.
+static uint32_t bufferLastUse[BUFFER_LIMIT];
 static uint16_t bufferResGroup[BUFFER_LIMIT];
+static SoundPreload preload;
+static SoundLatency latency;
+
+static void music_prefetchStart();
+
+static void preloadWait()
+{
+    if (preload.loading) {
+        thread_join(preload.loader);
+        preload.loading = 0;
+    }
+}
+
+/*
+ * Reap the preload thread when it reports that it is done, so that later
+ * calls to preloadWait() do not block.
+ */
+static void soundNotice(int sender, void* eventData, void* user)
+{
+    const SoundEvent* ev = (const SoundEvent*) eventData;
+
+    // Ignore a late message from a loader which has already been joined.
+    if (ev->serial != preload.serial)
+        return;
+    preloadWait();
+
+    if (xu4.verbose)
+        printf("Sound preload: %d buffers, %d streams in %.1f ms\n",
+               ev->buffers, ev->streams, double(ev->usec) * 0.001);
+
+    if (preload.pendingCount)
+        music_prefetchStart();
+}
 
 /*
  * Initialize sound & music service.
@@ -42,19 +131,29 @@ int soundInit()
     const char* error;
 
     currentTrack = MUSIC_NONE;
+    musicDeck = 0;
     currentDialog = 0;
     nextSource = 0;
     musicFadeMs = 0;
     memset(bufferMs, 0, sizeof(bufferMs));
+    memset(bufferClaim, 0, sizeof(bufferClaim));
+    memset(bufferLastUse, 0, sizeof(bufferLastUse));
     memset(bufferResGroup, 0, sizeof(bufferResGroup));
+    memset(&latency, 0, sizeof(latency));
+    preload.loading = 0;
+    preload.listenerId = -1;
+    preload.serial = 0;
+    preload.pendingCount = 0;
 
-    error = faun_startup(BUFFER_LIMIT, SOURCE_LIMIT, 2, 0, "xu4");
+    error = faun_startup(BUFFER_LIMIT, SOURCE_LIMIT, STREAM_LIMIT, 0, "xu4");
     if (error) {
         errorWarning("Faun: %s", error);
         soundVolume = musicVolume = 0.0f;
         return 0;
     }
 
+    preload.listenerId = gs_listen(1<<SENDER_SOUND, soundNotice, NULL);
+
     musicEnabled = 1;
     musicSetVolume(xu4.settings->musicVol);
     soundSetVolume(xu4.settings->soundVol);
@@ -63,6 +162,16 @@ int soundInit()
 
 void soundDelete()
 {
+    preloadWait();
+    if (preload.listenerId >= 0)
+        gs_unplug(preload.listenerId);
+
+    if (xu4.verbose && latency.plays) {
+        printf("Sound latency: %u plays, %u cold, mean %.1f usec,"
+               " max %u usec\n", latency.plays, latency.coldPlays,
+               double(latency.totalUsec) / latency.plays, latency.maxUsec);
+    }
+
     faun_shutdown();
 }
 
@@ -71,46 +180,252 @@ void soundSuspend(int halt)
     faun_suspend(halt);
 }
 
+static void freeBuffer(int i)
+{
+    faun_freeBuffers(i, 1);
+    bufferResGroup[i] = 0;
+    atomicStore(bufferMs + i, 0);
+    atomicStore(bufferClaim + i, 0);
+}
+
 void soundFreeResourceGroup(uint16_t group)
 {
     int i;
+
+    // The preload thread may be loading buffers of this group.
+    preloadWait();
+
     for (i = 0; i < BUFFER_LIMIT; ++i) {
-        if (bufferMs[i] > BUFFER_MS_FAILED && bufferResGroup[i] == group) {
-            bufferMs[i] = bufferResGroup[i] = 0;
-            faun_freeBuffers(i, 1);
-        }
+        if (bufferMs[i] > BUFFER_MS_FAILED && bufferResGroup[i] == group)
+            freeBuffer(i);
     }
 }
 
-static int loadSoundBuffer(int sound)
+/*
+ * Return the estimated bytes used by all loaded buffers.
+ */
+static uint32_t bufferMemoryUsed()
 {
-    float duration = 0.0f;
-    uint16_t ms;
+    uint32_t total = 0;
+    uint32_t ms;
+    int i;
+    for (i = 0; i < BUFFER_LIMIT; ++i) {
+        ms = atomicLoad(bufferMs + i);
+        if (ms > BUFFER_MS_FAILED)
+            total += ms * BUFFER_BYTES_PER_MS;
+    }
+    return total;
+}
 
+/*
+ * Free the least recently played buffers until the estimated memory used
+ * is within SOUND_BUFFER_BUDGET.  Buffers which may still be playing are
+ * kept.  Only the main thread calls this.
+ */
+static void evictBuffers()
+{
+    uint32_t now = getTicks();
+    uint32_t used = bufferMemoryUsed();
+    uint32_t ms;
+    int i, victim;
+
+    while (used > SOUND_BUFFER_BUDGET) {
+        victim = -1;
+        for (i = 0; i < BUFFER_LIMIT; ++i) {
+            ms = atomicLoad(bufferMs + i);
+            if (ms > BUFFER_MS_FAILED && now - bufferLastUse[i] > ms) {
+                if (victim < 0 || bufferLastUse[i] < bufferLastUse[victim])
+                    victim = i;
+            }
+        }
+        if (victim < 0)
+            break;
+        used -= bufferMs[victim] * BUFFER_BYTES_PER_MS;
+        freeBuffer(victim);
+    }
+}
+
+static void soundFileEntry(int sound, SoundFile* sf)
+{
 #ifdef CONF_MODULE
     const CDIEntry* ent = config_soundFile(sound);
-    if (ent)
-        duration = faun_loadBuffer(sound, xu4.config->modulePath(ent),
-                                   ent->offset, ent->bytes);
+    if (ent) {
+        sf->path   = xu4.config->modulePath(ent);
+        sf->offset = ent->offset;
+        sf->bytes  = ent->bytes;
+        return;
+    }
 #else
     const char* pathname = config_soundFile(sound);
-    if (pathname)
-        duration = faun_loadBuffer(sound, pathname, 0, 0);
+    if (pathname) {
+        sf->path   = pathname;
+        sf->offset = sf->bytes = 0;
+        return;
+    }
 #endif
+    sf->path = NULL;
+}
 
-    if (duration)
-        ms = (uint16_t) (duration * 1000.0f);
-    else {
+/*
+ * Decode a sound into its buffer and publish the duration.  This is called
+ * from either the main or preload thread by whichever set bufferClaim.
+ */
+static uint32_t decodeSoundBuffer(int sound, const SoundFile* sf,
+                                  uint16_t group)
+{
+    float duration = 0.0f;
+    uint32_t ms;
+
+    if (sf->path)
+        duration = faun_loadBuffer(sound, sf->path, sf->offset, sf->bytes);
+
+    if (duration) {
+        ms = (uint32_t) (duration * 1000.0f);
+        if (ms <= BUFFER_MS_FAILED)
+            ms = BUFFER_MS_FAILED + 1;
+    } else {
         // Mark buffer as loaded even upon failure so we don't keep trying
         // to load bad or nonexistent data.
         ms = BUFFER_MS_FAILED;
     }
 
-    bufferMs[sound] = ms;
-    bufferResGroup[sound] = xu4.resGroup;
+    bufferResGroup[sound] = group;
+    atomicStore(bufferMs + sound, ms);
     return ms;
 }
 
+static int loadSoundBuffer(int sound)
+{
+    SoundFile sf;
+    uint32_t ms;
+
+    if (! atomicCAS(bufferClaim + sound, 0, 1)) {
+        // The preload thread is decoding this buffer.
+        while (! (ms = atomicLoad(bufferMs + sound)))
+            thread_yield();
+        return ms;
+    }
+
+    evictBuffers();
+    soundFileEntry(sound, &sf);
+    return decodeSoundBuffer(sound, &sf, xu4.resGroup);
+}
+
+/*
+ * Read up to limit bytes of a file so that it is in the system cache when
+ * later opened.
+ */
+static void prefetchFile(const SoundFile* sf, uint32_t limit)
+{
+    char chunk[16384];
+    uint32_t left = sf->bytes;
+    size_t n;
+    FILE* fp = fopen(sf->path, "rb");
+    if (fp) {
+        if (! left || left > limit)
+            left = limit;
+        fseek(fp, sf->offset, SEEK_SET);
+        while (left) {
+            n = fread(chunk, 1, (left < sizeof(chunk)) ? left : sizeof(chunk),
+                      fp);
+            if (! n)
+                break;
+            left -= n;
+        }
+        fclose(fp);
+    }
+}
+
+/*
+ * Decode the pending sound buffers and read the voice & music streams.  This runs
+ * on the loader thread and only touches buffers for which it sets
+ * bufferClaim.
+ */
+static THREAD_FUNC preloadThread(void* arg)
+{
+    SoundPreload* pl = (SoundPreload*) arg;
+    SoundEvent ev;
+    int64_t start = usecTicks();
+    int i;
+
+    ev.serial = pl->serial;
+    ev.buffers = 0;
+    ev._pad = 0;
+
+    for (i = 0; i < BUFFER_LIMIT; ++i) {
+        if (! pl->sound[i].path)
+            continue;
+        if (bufferMemoryUsed() > SOUND_BUFFER_BUDGET)
+            break;
+        if (atomicCAS(bufferClaim + i, 0, 1)) {
+            decodeSoundBuffer(i, pl->sound + i, pl->group);
+            ++ev.buffers;
+        }
+    }
+
+    for (i = 0; i < pl->voiceCount; ++i)
+        prefetchFile(pl->voice + i, 0xffffffff);
+    for (i = 0; i < pl->musicCount; ++i)
+        prefetchFile(pl->music + i, MUSIC_PREFETCH_BYTES);
+
+    // If the queue is full the thread is simply joined later.
+    ev.streams = pl->voiceCount + pl->musicCount;
+    ev.usec = (uint32_t) (usecTicks() - start);
+    gs_postMessage(SENDER_SOUND, ev);
+    return THREAD_RETURN;
+}
+
+/*
+ * Begin loading all sound effect buffers on a worker thread so that the
+ * first soundPlay() of each does not wait on decoding.  The buffers become
+ * part of the current resource group.
+ *
+ * \param voiceIds     Dialogue streams (Config::musicFile ids) to read
+ *                     ahead of soundSpeakLine().
+ * \param voiceCount   Number of voiceIds.
+ */
+void soundPreload(const uint16_t* voiceIds, int voiceCount)
+{
+    int i;
+
+    // Do nothing if muted or soundInit failed.
+    if (soundVolume <= 0.0f)
+        return;
+
+    preloadWait();
+
+    for (i = 0; i < BUFFER_LIMIT; ++i) {
+        if (atomicLoad(bufferClaim + i))
+            preload.sound[i].path = NULL;
+        else
+            soundFileEntry(i, preload.sound + i);
+    }
+
+    preload.voiceCount = preload.musicCount = 0;
+#ifdef CONF_MODULE
+    if (voiceCount > VOICE_PRELOAD_MAX)
+        voiceCount = VOICE_PRELOAD_MAX;
+    for (i = 0; i < voiceCount; ++i) {
+        const CDIEntry* ent = config_musicFile(voiceIds[i]);
+        if (ent) {
+            SoundFile* sf = preload.voice + preload.voiceCount++;
+            sf->path   = xu4.config->modulePath(ent);
+            sf->offset = ent->offset;
+            sf->bytes  = ent->bytes;
+        }
+    }
+#else
+    (void) voiceIds;
+    (void) voiceCount;
+#endif
+
+    preload.group = xu4.resGroup;
+    ++preload.serial;
+
+    // If the thread cannot be started soundPlay() will load synchronously.
+    preload.loading = thread_create(&preload.loader, preloadThread, &preload);
+}
+
 void soundPlay(Sound sound, int limitMSec)
 {
     ASSERT(sound < SOUND_MAX, "Invalid soundPlay() id");
@@ -119,8 +434,14 @@ void soundPlay(Sound sound, int limitMSec)
     if (soundVolume <= 0.0f)
         return;
 
-    if (bufferMs[sound] == 0)
+    int64_t start = usecTicks();
+    uint32_t usec;
+    int cold = 0;
+
+    if (atomicLoad(bufferMs + sound) == 0) {
         loadSoundBuffer(sound);
+        cold = 1;
+    }
 
     // The source SID_END is reserved for when limitMSec is used so that
     // FAUN_END_TIME doesn't need to be reset.  This assumes that limitMSec
@@ -135,6 +456,14 @@ void soundPlay(Sound sound, int limitMSec)
         if (++nextSource >= SID_END)
             nextSource = 0;
     }
+
+    bufferLastUse[sound] = getTicks();
+    usec = (uint32_t) (usecTicks() - start);
+    latency.plays++;
+    latency.coldPlays += cold;
+    latency.totalUsec += usec;
+    if (usec > latency.maxUsec)
+        latency.maxUsec = usec;
 }
 
 /*
@@ -188,7 +517,7 @@ speak:
  */
 int soundDuration(Sound sound)
 {
-    int ms = bufferMs[sound];
+    int ms = atomicLoad(bufferMs + sound);
     if (ms == 0)
         ms = loadSoundBuffer(sound);
     if (ms == BUFFER_MS_FAILED)
@@ -209,6 +538,38 @@ void soundStop() {
  * Return true if the stream begins playing from the start.  If the stream
  * is already playing or it cannot be loaded then false is returned.
  */
+static void music_setFadePeriod(int msec)
+{
+    if (musicFadeMs != msec) {
+        musicFadeMs = msec;
+        faun_setParameter(SID_MUSIC, 2, FAUN_FADE_PERIOD, msec/1000.0f);
+    }
+}
+
+static bool musicFileEntry(int music, SoundFile* sf)
+{
+#ifdef CONF_MODULE
+    const CDIEntry* ent = config_musicFile(music);
+    if (! ent)
+        return false;
+    sf->path   = xu4.config->modulePath(ent);
+    sf->offset = ent->offset;
+    sf->bytes  = ent->bytes;
+#else
+    sf->path = config_musicFile(music);
+    if (! sf->path)
+        return false;
+    sf->offset = sf->bytes = 0;
+#endif
+    return true;
+}
+
+/*
+ * Start a music track on the idle deck.  If a track is already playing
+ * and fades are enabled then the two are crossfaded; both commands are
+ * sent together so Faun begins the fade out and fade in on the same mix
+ * cycle.
+ */
 static bool music_start(int music, int mode) {
     ASSERT(music < MUSIC_MAX, "Invalid music_start() track id");
 
@@ -216,22 +577,107 @@ static bool music_start(int music, int mode) {
     if (music == currentTrack)
         return false;
 
+    SoundFile sf;
+    if (! musicFileEntry(music, &sf)) {
 #ifdef CONF_MODULE
-    const CDIEntry* ent = config_musicFile(music);
-    if (ent)
-        faun_playStream(SID_MUSIC, xu4.config->modulePath(ent),
-                        ent->offset, ent->bytes, mode);
+        currentTrack = music;
+        return true;
 #else
-    const char* pathname = config_musicFile(music);
-    if (! pathname)
         return false;
-    faun_playStream(SID_MUSIC, pathname, 0, 0, mode);
 #endif
+    }
+
+    int prev = SID_MUSIC + musicDeck;
+    if (currentTrack != MUSIC_NONE) {
+        if (xu4.settings->volumeFades) {
+            if (! (mode & FAUN_PLAY_FADE_IN)) {
+                music_setFadePeriod(MUSIC_CROSSFADE_MS);
+                mode |= FAUN_PLAY_FADE_IN;
+            }
+            faun_control(prev, 1, FC_FADE_OUT);
+        } else
+            faun_control(prev, 1, FC_STOP);
+    }
+
+    // A deck left fading out by musicFadeOut() is allowed to finish.
+    musicDeck ^= 1;
+    faun_playStream(SID_MUSIC + musicDeck, sf.path, sf.offset, sf.bytes, mode);
 
     currentTrack = music;
     return true;
 }
 
+/*
+ * Start the loader thread on the pending music tracks.
+ */
+static void music_prefetchStart()
+{
+    int i;
+
+    for (i = 0; i < BUFFER_LIMIT; ++i)
+        preload.sound[i].path = NULL;
+    preload.voiceCount = preload.musicCount = 0;
+    for (i = 0; i < preload.pendingCount; ++i) {
+        if (musicFileEntry(preload.pending[i],
+                           preload.music + preload.musicCount))
+            ++preload.musicCount;
+    }
+    preload.pendingCount = 0;
+    if (! preload.musicCount)
+        return;
+
+    preload.group = xu4.resGroup;
+    ++preload.serial;
+    preload.loading = thread_create(&preload.loader, preloadThread, &preload);
+}
+
+/*
+ * Read ahead the tracks of the maps which can be reached from the current
+ * location so that their streams open without stalling the crossfade.
+ *
+ * If the loader thread is still busy the tracks are queued and soundNotice()
+ * starts them when it finishes, so the main thread never waits here.  Only
+ * the newest set of tracks is kept.
+ */
+static void music_prefetchNext()
+{
+    uint16_t tracks[MUSIC_PREFETCH_MAX];
+    int count = 0;
+    int music, i, j;
+    const Location* loc = c->location;
+    const PortalList& portals = loc->map->portals;
+    PortalList::const_iterator it = portals.begin();
+
+    if (! musicEnabled || musicVolume <= 0.0f)
+        return;
+
+    music = loc->prev ? loc->prev->map->music : MUSIC_NONE;
+    for (;;) {
+        if (music != MUSIC_NONE && music != currentTrack) {
+            for (j = 0; j < count; ++j) {
+                if (tracks[j] == music)
+                    break;
+            }
+            if (j == count) {
+                tracks[count++] = music;
+                if (count == MUSIC_PREFETCH_MAX)
+                    break;
+            }
+        }
+        if (it == portals.end())
+            break;
+        music = xu4.config->mapMusic((*it)->destid);
+        ++it;
+    }
+
+    for (i = 0; i < count; ++i)
+        preload.pending[i] = tracks[i];
+    preload.pendingCount = count;
+
+    if (! preload.loading)
+        music_prefetchStart();
+}
+
 void musicPlay(int track)
 {
     if (musicEnabled && musicVolume > 0.0f)
@@ -241,20 +687,13 @@ void musicPlay(int track)
 void musicPlayLocale()
 {
     musicPlay(c->location->map->music);
+    music_prefetchNext();
 }
 
 void musicStop()
 {
     currentTrack = MUSIC_NONE;
-    faun_control(SID_MUSIC, 1, FC_STOP);
-}
-
-static void music_setFadePeriod(int msec)
-{
-    if (musicFadeMs != msec) {
-        musicFadeMs = msec;
-        faun_setParameter(SID_MUSIC, 1, FAUN_FADE_PERIOD, msec/1000.0f);
-    }
+    faun_control(SID_MUSIC, 2, FC_STOP);
 }
 
 void musicFadeOut(int msec)
@@ -263,7 +702,7 @@ void musicFadeOut(int msec)
         currentTrack = MUSIC_NONE;
         if (xu4.settings->volumeFades) {
             music_setFadePeriod(msec);
-            faun_control(SID_MUSIC, 1, FC_FADE_OUT);
+            faun_control(SID_MUSIC + musicDeck, 1, FC_FADE_OUT);
         } else
             musicStop();
     }
@@ -294,9 +733,9 @@ void musicSetVolume(int volume)
 {
     musicVolume = float(volume) / MAX_VOLUME;
 #if FAUN_VERSION >= 0x000200
-    faun_setParameter(SID_MUSIC, 1, FAUN_VOLUME_APPLY, musicVolume);
+    faun_setParameter(SID_MUSIC, 2, FAUN_VOLUME_APPLY, musicVolume);
 #else
-    faun_setParameter(SID_MUSIC, 1, FAUN_VOLUME, musicVolume);
+    faun_setParameter(SID_MUSIC, 2, FAUN_VOLUME, musicVolume);
 #endif
 }
 
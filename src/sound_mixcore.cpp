@@ -0,0 +1,709 @@
+/*
+ * sound_mixcore.cpp
+ *
+ * Decoders & mixing engine of the built-in software mixer.
+ *
+ * This is #included by sound_mixer.cpp and by the util/mixbench test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vorbis/vorbisfile.h>
+#include "sound.h"
+#include "support/threads.h"
+
+extern uint32_t getTicks();
+extern int64_t usecTicks();
+
+// Output rate.  May be set at build time.
+#ifndef MIX_RATE
+#define MIX_RATE        44100
+#endif
+#define MIX_PERIOD      1024        // Frames mixed per period.
+#define STREAM_CHUNK    4096        // Frames decoded per stream read.
+#define FRAC_ONE        ((uint64_t) 1 << 32)
+
+#define BUFFER_LIMIT    SOUND_MAX
+#define SOURCE_LIMIT    8
+#define SID_END         7
+#define BUFFER_MS_FAILED    1
+
+enum DecoderType {
+    DEC_NONE,
+    DEC_WAV,
+    DEC_OGG
+};
+
+struct Decoder {
+    FILE* fp;
+    uint32_t start;         // File offset of WAV samples or Ogg stream.
+    uint32_t bytes;         // Size of the data at start.
+    uint32_t pos;           // Read position relative to start.
+    uint32_t rate;
+    uint16_t channels;
+    uint16_t sampleBytes;   // WAV only; 1, 2, or 4 (float).
+    int type;
+    OggVorbis_File vf;
+};
+
+struct MixBuffer {
+    float* samples;         // Stereo frames with a trailing silent frame.
+    uint32_t frames;
+    uint32_t rate;
+    uint32_t ms;            // Zero until loaded.
+    uint16_t resGroup;
+};
+
+struct MixSource {
+    int buffer;             // Playing MixBuffer index or -1.
+    uint32_t endFrame;
+    int64_t requestTime;    // usecTicks() of soundPlay until first mixed.
+    uint64_t pos;           // 32.32 fixed point source frame.
+    uint64_t step;
+};
+
+struct MixStream {
+    Decoder dec;
+    float* chunk;           // Decoded stereo frames.
+    uint32_t chunkFrames;
+    uint32_t remain;        // Output frames left to play.
+    uint64_t pos;
+    uint64_t step;
+    float gain;             // Fade level.
+    float gainStep;         // Change per output frame.
+    int id;                 // Config::musicFile id of open decoder or 0.
+    int playing;
+    int loop;
+    int fadeStop;           // Stop when a fade out reaches zero.
+};
+
+struct MixStats {
+    uint32_t periods;
+    uint32_t late;          // Periods mixed after their deadline.
+    uint64_t mixUsec;
+    uint32_t plays;
+    uint64_t latencyUsec;
+    uint32_t latencyMaxUsec;
+};
+
+struct Mixer {
+    Mutex lock;
+    Thread thread;
+    int running;
+    int suspended;
+    FILE* wav;
+    uint32_t wavBytes;
+    MixSource source[SOURCE_LIMIT];
+    MixStream speech;
+    MixStream music;
+    MixStats stats;
+    float mix[MIX_PERIOD*2];
+    float temp[MIX_PERIOD*2];
+    int16_t out[MIX_PERIOD*2];
+};
+
+static float soundVolume = 0.0f;
+static float musicVolume = 0.0f;
+static MixBuffer buffers[BUFFER_LIMIT];
+
+//--------------------------------------
+// Decoders
+
+static size_t ogg_read(void* ptr, size_t size, size_t nmemb, void* ds)
+{
+    Decoder* dec = (Decoder*) ds;
+    size_t avail = dec->bytes - dec->pos;
+    size_t want = size * nmemb;
+    if (want > avail)
+        want = avail;
+    want = fread(ptr, 1, want, dec->fp);
+    dec->pos += want;
+    return size ? want / size : 0;
+}
+
+static int ogg_seek(void* ds, ogg_int64_t offset, int whence)
+{
+    Decoder* dec = (Decoder*) ds;
+    ogg_int64_t pos;
+    switch (whence) {
+        case SEEK_SET: pos = offset; break;
+        case SEEK_CUR: pos = dec->pos + offset; break;
+        default:       pos = dec->bytes + offset; break;
+    }
+    if (pos < 0 || pos > dec->bytes)
+        return -1;
+    dec->pos = (uint32_t) pos;
+    return fseek(dec->fp, dec->start + dec->pos, SEEK_SET);
+}
+
+static long ogg_tell(void* ds)
+{
+    return ((Decoder*) ds)->pos;
+}
+
+static uint32_t readU32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/*
+ * Parse the WAV chunks and leave the file at the start of the samples.
+ */
+static bool dec_openWav(Decoder* dec, uint32_t offset)
+{
+    uint8_t head[16];
+    uint32_t pos = 12;
+    uint32_t size;
+    int format = 0;
+
+    while (pos + 8 <= dec->bytes) {
+        fseek(dec->fp, offset + pos, SEEK_SET);
+        if (fread(head, 1, 8, dec->fp) != 8)
+            break;
+        size = readU32(head + 4);
+        pos += 8;
+
+        if (memcmp(head, "fmt ", 4) == 0) {
+            if (size < 16 || fread(head, 1, 16, dec->fp) != 16)
+                break;
+            format = head[0] | head[1] << 8;
+            dec->channels = head[2] | head[3] << 8;
+            dec->rate = readU32(head + 4);
+            dec->sampleBytes = (head[14] | head[15] << 8) / 8;
+        } else if (memcmp(head, "data", 4) == 0) {
+            if (! dec->rate || dec->channels < 1 || dec->channels > 2)
+                break;
+            // PCM 8 & 16-bit or IEEE float.
+            if (! ((format == 1 && dec->sampleBytes <= 2) ||
+                   (format == 3 && dec->sampleBytes == 4)))
+                break;
+            if (size > dec->bytes - pos)
+                size = dec->bytes - pos;
+            dec->start = offset + pos;
+            dec->bytes = size;
+            dec->pos = 0;
+            dec->type = DEC_WAV;
+            return true;
+        }
+        pos += (size + 1) & ~1;
+    }
+    return false;
+}
+
+/*
+ * Open a WAV or Ogg Vorbis file (or part of a module file if bytes is
+ * non-zero).
+ */
+static bool dec_open(Decoder* dec, const char* path, uint32_t offset,
+                     uint32_t bytes)
+{
+    uint8_t magic[4];
+
+    memset(dec, 0, sizeof(Decoder));
+    dec->fp = fopen(path, "rb");
+    if (! dec->fp)
+        return false;
+
+    if (! bytes) {
+        fseek(dec->fp, 0, SEEK_END);
+        bytes = ftell(dec->fp) - offset;
+    }
+    dec->start = offset;
+    dec->bytes = bytes;
+
+    fseek(dec->fp, offset, SEEK_SET);
+    if (fread(magic, 1, 4, dec->fp) == 4) {
+        if (memcmp(magic, "RIFF", 4) == 0) {
+            if (dec_openWav(dec, offset))
+                return true;
+        } else if (memcmp(magic, "OggS", 4) == 0) {
+            ov_callbacks cb;
+            cb.read_func  = ogg_read;
+            cb.seek_func  = ogg_seek;
+            cb.close_func = NULL;
+            cb.tell_func  = ogg_tell;
+
+            fseek(dec->fp, offset, SEEK_SET);
+            if (ov_open_callbacks(dec, &dec->vf, NULL, 0, cb) == 0) {
+                vorbis_info* info = ov_info(&dec->vf, -1);
+                dec->rate = info->rate;
+                dec->channels = info->channels;
+                dec->type = DEC_OGG;
+                return true;
+            }
+        }
+    }
+
+    fclose(dec->fp);
+    dec->fp = NULL;
+    return false;
+}
+
+static void dec_close(Decoder* dec)
+{
+    if (dec->type == DEC_OGG)
+        ov_clear(&dec->vf);
+    if (dec->fp)
+        fclose(dec->fp);
+    dec->fp = NULL;
+    dec->type = DEC_NONE;
+}
+
+static void dec_seek(Decoder* dec, double seconds)
+{
+    uint32_t frame = (uint32_t) (seconds * dec->rate);
+    if (dec->type == DEC_OGG) {
+        ov_pcm_seek(&dec->vf, frame);
+    } else if (dec->type == DEC_WAV) {
+        dec->pos = frame * dec->channels * dec->sampleBytes;
+        if (dec->pos > dec->bytes)
+            dec->pos = dec->bytes;
+        fseek(dec->fp, dec->start + dec->pos, SEEK_SET);
+    }
+}
+
+/*
+ * Decode up to count frames as interleaved stereo float.
+ * Return the number of frames read (zero at the end of the data).
+ */
+static int dec_read(Decoder* dec, float* out, int count)
+{
+    int total = 0;
+    int i, n;
+
+    if (dec->type == DEC_OGG) {
+        float** pcm;
+        int bitstream;
+        while (total < count) {
+            n = ov_read_float(&dec->vf, &pcm, count - total, &bitstream);
+            if (n == OV_HOLE)
+                continue;
+            if (n <= 0)
+                break;
+            if (dec->channels == 1) {
+                for (i = 0; i < n; ++i)
+                    out[i*2] = out[i*2+1] = pcm[0][i];
+            } else {
+                for (i = 0; i < n; ++i) {
+                    out[i*2]   = pcm[0][i];
+                    out[i*2+1] = pcm[1][i];
+                }
+            }
+            out += n * 2;
+            total += n;
+        }
+    } else if (dec->type == DEC_WAV) {
+        uint8_t raw[8192];
+        int frameBytes = dec->channels * dec->sampleBytes;
+        int samples;
+
+        while (total < count) {
+            n = sizeof(raw) / frameBytes;
+            if (n > count - total)
+                n = count - total;
+            if ((uint32_t) (n * frameBytes) > dec->bytes - dec->pos)
+                n = (dec->bytes - dec->pos) / frameBytes;
+            n = fread(raw, frameBytes, n, dec->fp);
+            if (n <= 0)
+                break;
+            dec->pos += n * frameBytes;
+
+            // Convert to float in place at the end of out, then expand mono.
+            samples = n * dec->channels;
+            float* fs = out + n * 2 - samples;
+            if (dec->sampleBytes == 1) {
+                for (i = 0; i < samples; ++i)
+                    fs[i] = (raw[i] - 128) * (1.0f / 128.0f);
+            } else if (dec->sampleBytes == 2) {
+                const int16_t* s16 = (const int16_t*) raw;
+                for (i = 0; i < samples; ++i)
+                    fs[i] = s16[i] * (1.0f / 32768.0f);
+            } else {
+                memcpy(fs, raw, samples * sizeof(float));
+            }
+            if (dec->channels == 1) {
+                for (i = 0; i < n; ++i)
+                    out[i*2] = out[i*2+1] = fs[i];
+            }
+            out += n * 2;
+            total += n;
+        }
+    }
+    return total;
+}
+
+//--------------------------------------
+// Mixing
+
+/*
+ * Linearly interpolate stereo source frames at the output rate.
+ * Return the number of frames written to out, which will be less than count
+ * if the end of src is reached.
+ */
+static int mix_resample(float* out, int count, const float* src,
+                        uint32_t srcFrames, uint64_t* ppos, uint64_t step)
+{
+    const float* s;
+    uint64_t pos = *ppos;
+    uint64_t end;
+    float f;
+    int n;
+
+    if (srcFrames < 2)
+        return 0;
+    end = (uint64_t) (srcFrames - 1) << 32;
+    if (pos >= end)
+        return 0;
+
+    if (step == FRAC_ONE && ! (pos & 0xffffffff)) {
+        n = (end - pos) >> 32;
+        if (n > count)
+            n = count;
+        memcpy(out, src + (pos >> 32) * 2, n * 2 * sizeof(float));
+        *ppos = pos + ((uint64_t) n << 32);
+        return n;
+    }
+
+    for (n = 0; n < count && pos < end; ++n) {
+        s = src + (pos >> 32) * 2;
+        f = (float) (pos & 0xffffffff) * (1.0f / 4294967296.0f);
+        out[0] = s[0] + (s[2] - s[0]) * f;
+        out[1] = s[1] + (s[3] - s[1]) * f;
+        out += 2;
+        pos += step;
+    }
+    *ppos = pos;
+    return n;
+}
+
+/*
+ * Add stereo frames to the mix with a linear gain ramp.
+ * The loop has no dependencies between frames so it vectorizes.
+ */
+static void mix_add(float* mix, const float* src, int frames, float gain,
+                    float gainStep)
+{
+    int i;
+    float g;
+    for (i = 0; i < frames; ++i) {
+        g = gain + gainStep * (float) i;
+        mix[i*2]   += src[i*2]   * g;
+        mix[i*2+1] += src[i*2+1] * g;
+    }
+}
+
+static void mix_toS16(int16_t* out, const float* mix, int samples)
+{
+    int i;
+    float v;
+    for (i = 0; i < samples; ++i) {
+        v = mix[i] * 32767.0f;
+        v = (v > 32767.0f) ? 32767.0f : v;
+        v = (v < -32768.0f) ? -32768.0f : v;
+        out[i] = (int16_t) v;
+    }
+}
+
+static uint64_t mix_step(uint32_t rate)
+{
+    return ((uint64_t) rate << 32) / MIX_RATE;
+}
+
+static void stream_close(MixStream* st)
+{
+    dec_close(&st->dec);
+    st->id = 0;
+    st->playing = 0;
+}
+
+/*
+ * Decode the next chunk of a stream.  The last frame of the previous chunk
+ * is kept at the start so interpolation continues across chunks.
+ * Return number of new frames.
+ */
+static int stream_fill(MixStream* st)
+{
+    float* chunk = st->chunk;
+    uint32_t keep = 0;
+    int n;
+
+    if (st->chunkFrames) {
+        float* last = chunk + (st->chunkFrames - 1) * 2;
+        chunk[0] = last[0];
+        chunk[1] = last[1];
+        st->pos -= (uint64_t) (st->chunkFrames - 1) << 32;
+        keep = 1;
+    }
+
+    n = dec_read(&st->dec, chunk + keep * 2, STREAM_CHUNK);
+    if (n == 0 && st->loop) {
+        dec_seek(&st->dec, 0.0);
+        n = dec_read(&st->dec, chunk + keep * 2, STREAM_CHUNK);
+    }
+    st->chunkFrames = keep + n;
+    return n;
+}
+
+/*
+ * Begin playing an open stream from the given time.
+ */
+static void stream_start(MixStream* st, double seconds, uint32_t frames,
+                         int loop, float gain, float gainStep)
+{
+    dec_seek(&st->dec, seconds);
+    st->chunkFrames = 0;
+    st->pos = 0;
+    st->step = mix_step(st->dec.rate);
+    st->remain = frames;
+    st->loop = loop;
+    st->gain = gain;
+    st->gainStep = gainStep;
+    st->fadeStop = 0;
+    st->playing = stream_fill(st) ? 1 : 0;
+}
+
+static void mix_stream(Mixer* mx, MixStream* st, float volume)
+{
+    float* tmp = mx->temp;
+    int count = MIX_PERIOD;
+    int done = 0;
+    float g0, g1;
+
+    if (st->remain < (uint32_t) count)
+        count = st->remain;
+
+    while (done < count) {
+        done += mix_resample(tmp + done * 2, count - done, st->chunk,
+                             st->chunkFrames, &st->pos, st->step);
+        if (done < count && ! stream_fill(st))
+            break;
+    }
+    st->remain -= done;
+    if (done < count || ! st->remain)
+        st->playing = 0;
+
+    if (done) {
+        g0 = st->gain;
+        g1 = g0 + st->gainStep * done;
+        if (g1 >= 1.0f) {
+            g1 = 1.0f;
+            st->gainStep = 0.0f;
+        } else if (g1 <= 0.0f) {
+            g1 = 0.0f;
+            st->gainStep = 0.0f;
+            if (st->fadeStop)
+                st->playing = 0;
+        }
+        st->gain = g1;
+        mix_add(mx->mix, tmp, done, g0 * volume, (g1 - g0) * volume / done);
+    }
+}
+
+static void mix_period(Mixer* mx)
+{
+    MixSource* src;
+    const MixBuffer* buf;
+    int64_t now = usecTicks();
+    uint32_t usec;
+    int i, n;
+
+    memset(mx->mix, 0, sizeof(mx->mix));
+
+    for (i = 0; i < SOURCE_LIMIT; ++i) {
+        src = mx->source + i;
+        if (src->buffer < 0)
+            continue;
+        buf = buffers + src->buffer;
+        n = mix_resample(mx->temp, MIX_PERIOD, buf->samples, src->endFrame,
+                         &src->pos, src->step);
+        mix_add(mx->mix, mx->temp, n, soundVolume, 0.0f);
+        if (n < MIX_PERIOD)
+            src->buffer = -1;
+
+        if (src->requestTime) {
+            usec = uint32_t(now - src->requestTime);
+            src->requestTime = 0;
+            mx->stats.plays++;
+            mx->stats.latencyUsec += usec;
+            if (usec > mx->stats.latencyMaxUsec)
+                mx->stats.latencyMaxUsec = usec;
+        }
+    }
+
+    if (mx->speech.playing)
+        mix_stream(mx, &mx->speech, soundVolume);
+    if (mx->music.playing)
+        mix_stream(mx, &mx->music, musicVolume);
+}
+
+static THREAD_FUNC mixerThread(void* arg)
+{
+    Mixer* mx = (Mixer*) arg;
+    uint64_t framesOut = 0;
+    uint32_t startTime = getTicks();
+    uint32_t due, now;
+    int64_t t0;
+
+    while (mx->running) {
+        if (mx->suspended) {
+            thread_sleep(20);
+            startTime = getTicks();
+            framesOut = 0;
+            continue;
+        }
+
+        t0 = usecTicks();
+        mutex_lock(&mx->lock);
+        mix_period(mx);
+        mutex_unlock(&mx->lock);
+        mix_toS16(mx->out, mx->mix, MIX_PERIOD * 2);
+        mx->stats.mixUsec += usecTicks() - t0;
+        mx->stats.periods++;
+
+        if (mx->wav) {
+            fwrite(mx->out, sizeof(int16_t), MIX_PERIOD * 2, mx->wav);
+            mx->wavBytes += MIX_PERIOD * 2 * sizeof(int16_t);
+        }
+
+        // Wait until the period would have been played by a device.
+        framesOut += MIX_PERIOD;
+        due = startTime + (uint32_t) (framesOut * 1000 / MIX_RATE);
+        now = getTicks();
+        if ((int32_t) (due - now) > 0)
+            thread_sleep(due - now);
+        else if (now - due > 1000 * MIX_PERIOD / MIX_RATE)
+            mx->stats.late++;
+    }
+    return THREAD_RETURN;
+}
+
+static void wav_writeHeader(FILE* fp, uint32_t dataBytes)
+{
+    uint8_t head[44];
+    uint32_t v;
+    int i;
+    const uint32_t fields[] = {
+        36 + dataBytes, 16, 1 | 2 << 16, MIX_RATE, MIX_RATE * 4,
+        4 | 16 << 16, dataBytes
+    };
+    const int fieldPos[] = { 4, 16, 20, 24, 28, 32, 40 };
+
+    memcpy(head, "RIFF....WAVEfmt ....................data....", 44);
+    for (i = 0; i < 7; ++i) {
+        v = fields[i];
+        head[fieldPos[i]]   = v;
+        head[fieldPos[i]+1] = v >> 8;
+        head[fieldPos[i]+2] = v >> 16;
+        head[fieldPos[i]+3] = v >> 24;
+    }
+    fseek(fp, 0, SEEK_SET);
+    fwrite(head, 1, 44, fp);
+}
+
+/*
+ * Decode all of a sound into an empty buffer and close the decoder.
+ * Return the duration in milliseconds or BUFFER_MS_FAILED.
+ */
+static uint32_t mix_decodeBuffer(MixBuffer* buf, Decoder* dec)
+{
+    uint32_t avail = 0;
+    float* samples;
+    int n;
+
+    buf->ms = BUFFER_MS_FAILED;
+    do {
+        if (buf->frames + STREAM_CHUNK + 1 > avail) {
+            avail = avail ? avail * 2 : STREAM_CHUNK * 2;
+            samples = (float*) realloc(buf->samples,
+                                       avail * 2 * sizeof(float));
+            if (! samples) {
+                dec_close(dec);
+                return buf->ms;
+            }
+            buf->samples = samples;
+        }
+        n = dec_read(dec, buf->samples + buf->frames * 2, STREAM_CHUNK);
+        buf->frames += n;
+    } while (n);
+    dec_close(dec);
+
+    if (buf->frames) {
+        buf->samples[buf->frames*2] = buf->samples[buf->frames*2+1] = 0.0f;
+        buf->frames++;
+        buf->rate = dec->rate;
+        buf->ms = uint32_t(buf->frames * 1000.0 / dec->rate);
+        if (buf->ms <= BUFFER_MS_FAILED)
+            buf->ms = BUFFER_MS_FAILED + 1;
+    }
+    return buf->ms;
+}
+
+static void mixer_free(Mixer*);
+
+/*
+ * Create a mixer and start its thread.  If wav is not NULL the output is
+ * written to it and the file is closed by mixer_free().
+ * Return NULL if the thread could not be started.
+ */
+static Mixer* mixer_new(FILE* wav)
+{
+    Mixer* mx = (Mixer*) calloc(1, sizeof(Mixer));
+    for (int i = 0; i < SOURCE_LIMIT; ++i)
+        mx->source[i].buffer = -1;
+    mx->speech.chunk = (float*) malloc((STREAM_CHUNK+1) * 2 * sizeof(float));
+    mx->music.chunk  = (float*) malloc((STREAM_CHUNK+1) * 2 * sizeof(float));
+    mutex_init(&mx->lock);
+
+    mx->wav = wav;
+    if (wav)
+        wav_writeHeader(wav, 0);
+
+    mx->running = 1;
+    if (! thread_create(&mx->thread, mixerThread, mx)) {
+        mx->running = 0;
+        mixer_free(mx);
+        return NULL;
+    }
+    return mx;
+}
+
+static void mixer_stop(Mixer* mx)
+{
+    if (mx->running) {
+        mx->running = 0;
+        thread_join(mx->thread);
+    }
+}
+
+static void mixer_free(Mixer* mx)
+{
+    mixer_stop(mx);
+
+    if (mx->wav) {
+        wav_writeHeader(mx->wav, mx->wavBytes);
+        fclose(mx->wav);
+    }
+
+    stream_close(&mx->speech);
+    stream_close(&mx->music);
+    free(mx->speech.chunk);
+    free(mx->music.chunk);
+    mutex_free(&mx->lock);
+    free(mx);
+}
+
+static void mixer_printStats(const Mixer* mx)
+{
+    const MixStats* st = &mx->stats;
+    if (! st->periods)
+        return;
+    double audioSec = double(st->periods) * MIX_PERIOD / MIX_RATE;
+    double mixSec = double(st->mixUsec) / 1000000.0;
+    printf("Mixer: %u periods, %u late, mixing %.3f%% of %.1f sec\n",
+           st->periods, st->late, 100.0 * mixSec / audioSec, audioSec);
+    if (st->plays)
+        printf("Mixer latency: %u plays, mean %.1f usec, max %u usec\n",
+               st->plays, double(st->latencyUsec) / st->plays,
+               st->latencyMaxUsec);
+}
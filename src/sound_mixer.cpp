@@ -0,0 +1,415 @@
+/*
+ * sound_mixer.cpp
+ *
+ * Built-in software mixer for systems without an audio library or device.
+ *
+ * Sources are resampled to MIX_RATE and mixed in float on a thread which
+ * runs in real time.  The output is written as 16-bit stereo to the WAV file
+ * named by the XU4_MIXER_WAV environment variable, or discarded if that is
+ * not set.  WAV & Ogg Vorbis data is supported.
+ *
+ * With the verbose option the time spent mixing and the time from soundPlay()
+ * to the period in which a sound starts are printed on exit.
+ */
+
+#include "sound_mixcore.cpp"
+
+#include "config.h"
+#include "context.h"
+#include "debug.h"
+#include "error.h"
+#include "event.h"
+#include "settings.h"
+#include "xu4.h"
+
+#define config_soundFile(id)    xu4.config->soundFile(id)
+#define config_musicFile(id)    xu4.config->musicFile(id)
+#define config_voiceParts(id)   xu4.config->voiceParts(id)
+
+static int currentTrack;
+static int musicEnabled;
+static int nextSource;              // Use sources in round-robin order.
+static Mixer* mixer = NULL;
+
+//--------------------------------------
+
+/*
+ * Initialize sound & music service.
+ */
+int soundInit()
+{
+    const char* wavFile;
+    FILE* wav = NULL;
+
+    currentTrack = MUSIC_NONE;
+    nextSource = 0;
+    memset(buffers, 0, sizeof(buffers));
+
+    wavFile = getenv("XU4_MIXER_WAV");
+    if (wavFile) {
+        wav = fopen(wavFile, "wb");
+        if (! wav)
+            errorWarning("Mixer: Unable to open %s", wavFile);
+    }
+
+    mixer = mixer_new(wav);
+    if (! mixer) {
+        errorWarning("Mixer: Unable to start thread");
+        return 0;
+    }
+
+    musicEnabled = 1;
+    musicSetVolume(xu4.settings->musicVol);
+    soundSetVolume(xu4.settings->soundVol);
+    return 1;
+}
+
+void soundDelete()
+{
+    Mixer* mx = mixer;
+    if (! mx)
+        return;
+
+    mixer_stop(mx);
+    if (xu4.verbose)
+        mixer_printStats(mx);
+    mixer_free(mx);
+    mixer = NULL;
+    soundVolume = musicVolume = 0.0f;
+
+    for (int i = 0; i < BUFFER_LIMIT; ++i)
+        free(buffers[i].samples);
+    memset(buffers, 0, sizeof(buffers));
+}
+
+void soundSuspend(int halt)
+{
+    if (mixer)
+        mixer->suspended = halt;
+}
+
+void soundFreeResourceGroup(uint16_t group)
+{
+    MixBuffer* buf;
+    int i, s;
+
+    if (! mixer)
+        return;
+
+    mutex_lock(&mixer->lock);
+    for (i = 0; i < BUFFER_LIMIT; ++i) {
+        buf = buffers + i;
+        if (buf->ms > BUFFER_MS_FAILED && buf->resGroup == group) {
+            for (s = 0; s < SOURCE_LIMIT; ++s) {
+                if (mixer->source[s].buffer == i)
+                    mixer->source[s].buffer = -1;
+            }
+            free(buf->samples);
+            memset(buf, 0, sizeof(MixBuffer));
+        }
+    }
+    mutex_unlock(&mixer->lock);
+}
+
+static bool soundFileOpen(Decoder* dec, int sound)
+{
+#ifdef CONF_MODULE
+    const CDIEntry* ent = config_soundFile(sound);
+    if (ent)
+        return dec_open(dec, xu4.config->modulePath(ent), ent->offset,
+                        ent->bytes);
+#else
+    const char* pathname = config_soundFile(sound);
+    if (pathname)
+        return dec_open(dec, pathname, 0, 0);
+#endif
+    return false;
+}
+
+/*
+ * Decode a sound into memory.  The buffer is not used by the mixer until
+ * it is referenced by a source, so no lock is needed.
+ */
+static int loadSoundBuffer(int sound)
+{
+    MixBuffer* buf = buffers + sound;
+    Decoder dec;
+
+    buf->ms = BUFFER_MS_FAILED;
+    buf->resGroup = xu4.resGroup;
+    if (soundFileOpen(&dec, sound))
+        mix_decodeBuffer(buf, &dec);
+    return buf->ms;
+}
+
+/*
+ * Load all sound effect buffers now so that the first soundPlay() of each
+ * does not wait on decoding.  Voice streams are not read ahead.
+ *
+ * Unlike the Faun backend this decodes synchronously on the calling (main)
+ * thread.  loadSoundBuffer() is not safe to run beside soundPlay() and
+ * soundFreeResourceGroup(), and the mixer is only a fallback for systems
+ * without audio, so the stall is accepted rather than adding a loader.
+ */
+void soundPreload(const uint16_t* /*voiceIds*/, int /*voiceCount*/)
+{
+    if (soundVolume <= 0.0f)
+        return;
+    for (int i = 0; i < BUFFER_LIMIT; ++i) {
+        if (buffers[i].ms == 0)
+            loadSoundBuffer(i);
+    }
+}
+
+void soundPlay(Sound sound, int limitMSec)
+{
+    ASSERT(sound < SOUND_MAX, "Invalid soundPlay() id");
+
+    // Do nothing if muted or soundInit failed.
+    if (soundVolume <= 0.0f)
+        return;
+
+    const MixBuffer* buf = buffers + sound;
+    if (buf->ms == 0)
+        loadSoundBuffer(sound);
+    if (buf->ms == BUFFER_MS_FAILED)
+        return;
+
+    // As with the Faun backend, the source SID_END is reserved for sounds
+    // with limitMSec.
+
+    int sid;
+    if (limitMSec > 0)
+        sid = SID_END;
+    else {
+        sid = nextSource;
+        if (++nextSource >= SID_END)
+            nextSource = 0;
+    }
+
+    uint32_t end = buf->frames;
+    if (limitMSec > 0) {
+        uint32_t limit = uint32_t(limitMSec) * buf->rate / 1000 + 1;
+        if (limit < end)
+            end = limit;
+    }
+
+    mutex_lock(&mixer->lock);
+    MixSource* src = mixer->source + sid;
+    src->buffer = sound;
+    src->endFrame = end;
+    src->requestTime = usecTicks();
+    src->pos = 0;
+    src->step = mix_step(buf->rate);
+    mutex_unlock(&mixer->lock);
+}
+
+/*
+ * Play a line of spoken dialogue.
+ */
+void soundSpeakLine(int streamId, int line, bool wait) {
+#ifdef CONF_MODULE
+    if (soundVolume <= 0.0f || streamId < 1)
+        return;
+
+    const float* streamPart = config_voiceParts(streamId);
+    if (! streamPart)
+        return;
+    streamPart += line * 2;
+    if (streamPart[0] < 0.3f)           // Ignore NUL entries.
+        return;
+
+    MixStream* st = &mixer->speech;
+    mutex_lock(&mixer->lock);
+    if (streamId != st->id) {
+        stream_close(st);
+        const CDIEntry* ent = config_musicFile(streamId);
+        if (ent && dec_open(&st->dec, xu4.config->modulePath(ent),
+                            ent->offset, ent->bytes))
+            st->id = streamId;
+    }
+    if (st->id) {
+        stream_start(st, streamPart[1], uint32_t(streamPart[0] * MIX_RATE),
+                     0, 1.0f, 0.0f);
+    }
+    mutex_unlock(&mixer->lock);
+
+    if (! st->id) {
+        errorWarning("Dialogue audio stream %d not found", streamId);
+        return;
+    }
+
+    if (wait)
+        EventHandler::wait_msecs(int(1000.0f * streamPart[0]));
+#else
+    (void) streamId;
+    (void) line;
+    (void) wait;
+#endif
+}
+
+/*
+ * Return duration in milliseconds.
+ */
+int soundDuration(Sound sound)
+{
+    int ms = buffers[sound].ms;
+    if (ms == 0)
+        ms = loadSoundBuffer(sound);
+    if (ms == BUFFER_MS_FAILED)
+        return 0;
+    return ms;
+}
+
+/*
+ * Stop all sound effects.  Use musicStop() to halt music playback.
+ */
+void soundStop() {
+    if (! mixer)
+        return;
+    mutex_lock(&mixer->lock);
+    for (int i = 0; i < SOURCE_LIMIT; ++i)
+        mixer->source[i].buffer = -1;
+    mutex_unlock(&mixer->lock);
+}
+
+/*
+ * Start playing a music track.
+ *
+ * Return true if the stream begins playing from the start.  If the stream
+ * is already playing or it cannot be loaded then false is returned.
+ */
+static bool music_start(int music, int fadeMs) {
+    ASSERT(music < MUSIC_MAX, "Invalid music_start() track id");
+
+    // Track already loaded
+    if (music == currentTrack || ! mixer)
+        return false;
+
+    MixStream* st = &mixer->music;
+    bool ok = false;
+
+    mutex_lock(&mixer->lock);
+    stream_close(st);
+#ifdef CONF_MODULE
+    const CDIEntry* ent = config_musicFile(music);
+    if (ent)
+        ok = dec_open(&st->dec, xu4.config->modulePath(ent),
+                      ent->offset, ent->bytes);
+#else
+    const char* pathname = config_musicFile(music);
+    if (pathname)
+        ok = dec_open(&st->dec, pathname, 0, 0);
+#endif
+    if (ok) {
+        st->id = music;
+        if (fadeMs > 0)
+            stream_start(st, 0.0, 0xffffffff, 1, 0.0f,
+                         1000.0f / (fadeMs * MIX_RATE));
+        else
+            stream_start(st, 0.0, 0xffffffff, 1, 1.0f, 0.0f);
+    }
+    mutex_unlock(&mixer->lock);
+
+    currentTrack = music;
+    return ok;
+}
+
+void musicPlay(int track)
+{
+    if (musicEnabled && musicVolume > 0.0f)
+        music_start(track, 0);
+}
+
+void musicPlayLocale()
+{
+    musicPlay(c->location->map->music);
+}
+
+void musicStop()
+{
+    currentTrack = MUSIC_NONE;
+    if (mixer) {
+        mutex_lock(&mixer->lock);
+        mixer->music.playing = 0;
+        mutex_unlock(&mixer->lock);
+    }
+}
+
+void musicFadeOut(int msec)
+{
+    if (currentTrack != MUSIC_NONE) {
+        currentTrack = MUSIC_NONE;
+        if (xu4.settings->volumeFades && msec > 0 && mixer) {
+            MixStream* st = &mixer->music;
+            mutex_lock(&mixer->lock);
+            st->gainStep = -1000.0f / (msec * MIX_RATE);
+            st->fadeStop = 1;
+            mutex_unlock(&mixer->lock);
+        } else
+            musicStop();
+    }
+}
+
+void musicFadeIn(int msec, bool loadFromMap)
+{
+    if (! xu4.settings->volumeFades)
+        msec = 0;
+
+    if (loadFromMap || currentTrack == MUSIC_NONE)
+        music_start(c->location->map->music, msec);
+}
+
+void musicSetVolume(int volume)
+{
+    musicVolume = float(volume) / MAX_VOLUME;
+}
+
+int musicVolumeDec()
+{
+    if (xu4.settings->musicVol > 0)
+        musicSetVolume(--xu4.settings->musicVol);
+    return (xu4.settings->musicVol * 100 / MAX_VOLUME);  // percentage
+}
+
+int musicVolumeInc()
+{
+    if (xu4.settings->musicVol < MAX_VOLUME)
+        musicSetVolume(++xu4.settings->musicVol);
+    return (xu4.settings->musicVol * 100 / MAX_VOLUME);  // percentage
+}
+
+/**
+ * Toggle the music on/off.
+ */
+bool musicToggle()
+{
+    musicEnabled = ! musicEnabled;
+    if (musicEnabled)
+        musicFadeIn(1000, true);
+    else
+        musicFadeOut(1000);
+
+    return musicEnabled;
+}
+
+/*
+ * Set volume for sound effects and spoken dialogue.
+ */
+void soundSetVolume(int volume) {
+    soundVolume = float(volume) / MAX_VOLUME;
+}
+
+int soundVolumeDec()
+{
+    if (xu4.settings->soundVol > 0)
+        soundSetVolume(--xu4.settings->soundVol);
+    return (xu4.settings->soundVol * 100 / MAX_VOLUME);  // percentage
+}
+
+int soundVolumeInc()
+{
+    if (xu4.settings->soundVol < MAX_VOLUME)
+        soundSetVolume(++xu4.settings->soundVol);
+    return (xu4.settings->soundVol * 100 / MAX_VOLUME);  // percentage
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "anim.h"
 
 #ifdef CONFIG_ANIM_RANDOM
@@ -8,6 +9,16 @@
 extern int anim_random(int range);
 #endif
 
+/*
+ * Animated values are grouped by type in dense arrays so that each type is
+ * advanced in its own tight loop.  An AnimId selects a slot which holds the
+ * position of the value in its type array.  When a value is released the
+ * last value of the same type is moved into its place.
+ *
+ * The ANIM_LINEAR_F2 components are kept in separate arrays (structure of
+ * arrays) so that the compiler can vectorize the interpolation.
+ */
+
 enum AnimType {
     ANIM_CYCLE_I,
     ANIM_CYCLE_RANDOM_I,
@@ -15,34 +26,50 @@ enum AnimType {
 };
 
 typedef struct {
-    uint16_t animType;
-    uint16_t state;
-    uint16_t loops;
+    uint16_t gen;
+    uint8_t  animType;
+    uint8_t  state;
+    uint16_t index;         // Position in type array or next free slot.
     uint16_t _pad;
     uint32_t finishId;
-    float duration;
-    float ctime;
     union {
-        struct {
-            int start;
-            int end;
-            int current;
-            int chance;
-        } i;
-        struct {
-            float start[2];
-            float end[2];
-            float current[2];
-        } f2;
-    } var;
+        int   i;
+        float f2[2];
+    } last;                 // Value when the slot was released.
+}
+AnimSlot;
+
+typedef struct {
+    float ctime;
+    float duration;
+    uint16_t loops;
+    uint16_t slot;
+    int start;
+    int end;
+    int current;
+    int chance;
 }
-AnimatedValue;
+AnimCycle;
 
-#define BANK(an)        ((AnimatedValue*) an->bank)
+#define SLOTS(an)       ((AnimSlot*) an->slots)
+#define CYCLES(an)      ((AnimCycle*) an->cycles)
 #define ANIM_FINISHED   (ANIM_PAUSED+1)
 
 #define FREE_TERM   0xffff
-#define NEXT_FREE   finishId
+#define SLOT_LIMIT  0xffff
+#define ID_SLOT(id) ((id) & 0xffff)
+#define ID_GEN(id)  ((id) >> 16)
+
+// Layout of the Animator::linear block for avail values.  The per-value
+// arrays are followed by pairs for the two components.
+#define LIN_CTIME(an)   (an->linear)
+#define LIN_INVDUR(an)  (an->linear + an->avail)    // 1 / duration
+#define LIN_RATE(an)    (an->linear + an->avail*2)  // 1 if playing, 0 if not.
+#define LIN_START(an)   (an->linear + an->avail*3)
+#define LIN_DELTA(an)   (an->linear + an->avail*5)
+#define LIN_CUR(an)     (an->linear + an->avail*7)
+#define LIN_SLOT(an)    ((uint16_t*) (an->linear + an->avail*9))
+#define LIN_BYTES(n)    ((n) * (9 * sizeof(float) + sizeof(uint16_t)))
 
 static void anim_nopFinish(void* fdata, uint32_t fid)
 {
@@ -51,7 +78,69 @@ static void anim_nopFinish(void* fdata, uint32_t fid)
 }
 
 /*
- * Allocate memory for the specified maximum number of animated values.
+ * Link slots from start to the end of the bank into the free list.
+ */
+static void anim_linkFree(Animator* an, uint32_t start)
+{
+    AnimSlot* it = SLOTS(an) + start;
+    uint32_t i;
+
+    for (i = start + 1; i <= an->avail; ++i, ++it) {
+        it->index = (i < an->avail) ? i : FREE_TERM;
+        it->state = ANIM_FREE;
+    }
+    an->firstFree = (start < an->avail) ? start : FREE_TERM;
+}
+
+/*
+ * Resize the bank to hold count values.
+ *
+ * Return non-zero if memory allocation is successful.
+ */
+static int anim_resize(Animator* an, uint32_t count)
+{
+    AnimSlot* slots;
+    AnimCycle* cycles;
+    float* lin;
+    uint32_t i, old = an->avail;
+
+    slots = (AnimSlot*) realloc(an->slots, sizeof(AnimSlot) * count);
+    if (! slots)
+        return 0;
+    an->slots = slots;
+
+    cycles = (AnimCycle*) realloc(an->cycles, sizeof(AnimCycle) * count);
+    if (! cycles)
+        return 0;
+    an->cycles = cycles;
+
+    lin = (float*) malloc(LIN_BYTES(count));
+    if (! lin)
+        return 0;
+    if (an->linear) {
+        // Copy the used part of each array to its new position.
+        const float* src = an->linear;
+        uint32_t n = an->linearCount;
+        for (i = 0; i < 3; ++i)
+            memcpy(lin + count*i, src + old*i, sizeof(float) * n);
+        for (i = 3; i < 9; i += 2)
+            memcpy(lin + count*i, src + old*i, sizeof(float) * n * 2);
+        memcpy(lin + count*9, src + old*9, sizeof(uint16_t) * n);
+        free(an->linear);
+    }
+    an->linear = lin;
+    an->avail = count;
+
+    for (i = old; i < count; ++i) {
+        slots[i].gen = 0;
+        slots[i].state = ANIM_FREE;
+    }
+    return 1;
+}
+
+/*
+ * Allocate memory for the specified number of animated values.  The bank
+ * grows as needed when more values are started.
  *
  * Return non-zero if memory allocation is successful.
  */
@@ -60,8 +149,13 @@ int anim_init(Animator* an, int count, void (*finishFunc)(void*, uint32_t),
 {
     an->finish = finishFunc ? finishFunc : anim_nopFinish;
     an->finishData = fdata;
-    an->bank = malloc(sizeof(AnimatedValue) * count);
-    an->avail = an->bank ? count : 0;
+    an->slots = an->cycles = NULL;
+    an->linear = NULL;
+    an->avail = 0;
+    if (count > SLOT_LIMIT)
+        count = SLOT_LIMIT;
+    if (count > 0 && ! anim_resize(an, count))
+        anim_free(an);
     anim_clear(an);
     return an->avail;
 }
@@ -71,67 +165,138 @@ int anim_init(Animator* an, int count, void (*finishFunc)(void*, uint32_t),
  */
 void anim_free(Animator* an)
 {
-    free(an->bank);
-    an->bank = NULL;
-    an->avail = an->used = 0;
+    free(an->slots);
+    free(an->cycles);
+    free(an->linear);
+    an->slots = an->cycles = NULL;
+    an->linear = NULL;
+    an->avail = an->cycleCount = an->linearCount = 0;
+    an->firstFree = FREE_TERM;
 }
 
 /*
  * Stop all animations and return them to the free pool.
+ * Any AnimId values held become invalid.
  */
 void anim_clear(Animator* an)
 {
-    an->used = an->firstFree = 0;
-    if (an->avail) {
-        AnimatedValue* it = BANK(an);
-        int end = an->avail - 1;
-        int i;
-
-        for (i = 1; i < end; ++i) {
-            it->NEXT_FREE = i;      // Point to next free value.
-            it->state = ANIM_FREE;
-            ++it;
-        }
-        it->NEXT_FREE = FREE_TERM;
-        it->state = ANIM_FREE;
+    AnimSlot* it  = SLOTS(an);
+    AnimSlot* end = it + an->avail;
+
+    for (; it != end; ++it) {
+        if (it->state != ANIM_FREE)
+            ++it->gen;
     }
+    an->cycleCount = an->linearCount = 0;
+    anim_linkFree(an, 0);
 }
 
-static AnimId anim_alloc(Animator* an)
+static AnimId anim_alloc(Animator* an, int type, uint32_t fid)
 {
-    AnimId id = an->firstFree;
-    if (id != FREE_TERM) {
-        an->firstFree = BANK(an)[id].NEXT_FREE;
-        if (id >= an->used)
-            an->used = id + 1;
+    AnimSlot* sp;
+    uint32_t si = an->firstFree;
+
+    if (si == FREE_TERM) {
+        uint32_t old = an->avail;
+        uint32_t count = old ? old * 2 : 16;
+        if (count > SLOT_LIMIT)
+            count = SLOT_LIMIT;
+        if (count == old || ! anim_resize(an, count))
+            return ANIM_UNUSED;
+        anim_linkFree(an, old);
+        si = old;
     }
-    return id;
+
+    sp = SLOTS(an) + si;
+    an->firstFree = sp->index;
+    sp->animType = type;
+    sp->state    = ANIM_PLAYING;
+    sp->finishId = fid;
+    if (type == ANIM_LINEAR_F2) {
+        sp->index = an->linearCount++;
+        LIN_SLOT(an)[sp->index] = si;
+    } else {
+        sp->index = an->cycleCount++;
+        CYCLES(an)[sp->index].slot = si;
+    }
+    return ((uint32_t) sp->gen << 16) | si;
 }
 
-static void anim_release(Animator* an, AnimatedValue* it)
+static void anim_release(Animator* an, uint32_t si)
 {
-    AnimatedValue* bank = BANK(an);
-    int itPos, last;
+    AnimSlot* slots = SLOTS(an);
+    AnimSlot* sp = slots + si;
+    uint32_t i = sp->index;
+    uint32_t last;
 
-    it->state = ANIM_FREE;
+    if (sp->animType == ANIM_LINEAR_F2) {
+        float* cur = LIN_CUR(an);
+        sp->last.f2[0] = cur[i*2];
+        sp->last.f2[1] = cur[i*2+1];
 
-    // Link into the free list.
-    it->NEXT_FREE = an->firstFree;
-    an->firstFree = itPos = it - bank;
-
-    // Adjust used downward to the next active value.
-    last = an->used - 1;
-    if (itPos == last) {
-        do {
-            --last;
-        } while (last >= 0 && bank[last].state == ANIM_FREE);
-        an->used = last + 1;
+        last = --an->linearCount;
+        if (i != last) {
+            float* lin = an->linear;
+            uint32_t n = an->avail;
+            int k;
+            for (k = 0; k < 3; ++k)
+                lin[n*k + i] = lin[n*k + last];
+            for (k = 3; k < 9; k += 2) {
+                lin[n*k + i*2]   = lin[n*k + last*2];
+                lin[n*k + i*2+1] = lin[n*k + last*2+1];
+            }
+            LIN_SLOT(an)[i] = LIN_SLOT(an)[last];
+            slots[LIN_SLOT(an)[i]].index = i;
+        }
+    } else {
+        AnimCycle* cycles = CYCLES(an);
+        sp->last.i = cycles[i].current;
+
+        last = --an->cycleCount;
+        if (i != last) {
+            cycles[i] = cycles[last];
+            slots[cycles[i].slot].index = i;
+        }
     }
+
+    // Link into the free list.
+    sp->state = ANIM_FREE;
+    ++sp->gen;
+    sp->index = an->firstFree;
+    an->firstFree = si;
 }
 
-static float lerp(float start, float end, float frac)
+/*
+ * Invoke the finish handler and release the slot for completed animations.
+ * The handler may start or stop other animations.
+ */
+static void anim_releaseFinished(Animator* an)
 {
-    return start + (end - start) * frac;
+    uint32_t i, si, fid;
+
+    for (i = an->linearCount; i-- > 0; ) {
+        if (i >= an->linearCount)
+            continue;
+        si = LIN_SLOT(an)[i];
+        if (SLOTS(an)[si].state == ANIM_FINISHED) {
+            fid = SLOTS(an)[si].finishId;
+            anim_release(an, si);
+            if (fid)
+                an->finish(an->finishData, fid);
+        }
+    }
+
+    for (i = an->cycleCount; i-- > 0; ) {
+        if (i >= an->cycleCount)
+            continue;
+        si = CYCLES(an)[i].slot;
+        if (SLOTS(an)[si].state == ANIM_FINISHED) {
+            fid = SLOTS(an)[si].finishId;
+            anim_release(an, si);
+            if (fid)
+                an->finish(an->finishData, fid);
+        }
+    }
 }
 
 /*
@@ -139,14 +304,50 @@ static float lerp(float start, float end, float frac)
  */
 void anim_advance(Animator* an, float seconds)
 {
-    AnimatedValue* it  = BANK(an);
-    AnimatedValue* end = it + an->used;
-    AnimatedValue* firstDone = NULL;
-    AnimatedValue* endDone = NULL;
-
-    for ( ; it != end; ++it) {
-        if (it->state == ANIM_PLAYING) {
-            // Advance time.
+    AnimSlot* slots = SLOTS(an);
+    uint32_t i, n;
+    int done = 0;
+
+    n = an->linearCount;
+    if (n) {
+        float* ctime = LIN_CTIME(an);
+        const float* invDur = LIN_INVDUR(an);
+        const float* rate  = LIN_RATE(an);
+        const float* start = LIN_START(an);
+        const float* delta = LIN_DELTA(an);
+        float* cur         = LIN_CUR(an);
+        const uint16_t* slotIndex = LIN_SLOT(an);
+        uint32_t finished = 0;
+        float t, f;
+
+        // Advance time & interpolate in one branch-free pass.
+        for (i = 0; i < n; ++i) {
+            t = ctime[i] + seconds * rate[i];
+            ctime[i] = t;
+            f = t * invDur[i];
+            finished += (f >= 1.0f && rate[i] != 0.0f);
+            f = (f < 1.0f) ? f : 1.0f;
+            cur[i*2]   = start[i*2]   + delta[i*2]   * f;
+            cur[i*2+1] = start[i*2+1] + delta[i*2+1] * f;
+        }
+
+        if (finished) {
+            for (i = 0; i < n; ++i) {
+                if (ctime[i] * invDur[i] >= 1.0f && rate[i] != 0.0f)
+                    slots[slotIndex[i]].state = ANIM_FINISHED;
+            }
+            done = 1;
+        }
+    }
+
+    n = an->cycleCount;
+    if (n) {
+        AnimCycle* it  = CYCLES(an);
+        AnimCycle* end = it + n;
+
+        for ( ; it != end; ++it) {
+            if (slots[it->slot].state != ANIM_PLAYING)
+                continue;
             it->ctime += seconds;
             if (it->ctime >= it->duration) {
                 // Cycle complete.
@@ -158,81 +359,40 @@ void anim_advance(Animator* an, float seconds)
                     if (it->loops) {
                         it->ctime -= it->duration;
                     } else {
-                        it->state = ANIM_FINISHED;
-                        if (! firstDone)
-                            firstDone = it;
-                        endDone = it + 1;
+                        slots[it->slot].state = ANIM_FINISHED;
+                        done = 1;
                     }
                 }
 
 #ifdef CONFIG_ANIM_RANDOM
-                if (it->animType == ANIM_CYCLE_RANDOM_I) {
-                    if (it->var.i.chance > anim_random(100)) {
-                        int n = it->var.i.current + 1;
-                        it->var.i.current =
-                            (n < it->var.i.end) ? n : it->var.i.start;
-                    }
-                    continue;
+                if (slots[it->slot].animType == ANIM_CYCLE_RANDOM_I &&
+                    it->chance > anim_random(100)) {
+                    int c = it->current + 1;
+                    it->current = (c < it->end) ? c : it->start;
                 }
 #endif
             }
-
-            // Update value.
-            switch (it->animType) {
-                case ANIM_LINEAR_F2:
-                    if (it->state == ANIM_FINISHED) {
-                        it->var.f2.current[0] = it->var.f2.end[0];
-                        it->var.f2.current[1] = it->var.f2.end[1];
-                    } else {
-                        float frac = it->ctime / it->duration;
-                        it->var.f2.current[0] = lerp(it->var.f2.start[0],
-                                                     it->var.f2.end[0], frac);
-                        it->var.f2.current[1] = lerp(it->var.f2.start[1],
-                                                     it->var.f2.end[1], frac);
-                    }
-                    break;
-            }
         }
     }
 
-    // Invoke the finish handler and release the slot for completed animations.
-    while (firstDone != endDone) {
-        // This iterates backwards so that the last released slot has the
-        // lowest firstFree index of the batch.  This sets up the next
-        // anim_alloc to produce a lower Animator::used value.
-
-        --endDone;
-        if (endDone->state == ANIM_FINISHED) {
-            if (endDone->finishId)
-                an->finish(an->finishData, endDone->finishId);
-            anim_release(an, endDone);
-        }
-    }
-}
-
-static void anim_stdInit(AnimatedValue* it, float dur, int loops, uint32_t fid)
-{
-    it->state    = ANIM_PLAYING;
-    it->loops    = loops;
-    it->_pad     = 0;
-    it->finishId = fid;
-    it->duration = dur;
-    it->ctime    = 0.0f;
+    if (done)
+        anim_releaseFinished(an);
 }
 
 #ifdef CONFIG_ANIM_RANDOM
 AnimId anim_startCycleRandomI(Animator* an, float dur, int loops, uint32_t fid,
                               int start, int end, int chance)
 {
-    AnimId id = anim_alloc(an);
-    if (id != FREE_TERM) {
-        AnimatedValue* it = BANK(an) + id;
-        it->animType = ANIM_CYCLE_RANDOM_I;
-        anim_stdInit(it, dur, loops, fid);
-        it->var.i.start  = start;
-        it->var.i.end    = end;
-        it->var.i.current = start;
-        it->var.i.chance = chance;
+    AnimId id = anim_alloc(an, ANIM_CYCLE_RANDOM_I, fid);
+    if (id != ANIM_UNUSED) {
+        AnimCycle* it = CYCLES(an) + SLOTS(an)[ID_SLOT(id)].index;
+        it->ctime    = 0.0f;
+        it->duration = dur;
+        it->loops    = loops;
+        it->start    = start;
+        it->end      = end;
+        it->current  = start;
+        it->chance   = chance;
 
         //printf("anim_start %d dur:%f chance:%d\n", id, dur, chance);
     }
@@ -243,38 +403,73 @@ AnimId anim_startCycleRandomI(Animator* an, float dur, int loops, uint32_t fid,
 AnimId anim_startLinearF2(Animator* an, float dur, uint32_t fid,
                           float* start, float* end)
 {
-    AnimId id = anim_alloc(an);
-    if (id != FREE_TERM) {
-        AnimatedValue* it = BANK(an) + id;
-        it->animType = ANIM_LINEAR_F2;
-        anim_stdInit(it, dur, 1, fid);
-        it->var.f2.start[0] = it->var.f2.current[0] = start[0];
-        it->var.f2.start[1] = it->var.f2.current[1] = start[1];
-        it->var.f2.end[0]   = end[0];
-        it->var.f2.end[1]   = end[1];
+    AnimId id = anim_alloc(an, ANIM_LINEAR_F2, fid);
+    if (id != ANIM_UNUSED) {
+        uint32_t i = SLOTS(an)[ID_SLOT(id)].index;
+        LIN_CTIME(an)[i] = 0.0f;
+        LIN_INVDUR(an)[i] = (dur > 0.0f) ? 1.0f / dur : 1e30f;
+        LIN_RATE(an)[i]  = 1.0f;
+        i *= 2;
+        LIN_START(an)[i]   = LIN_CUR(an)[i]   = start[0];
+        LIN_START(an)[i+1] = LIN_CUR(an)[i+1] = start[1];
+        LIN_DELTA(an)[i]   = end[0] - start[0];
+        LIN_DELTA(an)[i+1] = end[1] - start[1];
     }
     return id;
 }
 
 /*
- * Pause, unpause, or stop an animation.
+ * Return non-zero if the id refers to an animation which has not been
+ * released.
+ */
+int anim_valid(const Animator* an, AnimId id)
+{
+    uint32_t si = ID_SLOT(id);
+    const AnimSlot* sp;
+
+    if (si >= an->avail)
+        return 0;
+    sp = SLOTS(an) + si;
+    return sp->gen == ID_GEN(id) && sp->state != ANIM_FREE;
+}
+
+/*
+ * Pause, unpause, or stop an animation.  Ids of animations which have
+ * already been released are ignored.
  */
 void anim_setState(Animator* an, AnimId id, int animState)
 {
-    AnimatedValue* it = BANK(an) + id;
+    AnimSlot* sp;
+
+    if (! anim_valid(an, id))
+        return;
+    sp = SLOTS(an) + ID_SLOT(id);
     if (animState == ANIM_FREE) {
-        if (it->state != ANIM_FREE)
-            anim_release(an, it);
-    } else
-        it->state = animState;
+        anim_release(an, ID_SLOT(id));
+    } else {
+        sp->state = animState;
+        if (sp->animType == ANIM_LINEAR_F2)
+            LIN_RATE(an)[sp->index] = (animState == ANIM_PLAYING) ? 1.0f : 0.0f;
+    }
 }
 
+/*
+ * Return the current value of an animation.  If the animation has been
+ * released then the final value of its slot is returned.
+ */
 int anim_valueI(const Animator* an, AnimId id)
 {
-    return BANK(an)[id].var.i.current;
+    const AnimSlot* sp = SLOTS(an) + ID_SLOT(id);
+    if (! anim_valid(an, id))
+        return (ID_SLOT(id) < an->avail) ? sp->last.i : 0;
+    return CYCLES(an)[sp->index].current;
 }
 
 float* anim_valueF2(const Animator* an, AnimId id)
 {
-    return BANK(an)[id].var.f2.current;
+    static float none[2];
+    AnimSlot* sp = SLOTS(an) + ID_SLOT(id);
+    if (! anim_valid(an, id))
+        return (ID_SLOT(id) < an->avail) ? sp->last.f2 : none;
+    return LIN_CUR(an) + sp->index * 2;
 }
@@ -11,15 +11,20 @@ enum AnimState {
 
 #define ANIM_FOREVER    0xffff
 
-typedef uint16_t AnimId;
-#define ANIM_UNUSED     0xffff
+// The low 16 bits of an AnimId are the slot index and the high 16 bits are
+// a generation count which is incremented each time the slot is released.
+typedef uint32_t AnimId;
+#define ANIM_UNUSED     0xffffffff
 
 typedef struct {
-    void* bank;
+    void* slots;
+    void* cycles;           // AnimCycle array.
+    float* linear;          // Arrays of ANIM_LINEAR_F2 components.
     void (*finish)(void*, uint32_t);
     void* finishData;
     uint32_t avail;
-    uint32_t used;
+    uint32_t cycleCount;
+    uint32_t linearCount;
     uint32_t firstFree;
 }
 Animator;
@@ -38,6 +43,7 @@ AnimId anim_startCycleRandomI(Animator* an, float dur, int loops, uint32_t fid,
 AnimId anim_startLinearF2(Animator* an, float dur, uint32_t fid,
                           float* start, float* end);
 void   anim_setState(Animator*, AnimId, int animState);
+int    anim_valid(const Animator*, AnimId);
 int    anim_valueI(const Animator*, AnimId);
 float* anim_valueF2(const Animator*, AnimId);
 
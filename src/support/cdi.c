@@ -169,3 +169,74 @@ const CDIEntry* cdi_findFormat(const CDIEntry* toc, size_t count, uint32_t cdi)
     }
     return NULL;
 }
+
+/*
+  The appId is compared as big endian so that the sort order is the same
+  on all architectures.
+*/
+#ifdef __BIG_ENDIAN__
+#define APPID_KEY(id)   (id)
+#else
+#define APPID_KEY(id)   bswap_32(id)
+#endif
+
+static int cdi_compareEntry(const void* a, const void* b)
+{
+    const CDIEntry* ea = (const CDIEntry*) a;
+    const CDIEntry* eb = (const CDIEntry*) b;
+    uint32_t ka = APPID_KEY(ea->appId);
+    uint32_t kb = APPID_KEY(eb->appId);
+    if (ka != kb)
+        return (ka < kb) ? -1 : 1;
+    // Keep entries with the same appId in file order.
+    if (ea->offset != eb->offset)
+        return (ea->offset < eb->offset) ? -1 : 1;
+    return 0;
+}
+
+/*
+  Sort a Table of Contents by appId so that cdi_searchAppId() can be used.
+*/
+void cdi_sortTOC(CDIEntry* toc, size_t count)
+{
+    qsort(toc, count, sizeof(CDIEntry), cdi_compareEntry);
+}
+
+/*
+  \return Non-zero if the table is sorted by appId.
+*/
+int cdi_isSortedTOC(const CDIEntry* toc, size_t count)
+{
+    const CDIEntry* end = toc + count;
+    if (count > 1) {
+        for (++toc; toc != end; ++toc) {
+            if (APPID_KEY(toc[-1].appId) > APPID_KEY(toc->appId))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+  Binary search version of cdi_findAppId() for a table sorted with
+  cdi_sortTOC().
+*/
+const CDIEntry* cdi_searchAppId(const CDIEntry* toc, size_t count, uint32_t id)
+{
+    uint32_t key = APPID_KEY(id);
+    size_t lo = 0;
+    size_t hi = count;
+    size_t mid;
+
+    // Find the first entry not less than key.
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (APPID_KEY(toc[mid].appId) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < count && toc[lo].appId == id)
+        return toc + lo;
+    return NULL;
+}
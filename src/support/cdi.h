@@ -111,6 +111,9 @@ uint8_t*        cdi_loadPakChunk(FILE* fp, const CDIEntry* ent);
 CDIEntry*       cdi_loadPakTOC(FILE* fp, const CDIEntry* header);
 const CDIEntry* cdi_findAppId(const CDIEntry* toc, size_t count, uint32_t id);
 const CDIEntry* cdi_findFormat(const CDIEntry* toc, size_t count, uint32_t cdi);
+const CDIEntry* cdi_searchAppId(const CDIEntry* toc, size_t count, uint32_t id);
+void            cdi_sortTOC(CDIEntry* toc, size_t count);
+int             cdi_isSortedTOC(const CDIEntry* toc, size_t count);
 CDIStringTable* cdi_initStringTable(CDIStringTable* table, const uint8_t* buf);
 
 void cdi_swap16(uint16_t* vars, size_t count);
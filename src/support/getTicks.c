@@ -40,6 +40,28 @@ uint32_t getTicks()
     return 0;
 }
 
+// Return microseconds elapsed since an arbitrary starting point.
+int64_t usecTicks()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER count;
+    if (! freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (int64_t) (count.QuadPart / freq.QuadPart) * 1000000 +
+           (count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#else
+    struct timeval ts;
+    gettimeofday(&ts, NULL);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_usec;
+#endif
+}
+
 void msecSleep(uint32_t ms)
 {
 #ifdef _WIN32
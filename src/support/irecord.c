@@ -1,5 +1,5 @@
 /*
- * InputRecorder v0.5
+ * InputRecorder v0.7
  * Copyright (C) 2024  Karl Robillard
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
@@ -11,14 +11,29 @@ To replay from inside main loop:
     while ((mkey = irec_recordedKey(rec)))
         myApplication_keyPressed(IREC_KEY(mkey), IREC_MOD(mkey));
     irec_recordTick(rec);
+
+To detect when a replay diverges from the recording, call irec_checksum()
+with a hash of the application state at the same points in both runs.
+
+Keyframes hold application state which allows a replay to jump ahead.
+They are written with irec_recordKeyframe() and must be read back with
+irec_keyframe() at the same point during playback.  Any keyframe can be
+loaded out of order with irec_seekKeyframe().
 */
 
+#include <stdlib.h>
+#include <string.h>
 #include "irecord.h"
 
 void irec_init(InputRecorder* rec)
 {
     rec->fd = -1;
-    rec->mode = 0;
+    rec->mode = IREC_DISABLED;
+    rec->frames = NULL;
+    rec->frameCount = 0;
+    rec->frameData = NULL;
+    rec->frameAlloc = 0;
+    rec->bufPos = rec->bufLen = 0;
 }
 
 #include <fcntl.h>
@@ -27,6 +42,7 @@ void irec_init(InputRecorder* rec)
 #include <io.h>
 #include <sys/stat.h>
 #define close   _close
+#define lseek   _lseek
 #define read    _read
 #define write   _write
 #else
@@ -40,16 +56,19 @@ void irec_init(InputRecorder* rec)
 #endif
 
 #define HDR_SIZE    8
+#define KEY_SIZE    6
+#define SUM_SIZE    10
+#define FRAME_SIZE  18      // Keyframe header; the data follows.
 
-enum RecordMode {
-    MODE_DISABLED,
-    MODE_RECORD,
-    MODE_REPLAY,
-};
+// Buffered records are written at least this often (in clock ticks) so
+// that little is lost if the program crashes.
+#define FLUSH_TICKS 600
 
 enum RecordCommand {
     RECORD_NOP,
     RECORD_KEY,
+    RECORD_SUM,
+    RECORD_FRAME,
     RECORD_END = 0xff
 };
 
@@ -59,19 +78,115 @@ typedef struct {
     uint16_t delay;
 } RecordKey;
 
+typedef struct {
+    uint8_t op, pad;
+    uint8_t turn[4];
+    uint8_t sum[4];
+} RecordSum;
+
+typedef struct {
+    uint8_t op, pad;
+    uint8_t turn[4];
+    uint8_t clock[4];
+    uint8_t last[4];
+    uint8_t size[4];
+} RecordFrame;
+
+static uint32_t irec_unpack32(const uint8_t* bp)
+{
+    return bp[0] | (bp[1] << 8) | (bp[2] << 16) | ((uint32_t) bp[3] << 24);
+}
+
+static void irec_pack32(uint8_t* bp, uint32_t n)
+{
+    bp[0] = n;
+    bp[1] = n >> 8;
+    bp[2] = n >> 16;
+    bp[3] = n >> 24;
+}
+
+static void irec_writeBuf(InputRecorder* rec, const void* data, uint32_t len)
+{
+    if (rec->bufPos + len > IREC_BUF_SIZE)
+        irec_flush(rec);
+    memcpy(rec->buf + rec->bufPos, data, len);
+    rec->bufPos += len;
+}
+
+/*
+ * Ensure that at least len bytes are available in the read buffer.
+ * Return non-zero if successful.
+ */
+static int irec_fill(InputRecorder* rec, uint32_t len)
+{
+    uint32_t avail = rec->bufLen - rec->bufPos;
+    int n;
+
+    if (avail >= len)
+        return 1;
+    if (avail)
+        memmove(rec->buf, rec->buf + rec->bufPos, avail);
+    rec->bufPos = 0;
+    rec->bufLen = avail;
+    do {
+        n = read(rec->fd, rec->buf + rec->bufLen, IREC_BUF_SIZE - rec->bufLen);
+        if (n <= 0)
+            return 0;
+        rec->bufLen += n;
+    } while (rec->bufLen < len);
+    return 1;
+}
+
+/*
+ * Read len bytes from the file (through the buffer) into dst.
+ */
+static int irec_readData(InputRecorder* rec, uint8_t* dst, uint32_t len)
+{
+    uint32_t avail = rec->bufLen - rec->bufPos;
+    int n;
+
+    if (avail > len)
+        avail = len;
+    memcpy(dst, rec->buf + rec->bufPos, avail);
+    rec->bufPos += avail;
+    dst += avail;
+    len -= avail;
+
+    while (len) {
+        n = read(rec->fd, dst, len);
+        if (n <= 0)
+            return 0;
+        dst += n;
+        len -= n;
+    }
+    return 1;
+}
+
+static void irec_freeIndex(InputRecorder* rec)
+{
+    free(rec->frames);
+    rec->frames = NULL;
+    rec->frameCount = 0;
+    free(rec->frameData);
+    rec->frameData = NULL;
+    rec->frameAlloc = 0;
+}
+
 bool irec_beginRecording(InputRecorder* rec, const char* file, uint32_t seed)
 {
     uint32_t head[2];
 
-    rec->clock = rec->last = 0;
-    rec->mode = MODE_DISABLED;
+    rec->clock = rec->last = rec->lastFlush = 0;
+    rec->mode = IREC_DISABLED;
+    rec->bufPos = rec->bufLen = 0;
 
     if (rec->fd >= 0)
         close(rec->fd);
 #ifdef _WIN32
-    rec->fd = _open(file, _O_WRONLY | _O_CREAT, _S_IWRITE);
+    rec->fd = _open(file, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                    _S_IWRITE);
 #else
-    rec->fd = open(file, O_WRONLY | O_CREAT,
+    rec->fd = open(file, O_WRONLY | O_CREAT | O_TRUNC,
                     S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 #endif
     if (rec->fd < 0)
@@ -81,23 +196,40 @@ bool irec_beginRecording(InputRecorder* rec, const char* file, uint32_t seed)
     head[1] = seed;
     if (write(rec->fd, head, HDR_SIZE) != HDR_SIZE)
         return false;
-    rec->mode = MODE_RECORD;
+    rec->mode = IREC_RECORD;
     return true;
 }
 
+/**
+ * Write any buffered records to the recording file.
+ */
+void irec_flush(InputRecorder* rec)
+{
+    if (rec->mode == IREC_RECORD) {
+        if (rec->bufPos) {
+            write(rec->fd, rec->buf, rec->bufPos);
+            rec->bufPos = 0;
+        }
+        rec->lastFlush = rec->clock;
+    }
+}
+
 /**
  * Stop either recording or playback.
  */
 void irec_endRecording(InputRecorder* rec) {
     if (rec->fd >= 0) {
-        if (rec->mode == MODE_RECORD) {
-            char op = RECORD_END;
-            write(rec->fd, &op, 1);
+        if (rec->mode == IREC_RECORD) {
+            uint8_t op = RECORD_END;
+            irec_writeBuf(rec, &op, 1);
+            irec_flush(rec);
         }
         close(rec->fd);
         rec->fd = -1;
-        rec->mode = MODE_DISABLED;
+        rec->mode = IREC_DISABLED;
+        rec->bufPos = rec->bufLen = 0;
     }
+    irec_freeIndex(rec);
 }
 
 //void irec_recordMouse(InputRecorder*, int16_t x, int16_t y, uint8_t button)
@@ -107,7 +239,7 @@ void irec_endRecording(InputRecorder* rec) {
  * \param mod   Modifier flags
  */
 void irec_recordKey(InputRecorder* rec, uint16_t key, uint8_t mod) {
-    if (rec->mode == MODE_RECORD) {
+    if (rec->mode == IREC_RECORD) {
         RecordKey event;
         event.op    = RECORD_KEY;
         event.mod   = mod;
@@ -115,8 +247,70 @@ void irec_recordKey(InputRecorder* rec, uint16_t key, uint8_t mod) {
         event.delay = rec->clock - rec->last;
 
         rec->last = rec->clock;
-        write(rec->fd, &event, 6);
+        irec_writeBuf(rec, &event, KEY_SIZE);
+    }
+}
+
+/**
+ * Advance the clock by one tick.  When recording, buffered records are
+ * written once FLUSH_TICKS have passed since the last write.
+ */
+void irec_recordTick(InputRecorder* rec) {
+    ++rec->clock;
+    if (rec->mode == IREC_RECORD && rec->clock - rec->lastFlush >= FLUSH_TICKS)
+        irec_flush(rec);
+}
+
+/*
+ * Read a checksum record into the sumTurn & sumValue members.
+ */
+static int irec_readSum(InputRecorder* rec)
+{
+    const RecordSum* rs;
+    if (! irec_fill(rec, SUM_SIZE))
+        return 0;
+    rs = (const RecordSum*) (rec->buf + rec->bufPos);
+    rec->sumTurn  = irec_unpack32(rs->turn);
+    rec->sumValue = irec_unpack32(rs->sum);
+    rec->sumHeld  = 1;
+    rec->bufPos += SUM_SIZE;
+    return 1;
+}
+
+/*
+ * Read a keyframe record into frameData.
+ * If setClock is non-zero then the playback clock is set to that of the
+ * keyframe.
+ *
+ * Return pointer to keyframe data or NULL if the read failed.
+ */
+static const uint8_t* irec_readFrame(InputRecorder* rec, uint32_t* size,
+                                     int setClock)
+{
+    const RecordFrame* rf;
+    uint32_t len;
+
+    if (! irec_fill(rec, FRAME_SIZE))
+        return NULL;
+    rf = (const RecordFrame*) (rec->buf + rec->bufPos);
+    len = irec_unpack32(rf->size);
+    if (setClock) {
+        rec->clock = irec_unpack32(rf->clock);
+        rec->last  = irec_unpack32(rf->last);
     }
+    rec->bufPos += FRAME_SIZE;
+
+    if (len > rec->frameAlloc) {
+        uint8_t* mem = (uint8_t*) realloc(rec->frameData, len);
+        if (! mem)
+            return NULL;
+        rec->frameData = mem;
+        rec->frameAlloc = len;
+    }
+    if (! irec_readData(rec, rec->frameData, len))
+        return NULL;
+    *size = len;
+    return rec->frameData;
 }
 
 /**
@@ -130,28 +324,131 @@ void irec_recordKey(InputRecorder* rec, uint16_t key, uint8_t mod) {
  */
 uint32_t irec_recordedKey(InputRecorder* rec) {
     uint32_t key = 0;
-    if (rec->mode == MODE_REPLAY) {
+    uint32_t len;
+    if (rec->mode == IREC_REPLAY) {
         if (rec->replayKey) {
             if (rec->clock >= rec->last) {
                 key = rec->replayKey;
                 rec->replayKey = 0;
             }
         } else {
-            RecordKey event;
-            if (read(rec->fd, &event, 6) == 6 && (event.op == RECORD_KEY)) {
-                uint32_t fkey = ((uint32_t) event.mod << 16) | event.key;
-                if (event.delay)
+next:
+            if (! irec_fill(rec, 1))
+                goto end;
+            switch (rec->buf[rec->bufPos]) {
+            case RECORD_KEY:
+            {
+                RecordKey event;
+                uint32_t fkey;
+                if (! irec_fill(rec, KEY_SIZE))
+                    goto end;
+                memcpy(&event, rec->buf + rec->bufPos, KEY_SIZE);
+                rec->bufPos += KEY_SIZE;
+
+                // Delays are relative to the previous key, which may have
+                // been due before this record was read.
+                fkey = ((uint32_t) event.mod << 16) | event.key;
+                rec->last += event.delay;
+                if (rec->last > rec->clock)
                     rec->replayKey = fkey;
                 else
                     key = fkey;
-                rec->last = rec->clock + event.delay;
-            } else {
-                irec_endRecording(rec);
+            }
+                break;
+
+            case RECORD_SUM:
+                if (rec->sumHeld) {
+                    // The application did not reach the held turn before
+                    // the next one was recorded.
+                    rec->sumFailed = 1;
+                    if (! irec_fill(rec, SUM_SIZE))
+                        goto end;
+                    rec->bufPos += SUM_SIZE;
+                } else if (! irec_readSum(rec))
+                    goto end;
+                goto next;
+
+            case RECORD_FRAME:
+                // A keyframe follows the checksum of its turn.  If that
+                // turn has not ended yet, stop here so irec_keyframe() can
+                // read it when it does.
+                if (rec->sumHeld && ! rec->sumFailed)
+                    break;
+                // The application did not read the keyframe at its turn.
+                rec->sumFailed = 1;
+                if (! irec_readFrame(rec, &len, 0))
+                    goto end;
+                goto next;
+
+            default:
+                goto end;
             }
         }
     }
-
     return key;
+
+end:
+    irec_endRecording(rec);
+    return 0;
+}
+
+/*
+ * Build the index of keyframe positions and rewind to the first record.
+ */
+static void irec_indexFrames(InputRecorder* rec)
+{
+    uint32_t pos = HDR_SIZE;    // File position of buf[bufPos].
+    uint32_t avail = 0;
+    uint32_t len;
+
+    for (;;) {
+        if (! irec_fill(rec, 1))
+            break;
+        switch (rec->buf[rec->bufPos]) {
+        case RECORD_KEY:
+            len = KEY_SIZE;
+            break;
+        case RECORD_SUM:
+            len = SUM_SIZE;
+            break;
+        case RECORD_FRAME:
+        {
+            const RecordFrame* rf;
+            if (! irec_fill(rec, FRAME_SIZE))
+                goto done;
+            rf = (const RecordFrame*) (rec->buf + rec->bufPos);
+            len = FRAME_SIZE + irec_unpack32(rf->size);
+
+            if (rec->frameCount == avail) {
+                IRecKeyframe* mem;
+                avail = avail ? avail * 2 : 64;
+                mem = (IRecKeyframe*) realloc(rec->frames,
+                                              avail * sizeof(IRecKeyframe));
+                if (! mem)
+                    goto done;
+                rec->frames = mem;
+            }
+            rec->frames[rec->frameCount].turn = irec_unpack32(rf->turn);
+            rec->frames[rec->frameCount].offset = pos;
+            ++rec->frameCount;
+        }
+            break;
+        default:
+            goto done;
+        }
+
+        pos += len;
+        if (rec->bufLen - rec->bufPos >= len) {
+            rec->bufPos += len;
+        } else {
+            lseek(rec->fd, pos, SEEK_SET);
+            rec->bufPos = rec->bufLen = 0;
+        }
+    }
+
+done:
+    lseek(rec->fd, HDR_SIZE, SEEK_SET);
+    rec->bufPos = rec->bufLen = 0;
 }
 
 /**
@@ -163,13 +460,16 @@ uint32_t irec_replay(InputRecorder* rec, const char* file) {
     uint32_t head[2];
 
     rec->clock = rec->last = 0;
-    rec->mode = MODE_DISABLED;
+    rec->mode = IREC_DISABLED;
     rec->replayKey = 0;
+    rec->sumHeld = rec->sumFailed = 0;
+    rec->bufPos = rec->bufLen = 0;
+    irec_freeIndex(rec);
 
     if (rec->fd >= 0)
         close(rec->fd);
 #ifdef _WIN32
-    rec->fd = _open(file, _O_RDONLY);
+    rec->fd = _open(file, _O_RDONLY | _O_BINARY);
 #else
     rec->fd = open(file, O_RDONLY);
 #endif
@@ -178,6 +478,119 @@ uint32_t irec_replay(InputRecorder* rec, const char* file) {
     if (read(rec->fd, head, HDR_SIZE) != HDR_SIZE || head[0] != RECORD_CDI)
         return 0;
 
-    rec->mode = MODE_REPLAY;
+    irec_indexFrames(rec);
+    rec->mode = IREC_REPLAY;
     return head[1];
 }
+
+/**
+ * Record or verify a checksum of the application state.
+ *
+ * When recording, the checksum is saved.  During playback it is compared
+ * with the recorded value for the same turn.  Turns which were not checked
+ * while recording are ignored.
+ *
+ * \param turn  Application defined counter which increases between calls.
+ * \param sum   Hash of the application state.
+ *
+ * \return False if the playback state differs from the recording.  The
+ *         sumTurn & sumValue members then hold the recorded checksum.
+ */
+bool irec_checksum(InputRecorder* rec, uint32_t turn, uint32_t sum)
+{
+    if (rec->mode == IREC_RECORD) {
+        RecordSum rs;
+        rs.op  = RECORD_SUM;
+        rs.pad = 0;
+        irec_pack32(rs.turn, turn);
+        irec_pack32(rs.sum, sum);
+        irec_writeBuf(rec, &rs, SUM_SIZE);
+    } else if (rec->mode == IREC_REPLAY) {
+        if (rec->sumFailed)
+            return false;
+        if (! rec->sumHeld && ! rec->replayKey &&
+            irec_fill(rec, 1) && rec->buf[rec->bufPos] == RECORD_SUM)
+            irec_readSum(rec);
+        if (rec->sumHeld) {
+            if (rec->sumTurn == turn) {
+                rec->sumHeld = 0;
+                if (rec->sumValue != sum)
+                    rec->sumFailed = 1;
+            } else if (rec->sumTurn < turn) {
+                rec->sumFailed = 1;     // Recorded turn was skipped.
+            }
+        }
+        return ! rec->sumFailed;
+    }
+    return true;
+}
+
+/**
+ * Save a keyframe of application state.  Any buffered records are written
+ * to the file along with the keyframe.
+ *
+ * \param turn  Application defined counter which increases between calls.
+ * \param data  Application state.
+ * \param size  Byte size of data.
+ */
+void irec_recordKeyframe(InputRecorder* rec, uint32_t turn,
+                         const void* data, uint32_t size)
+{
+    if (rec->mode == IREC_RECORD) {
+        RecordFrame rf;
+        rf.op  = RECORD_FRAME;
+        rf.pad = 0;
+        irec_pack32(rf.turn, turn);
+        irec_pack32(rf.clock, rec->clock);
+        irec_pack32(rf.last, rec->last);
+        irec_pack32(rf.size, size);
+        irec_writeBuf(rec, &rf, FRAME_SIZE);
+        irec_flush(rec);
+        write(rec->fd, data, size);
+    }
+}
+
+/**
+ * Read the keyframe recorded for a turn during playback.
+ *
+ * \param turn  Application defined counter passed to irec_recordKeyframe().
+ * \param size  Set to the byte size of the returned data.
+ *
+ * \return Pointer to keyframe data or NULL if the next record is not a
+ *         keyframe for the given turn.  The data is valid until the next
+ *         keyframe is read.
+ */
+const uint8_t* irec_keyframe(InputRecorder* rec, uint32_t turn, uint32_t* size)
+{
+    if (rec->mode == IREC_REPLAY && ! rec->replayKey &&
+        irec_fill(rec, FRAME_SIZE) &&
+        rec->buf[rec->bufPos] == RECORD_FRAME) {
+        const RecordFrame* rf = (const RecordFrame*) (rec->buf + rec->bufPos);
+        if (irec_unpack32(rf->turn) == turn)
+            return irec_readFrame(rec, size, 0);
+    }
+    return NULL;
+}
+
+/**
+ * Continue playback from a keyframe.  The playback clock is set to the
+ * time the keyframe was recorded.
+ *
+ * \param index  Index into the frames array.
+ * \param size   Set to the byte size of the returned data.
+ *
+ * \return Pointer to keyframe data or NULL if the seek failed.  The data
+ *         is valid until the next keyframe is read.
+ */
+const uint8_t* irec_seekKeyframe(InputRecorder* rec, uint32_t index,
+                                 uint32_t* size)
+{
+    if (rec->mode != IREC_REPLAY || index >= rec->frameCount)
+        return NULL;
+    if (lseek(rec->fd, rec->frames[index].offset, SEEK_SET) < 0)
+        return NULL;
+    rec->bufPos = rec->bufLen = 0;
+    rec->replayKey = 0;
+    rec->sumHeld = rec->sumFailed = 0;
+    return irec_readFrame(rec, size, 1);
+}
@@ -1,5 +1,5 @@
 /*
- * InputRecorder v0.5
+ * InputRecorder v0.7
  * Copyright (C) 2024  Karl Robillard
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
@@ -10,12 +10,37 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define IREC_BUF_SIZE   4096
+
+enum IRecMode {
+    IREC_DISABLED,
+    IREC_RECORD,
+    IREC_REPLAY
+};
+
+typedef struct {
+    uint32_t turn;
+    uint32_t offset;        // File position of the keyframe record.
+} IRecKeyframe;
+
 struct InputRecorder {
     int fd;
     int mode;
     uint32_t replayKey;
     uint32_t clock;
     uint32_t last;
+    uint32_t lastFlush;
+    uint32_t sumTurn;       // Recorded checksum waiting to be verified.
+    uint32_t sumValue;
+    uint16_t sumHeld;
+    uint16_t sumFailed;
+    IRecKeyframe* frames;   // Keyframe index (replay only).
+    uint32_t frameCount;
+    uint8_t* frameData;
+    uint32_t frameAlloc;
+    uint32_t bufPos;
+    uint32_t bufLen;
+    uint8_t buf[IREC_BUF_SIZE];
 };
 
 typedef struct InputRecorder InputRecorder;
@@ -23,11 +48,19 @@ typedef struct InputRecorder InputRecorder;
 void     irec_init(InputRecorder*);
 bool     irec_beginRecording(InputRecorder*, const char* file, uint32_t seed);
 void     irec_endRecording(InputRecorder*);
+void     irec_flush(InputRecorder*);
 void     irec_recordKey(InputRecorder*, uint16_t key, uint8_t mod);
+void     irec_recordTick(InputRecorder*);
 uint32_t irec_recordedKey(InputRecorder*);
 uint32_t irec_replay(InputRecorder*, const char* file);
+bool     irec_checksum(InputRecorder*, uint32_t turn, uint32_t sum);
+void     irec_recordKeyframe(InputRecorder*, uint32_t turn,
+                             const void* data, uint32_t size);
+const uint8_t* irec_keyframe(InputRecorder*, uint32_t turn, uint32_t* size);
+const uint8_t* irec_seekKeyframe(InputRecorder*, uint32_t index,
+                                 uint32_t* size);
 
-#define irec_recordTick(rec)    ++(rec)->clock
+#define irec_mode(rec)          (rec)->mode
 
 #define IREC_KEY(rkey)  (rkey & 0xffff)
 #define IREC_MOD(rkey)  (rkey >> 16)
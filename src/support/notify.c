@@ -5,7 +5,9 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "notify.h"
+#include "threads.h"
 
 struct NotifyListener {
     NotifyHandler func;
@@ -13,11 +15,24 @@ struct NotifyListener {
     uint32_t mask;
 };
 
+struct NotifyPost {
+    uint32_t seq;
+    uint16_t sender;
+    uint16_t size;
+    union {
+        void* ptr;
+        double f64;
+        uint8_t bytes[NOTIFY_POST_SIZE];
+    } data;
+};
+
 void notify_init(NotifyBus* bus, int listenerLimit)
 {
     bus->list  = calloc(listenerLimit, sizeof(struct NotifyListener));
     bus->avail = bus->list ? listenerLimit : 0;
     bus->used  = 0;
+    bus->posts = NULL;
+    bus->postMask = bus->postHead = bus->postTail = 0;
 }
 
 void notify_free(NotifyBus* bus)
@@ -27,6 +42,10 @@ void notify_free(NotifyBus* bus)
         bus->list = NULL;
     }
     bus->avail = bus->used = 0;
+
+    free(bus->posts);
+    bus->posts = NULL;
+    bus->postMask = bus->postHead = bus->postTail = 0;
 }
 
 /*
@@ -94,3 +113,108 @@ void notify_emit(const NotifyBus* bus, int senderId, void* message)
             it->func(senderId, message, it->user);
     }
 }
+
+/*
+  Allocate the ring which holds messages from notify_post().
+  This must be called before any threads post messages.
+
+  \param postLimit  Maximum number of messages waiting to be dispatched.
+                    This is rounded up to a power of two.
+
+  \return Non-zero if successful.
+*/
+int notify_initPosts(NotifyBus* bus, int postLimit)
+{
+    uint32_t i, count = 2;
+    while (count < (uint32_t) postLimit)
+        count <<= 1;
+
+    free(bus->posts);
+    bus->posts = malloc(count * sizeof(struct NotifyPost));
+    if (! bus->posts) {
+        bus->postMask = 0;
+        return 0;
+    }
+    for (i = 0; i < count; ++i)
+        bus->posts[i].seq = i;
+    bus->postMask = count - 1;
+    bus->postHead = bus->postTail = 0;
+    return 1;
+}
+
+/*
+  Queue a message to be emitted by notify_dispatchPosts().
+
+  This can be called from any thread.  It does not lock or allocate memory.
+  The message is copied, so listeners of posted messages receive a pointer
+  to a copy which is only valid during the callback.
+
+  \param senderId   User defined identifier from 0-31.
+  \param message    Message data.
+  \param size       Byte size of message (NOTIFY_POST_SIZE maximum).
+
+  \return Non-zero if successful or zero if the ring is full.
+*/
+int notify_post(NotifyBus* bus, int senderId, const void* message, int size)
+{
+    struct NotifyPost* slot;
+    uint32_t pos;
+    int32_t diff;
+
+    if (! bus->posts || size > NOTIFY_POST_SIZE)
+        return 0;
+
+    // Claim a slot (multiple producers).
+    pos = atomicLoad(&bus->postHead);
+    for (;;) {
+        slot = bus->posts + (pos & bus->postMask);
+        diff = (int32_t) (atomicLoad(&slot->seq) - pos);
+        if (diff == 0) {
+            if (atomicCAS(&bus->postHead, pos, pos + 1))
+                break;
+            pos = atomicLoad(&bus->postHead);
+        } else if (diff < 0)
+            return 0;       // Full.
+        else
+            pos = atomicLoad(&bus->postHead);
+    }
+
+    slot->sender = senderId;
+    slot->size = size;
+    memcpy(slot->data.bytes, message, size);
+    atomicStore(&slot->seq, pos + 1);     // Publish to the consumer.
+    return 1;
+}
+
+/*
+  Emit any posted messages to the listeners.  This must only be called from
+  one thread (the one which also calls notify_emit).  Messages posted by
+  listener callbacks are held until the next call.
+
+  \return Number of messages dispatched.
+*/
+int notify_dispatchPosts(NotifyBus* bus)
+{
+    struct NotifyPost msg;
+    struct NotifyPost* slot;
+    uint32_t tail, end;
+    int count = 0;
+
+    if (! bus->posts)
+        return 0;
+    end = atomicLoad(&bus->postHead);
+
+    for (tail = bus->postTail; tail != end; ++tail) {
+        slot = bus->posts + (tail & bus->postMask);
+        if (atomicLoad(&slot->seq) != tail + 1)
+            break;      // Claimed but not yet written.
+        msg.sender = slot->sender;
+        msg.data = slot->data;
+        atomicStore(&slot->seq, tail + bus->postMask + 1);  // Free the slot.
+        bus->postTail = tail + 1;
+
+        notify_emit(bus, msg.sender, msg.data.bytes);
+        ++count;
+    }
+    return count;
+}
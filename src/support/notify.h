@@ -8,12 +8,19 @@
 
 typedef void (*NotifyHandler)(int sender, void* message, void* user);
 
+#define NOTIFY_POST_SIZE    24      // Maximum bytes of a posted message.
+
 struct NotifyListener;
+struct NotifyPost;
 
 typedef struct {
     struct NotifyListener* list;
     int avail;
     int used;
+    struct NotifyPost* posts;       // Ring of messages posted by any thread.
+    uint32_t postMask;
+    uint32_t postHead;
+    uint32_t postTail;
 }
 NotifyBus;
 
@@ -26,6 +33,9 @@ void notify_free(NotifyBus*);
 int  notify_listen(NotifyBus*, uint32_t senderMask, NotifyHandler, void* user);
 void notify_unplug(NotifyBus*, int listenerId);
 void notify_emit(const NotifyBus*, int senderId, void* message);
+int  notify_initPosts(NotifyBus*, int postLimit);
+int  notify_post(NotifyBus*, int senderId, const void* message, int size);
+int  notify_dispatchPosts(NotifyBus*);
 
 #ifdef __cplusplus
 }
@@ -4,6 +4,7 @@
  *
  * An expandable array of nul terminated static strings.
  * A single block of memory is allocated for both the index and all strings.
+ * An optional open addressing hash index can be enabled for exact lookups.
  */
 
 #include <assert.h>
@@ -13,6 +14,7 @@
 
 #define DEFAULT_AVAIL   8
 #define MIN_STR_LEN     8
+#define MIN_HASH_SIZE   16
 
 static void sst_resize(StringTable* st, int count)
 {
@@ -41,24 +43,74 @@ void sst_init(StringTable* st, int reserve, int averageLen)
 void sst_free(StringTable* st)
 {
     free(st->table);
+    free(st->hash);
     st->table = NULL;
-    st->avail = st->used = 0;
+    st->hash = NULL;
+    st->hashMask = 0;
+    st->avail = st->used = st->storeUsed = 0;
+}
+
+// FNV-1a
+static uint32_t sst_hashString(const char* str, int len)
+{
+    const uint8_t* it  = (const uint8_t*) str;
+    const uint8_t* end = it + len;
+    uint32_t h = 2166136261u;
+    for (; it != end; ++it)
+        h = (h ^ *it) * 16777619u;
+    return h;
+}
+
+static void sst_hashInsert(StringTable* st, uint32_t n)
+{
+    const StringEntry* ent = st->table + n;
+    uint32_t i = sst_hashString(sst_strings(st) + ent->start, ent->len);
+    for (i &= st->hashMask; st->hash[i]; i = (i + 1) & st->hashMask)
+        ;
+    st->hash[i] = n + 1;
+}
+
+static void sst_rehash(StringTable* st, uint32_t size)
+{
+    uint32_t i;
+
+    free(st->hash);
+    st->hash = (uint32_t*) calloc(size, sizeof(uint32_t));
+    assert(st->hash);
+    st->hashMask = size - 1;
+
+    for (i = 0; i < st->used; ++i)
+        sst_hashInsert(st, i);
+}
+
+/*
+ * Add entry N to the hash index (if enabled), keeping the load under 50%.
+ */
+static void sst_hashAdd(StringTable* st, uint32_t n)
+{
+    if (st->hash) {
+        if (st->used * 2 > st->hashMask + 1)
+            sst_rehash(st, (st->hashMask + 1) * 2);
+        else
+            sst_hashInsert(st, n);
+    }
 }
 
 static char* sst_make(StringTable* st, int len)
 {
     StringEntry* ent;
     char* store;
-    int storeAvail = st->avail * st->allocLen;
-    int storeUsedNew;
-
-    storeUsedNew = st->storeUsed + len + 1;
-
-    if (st->avail == 0)
-        sst_resize(st, DEFAULT_AVAIL);
-    else if (st->used == st->avail || storeUsedNew > storeAvail)
-        sst_resize(st, st->avail * 2);
-    assert(storeUsedNew <= storeAvail);
+    uint32_t storeUsedNew = st->storeUsed + len + 1;
+    uint32_t count;
+
+    if (st->used == st->avail || storeUsedNew > st->avail * st->allocLen) {
+        // Grow until both the entry and the characters fit.
+        count = st->avail ? st->avail * 2 : DEFAULT_AVAIL;
+        while (storeUsedNew > count * st->allocLen)
+            count *= 2;
+        sst_resize(st, count);
+    }
+    assert(storeUsedNew <= st->avail * st->allocLen);
 
     ent = st->table + st->used;
     ent->start = st->storeUsed;
@@ -78,6 +130,7 @@ void sst_append(StringTable* st, const char* str, int len)
     char* store = sst_make(st, len);
     if (len)
         memcpy(store, str, len);
+    sst_hashAdd(st, st->used - 1);
 }
 
 /*
@@ -90,10 +143,12 @@ void sst_appendCon(StringTable* st, const char* strA, const char* strB)
     char* store = sst_make(st, lenA + lenB);
     memcpy(store, strA, lenA);
     memcpy(store + lenA, strB, lenB);
+    sst_hashAdd(st, st->used - 1);
 }
 
 /*
- * Return index of string or -1 if not found.
+ * Return index of the first string which begins with pattern or -1 if not
+ * found.  This is a linear search; use sst_lookup() for exact matches.
  */
 int sst_find(const StringTable* st, const char* pattern, int len)
 {
@@ -110,6 +165,66 @@ int sst_find(const StringTable* st, const char* pattern, int len)
     return -1;
 }
 
+/*
+ * Build a hash index of all strings which will be maintained by any further
+ * appends.  This makes sst_lookup() and sst_intern() constant time.
+ */
+void sst_enableHash(StringTable* st)
+{
+    uint32_t size = MIN_HASH_SIZE;
+    while (size < st->used * 2)
+        size *= 2;
+    sst_rehash(st, size);
+}
+
+/*
+ * Return index of string exactly matching str or -1 if not found.
+ */
+int sst_lookup(const StringTable* st, const char* str, int len)
+{
+    const char* store = sst_strings(st);
+    const StringEntry* ent;
+    uint32_t i, n;
+
+    if (len < 0)
+        len = strlen(str);
+
+    if (st->hash) {
+        i = sst_hashString(str, len) & st->hashMask;
+        for (; (n = st->hash[i]); i = (i + 1) & st->hashMask) {
+            ent = st->table + n - 1;
+            if (ent->len == (uint32_t) len &&
+                memcmp(str, store + ent->start, len) == 0)
+                return n - 1;
+        }
+    } else {
+        for (i = 0; i < st->used; ++i) {
+            ent = st->table + i;
+            if (ent->len == (uint32_t) len &&
+                memcmp(str, store + ent->start, len) == 0)
+                return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Return index of string exactly matching str, appending it to the table
+ * if not already present.
+ */
+int sst_intern(StringTable* st, const char* str, int len)
+{
+    int n;
+    if (len < 0)
+        len = strlen(str);
+    n = sst_lookup(st, str, len);
+    if (n < 0) {
+        sst_append(st, str, len);
+        n = st->used - 1;
+    }
+    return n;
+}
+
 const char* sst_stringL(const StringTable* st, int n, int* plen)
 {
     const StringEntry* ent = st->table + n;
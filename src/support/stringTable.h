@@ -6,13 +6,14 @@
  *
  * An expandable array of nul terminated static strings.
  * A single block of memory is allocated for both the index and all strings.
+ * An optional open addressing hash index can be enabled for exact lookups.
  */
 
 #include <stdint.h>
 
 typedef struct {
-    uint16_t start;     // LIMIT: 65k characters total.
-    uint16_t len;
+    uint32_t start;
+    uint32_t len;
 }
 StringEntry;
 
@@ -20,6 +21,8 @@ typedef struct StringTable StringTable;
 
 struct StringTable {
     StringEntry* table;
+    uint32_t* hash;         // Entry index + 1 (zero is empty) or NULL.
+    uint32_t hashMask;
     uint32_t avail;
     uint32_t used;
     uint32_t storeUsed;
@@ -41,6 +44,9 @@ void sst_free(StringTable*);
 void sst_append(StringTable*, const char* str, int len);
 void sst_appendCon(StringTable*, const char* strA, const char* strB);
 int  sst_find(const StringTable*, const char* pattern, int len);
+void sst_enableHash(StringTable*);
+int  sst_lookup(const StringTable*, const char* str, int len);
+int  sst_intern(StringTable*, const char* str, int len);
 const char* sst_stringL(const StringTable*, int n, int* plen);
 
 #ifdef __cplusplus
@@ -0,0 +1,58 @@
+/*
+ * Symbol Index
+ *
+ * A flat table which maps Symbol values (small, dense atom numbers) to the
+ * array index + 1 of the element with that name.  Zero means no element
+ * has the name.
+ *
+ * This file is #included by the users (tileset.cpp, config_boron.cpp &
+ * util/symbench.cpp).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SYMI_FIRST  0   // If a name is used more than once the first is found.
+#define SYMI_LAST   1   // If a name is used more than once the last is found.
+
+/*
+ * Create a table for count elements which are stride bytes apart.
+ * The names argument points to the uint16_t name of the first element.
+ *
+ * Return table allocated with malloc() and set tableSize to its length.
+ * If memory cannot be allocated then NULL is returned, tableSize is set to
+ * zero, and the caller must fall back to searching the elements.
+ */
+static uint16_t* symi_build(const void* names, int count, int stride,
+                            int order, uint32_t* tableSize)
+{
+    const uint8_t* np = (const uint8_t*) names;
+    uint16_t* table;
+    uint32_t size = 0;
+    int i;
+
+#define SYMI_NAME(i)    *((const uint16_t*) (np + (i) * stride))
+
+    for (i = 0; i < count; ++i) {
+        if (SYMI_NAME(i) >= size)
+            size = SYMI_NAME(i) + 1;
+    }
+
+    table = (uint16_t*) calloc(size ? size : 1, sizeof(uint16_t));
+    if (! table) {
+        *tableSize = 0;
+        return NULL;
+    }
+    if (order == SYMI_FIRST) {
+        for (i = count - 1; i >= 0; --i)
+            table[ SYMI_NAME(i) ] = i + 1;
+    } else {
+        for (i = 0; i < count; ++i)
+            table[ SYMI_NAME(i) ] = i + 1;
+    }
+    *tableSize = size;
+    return table;
+}
+
+#define symi_lookup(table, size, sym) \
+    (((uint32_t) (sym) < (size)) ? (table)[sym] : 0)
@@ -0,0 +1,96 @@
+#ifndef THREADS_H
+#define THREADS_H
+/*
+ * threads.h
+ *
+ * Minimal portable wrapper for worker threads & mutexes.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+
+typedef HANDLE Thread;
+#define THREAD_FUNC     unsigned __stdcall
+#define THREAD_RETURN   0
+
+typedef unsigned (__stdcall *ThreadFunc)(void*);
+
+static inline int thread_create(Thread* th, ThreadFunc func, void* arg) {
+    *th = (HANDLE) _beginthreadex(NULL, 0, func, arg, 0, NULL);
+    return *th ? 1 : 0;
+}
+
+static inline void thread_join(Thread th) {
+    WaitForSingleObject(th, INFINITE);
+    CloseHandle(th);
+}
+
+static inline void thread_yield() {
+    SwitchToThread();
+}
+
+static inline void thread_sleep(int msec) {
+    Sleep(msec);
+}
+
+typedef CRITICAL_SECTION Mutex;
+
+static inline void mutex_init(Mutex* mt)   { InitializeCriticalSection(mt); }
+static inline void mutex_free(Mutex* mt)   { DeleteCriticalSection(mt); }
+static inline void mutex_lock(Mutex* mt)   { EnterCriticalSection(mt); }
+static inline void mutex_unlock(Mutex* mt) { LeaveCriticalSection(mt); }
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+typedef pthread_t Thread;
+#define THREAD_FUNC     void*
+#define THREAD_RETURN   NULL
+
+typedef void* (*ThreadFunc)(void*);
+
+static inline int thread_create(Thread* th, ThreadFunc func, void* arg) {
+    return pthread_create(th, NULL, func, arg) == 0;
+}
+
+static inline void thread_join(Thread th) {
+    pthread_join(th, NULL);
+}
+
+static inline void thread_yield() {
+    sched_yield();
+}
+
+static inline void thread_sleep(int msec) {
+    struct timespec ts;
+    ts.tv_sec  = msec / 1000;
+    ts.tv_nsec = (msec % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+}
+
+typedef pthread_mutex_t Mutex;
+
+static inline void mutex_init(Mutex* mt)   { pthread_mutex_init(mt, NULL); }
+static inline void mutex_free(Mutex* mt)   { pthread_mutex_destroy(mt); }
+static inline void mutex_lock(Mutex* mt)   { pthread_mutex_lock(mt); }
+static inline void mutex_unlock(Mutex* mt) { pthread_mutex_unlock(mt); }
+#endif
+
+/*
+ * Atomic access to 32-bit integers shared between threads.
+ * Loads have acquire and stores have release ordering.
+ */
+#ifdef _MSC_VER
+#define atomicLoad(p)       (uint32_t) InterlockedOr((volatile LONG*) (p), 0)
+#define atomicStore(p,v)    InterlockedExchange((volatile LONG*) (p), (LONG) (v))
+#define atomicCAS(p,e,v)    (InterlockedCompareExchange((volatile LONG*) (p), \
+                                (LONG) (v), (LONG) (e)) == (LONG) (e))
+#else
+#define atomicLoad(p)       __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define atomicStore(p,v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define atomicCAS(p,e,v)    __sync_bool_compare_and_swap(p, e, v)
+#endif
+
+#endif // THREADS_H
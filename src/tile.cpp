@@ -246,7 +246,7 @@ int Tile::frameForDirection(Direction d) const {
  *
  * Return AnimId or ANIM_UNUSED if the tile is has no frame animation.
  */
-uint16_t Tile::startFrameAnim() const {
+AnimId Tile::startFrameAnim() const {
     if (frames && anim && anim->transforms[0]->animType == ATYPE_FRAME) {
         int chance = anim->random;
         if (chance == 0)
@@ -5,6 +5,7 @@
 #ifndef TILE_H
 #define TILE_H
 
+#include "anim.h"
 #include "direction.h"
 #include "types.h"
 
@@ -154,7 +155,7 @@ public:
 
     void loadImage();
     void deleteImage();
-    uint16_t startFrameAnim() const;
+    AnimId startFrameAnim() const;
 
     TileId id;          /**< an id that is unique across all tilesets */
     Symbol name;        /**< The name of this tile */
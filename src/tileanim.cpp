@@ -137,7 +137,7 @@ static bool drawsTile(const TileAnimTransform* tf)
 
 void TileAnim::draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direction dir)
 {
-    if (mapTile.freezeAnimation || (random && xu4_random(100) > random)) {
+    if (mapTile.freezeAnimation || (random && xu4_randomFx(100) > random)) {
         // Nothing to do; draw the tile and return!
         tile->getImage()->drawSubRectOn(dest, 0, 0, 0,
                 mapTile.frame * tile->getHeight(),
@@ -158,7 +158,7 @@ void TileAnim::draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direc
                 continue;
         }
 
-        if (! trans->random || xu4_random(100) < trans->random) {
+        if (! trans->random || xu4_randomFx(100) < trans->random) {
             if (! drawsTile(trans) && ! drawn) {
                 tile->getImage()->drawSubRectOn(dest, 0, 0, 0,
                         mapTile.frame * tile->getHeight(),
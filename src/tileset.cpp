@@ -9,6 +9,7 @@
 #include "imagemgr.h"
 #include "tileanim.h"
 #include "xu4.h"
+#include "support/symbolIndex.c"
 
 /**
  * Loads all tileset images.
@@ -98,7 +99,7 @@ const Tile* Tileset::findTileById(TileId id) {
     return xu4.config->tileset()->get(id);
 }
 
-Tileset::Tileset(int count) : tileCount(0) {
+Tileset::Tileset(int count) : tileCount(0), nameIndex(NULL), nameIndexSize(0) {
     tiles  = new Tile[count];
     render = new TileRenderData[count];
     memset(tiles, 0, sizeof(Tile) * count);
@@ -107,6 +108,18 @@ Tileset::Tileset(int count) : tileCount(0) {
 Tileset::~Tileset() {
     delete[] tiles;
     delete[] render;
+    free(nameIndex);
+}
+
+/**
+ * Build the name lookup table used by getByName().  This must be called
+ * after all tiles have been added.  If a name is used more than once the
+ * last tile with it is found.
+ */
+void Tileset::indexNames() {
+    free(nameIndex);
+    nameIndex = symi_build(&tiles->name, tileCount, sizeof(Tile), SYMI_LAST,
+                           &nameIndexSize);
 }
 
 /**
@@ -122,8 +135,16 @@ const Tile* Tileset::get(TileId id) const {
  * Returns the tile with the given name from the tileset, if it exists
  */
 const Tile* Tileset::getByName(Symbol name) const {
-    TileNameMap::const_iterator it = nameMap.find(name);
-    if (it != nameMap.end())
-        return it->second;
+    if (! nameIndex) {
+        // The index could not be allocated; the last tile wins.
+        for (uint32_t i = tileCount; i > 0; --i) {
+            if (tiles[i - 1].name == name)
+                return tiles + i - 1;
+        }
+        return NULL;
+    }
+    TileId n = symi_lookup(nameIndex, nameIndexSize, name);
+    if (n)
+        return tiles + n - 1;
     return NULL;
 }
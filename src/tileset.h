@@ -5,7 +5,6 @@
 #ifndef TILESET_H
 #define TILESET_H
 
-#include <map>
 #include "tile.h"
 
 /**
@@ -13,8 +12,6 @@
  */
 class Tileset {
 public:
-    typedef std::map<Symbol, const Tile*> TileNameMap;
-
     static void loadImages();
     static void unloadImages();
     static const Tile* findTileByName(Symbol name);
@@ -25,11 +22,13 @@ public:
 
     const Tile* get(TileId id) const;
     const Tile* getByName(Symbol name) const;
+    void indexNames();
 
     Tile* tiles;
     TileRenderData* render;
     uint32_t tileCount;
-    TileNameMap nameMap;
+    TileId* nameIndex;      // Symbol to TileId + 1 (0 is no tile).
+    uint32_t nameIndexSize;
 };
 
 #endif
@@ -181,6 +181,16 @@ void TileView::drawFocus(int x, int y) {
 }
 
 #ifdef GPU_RENDER
+/*
+ * Set the number of map tiles visible across the view.
+ * Pass zero to show one tile per column (the normal view).
+ */
+void TileView::setZoom(float tilesAcross) {
+    if (tilesAcross <= 0.0f)
+        tilesAcross = float(columns);
+    scale = 2.0f / tilesAcross;
+}
+
 static void stopEffectAnim(VisualEffect* it) {
     if (it->anim != ANIM_UNUSED) {
         Animator* asys;
@@ -59,6 +59,7 @@ public:
     VisualEffect* useEffect(int id, TileId tile, float x, float y);
     void removeEffect(int id);
     void updateEffects(float cx, float cy, const float* uvTable);
+    void setZoom(float tilesAcross);
 
     int* scissor;
     float aspect;
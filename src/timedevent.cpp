@@ -0,0 +1,182 @@
+/*
+ * timedevent.cpp
+ *
+ * This is #included by event.cpp and util/timerbench.cpp.
+ */
+
+#include <stdlib.h>
+#include "timedevent.h"
+
+TimedEventMgr::TimedEventMgr() :
+    pool(NULL),
+    heap(NULL),
+    used(0),
+    avail(0),
+    freeSlot(-1),
+    now(0),
+    addCount(0)
+{}
+
+TimedEventMgr::~TimedEventMgr() {
+    free(pool);
+    free(heap);
+}
+
+/*
+ * Return true if pool element a is due before b.
+ */
+bool TimedEventMgr::before(int a, int b) const {
+    const TimedEvent* ea = pool + a;
+    const TimedEvent* eb = pool + b;
+    if (ea->due != eb->due)
+        return int32_t(ea->due - eb->due) < 0;
+    return int32_t(ea->order - eb->order) < 0;
+}
+
+void TimedEventMgr::siftUp(int pos) {
+    int id = heap[pos];
+    int parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (! before(id, heap[parent]))
+            break;
+        heap[pos] = heap[parent];
+        pool[heap[pos]].heapPos = pos;
+        pos = parent;
+    }
+    heap[pos] = id;
+    pool[id].heapPos = pos;
+}
+
+void TimedEventMgr::siftDown(int pos) {
+    int id = heap[pos];
+    int child;
+
+    while ((child = 2 * pos + 1) < used) {
+        if (child + 1 < used && before(heap[child + 1], heap[child]))
+            ++child;
+        if (! before(heap[child], id))
+            break;
+        heap[pos] = heap[child];
+        pool[heap[pos]].heapPos = pos;
+        pos = child;
+    }
+    heap[pos] = id;
+    pool[id].heapPos = pos;
+}
+
+/**
+ * Adds a timed event to the event queue.
+ * The callback is first run after interval ticks.
+ *
+ * \return Event id for use with remove(), or -1 if memory is exhausted.
+ */
+int TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
+    TimedEvent* ev;
+    int id;
+
+    if (freeSlot < 0) {
+        int n = avail ? avail * 2 : 16;
+        TimedEvent* npool = (TimedEvent*) realloc(pool, n * sizeof(TimedEvent));
+        if (! npool)
+            return -1;
+        pool = npool;
+        int* nheap = (int*) realloc(heap, n * sizeof(int));
+        if (! nheap)
+            return -1;
+        heap = nheap;
+
+        // Link the new elements into the free list.
+        for (id = avail; id < n; ++id) {
+            pool[id].heapPos = -1;
+            pool[id].interval = id + 1;
+        }
+        pool[n - 1].interval = -1;
+        freeSlot = avail;
+        avail = n;
+    }
+
+    id = freeSlot;
+    ev = pool + id;
+    freeSlot = ev->interval;
+
+    if (interval < 1)
+        interval = 1;
+    ev->callback = callback;
+    ev->data     = data;
+    ev->due      = now + interval;
+    ev->order    = addCount++;
+    ev->interval = interval;
+
+    heap[used] = id;
+    siftUp(used++);
+    return id;
+}
+
+/**
+ * Removes a timed event from the event queue.
+ * This may be called from inside an event callback.
+ */
+void TimedEventMgr::remove(int id) {
+    TimedEvent* ev;
+    int pos;
+
+    if (id < 0 || id >= avail)
+        return;
+    ev = pool + id;
+    pos = ev->heapPos;
+    if (pos < 0)
+        return;
+
+    if (--used != pos) {
+        int moved = heap[used];
+        heap[pos] = moved;
+        siftDown(pos);
+        if (pool[moved].heapPos == pos)
+            siftUp(pos);
+    }
+
+    ev->heapPos  = -1;
+    ev->interval = freeSlot;
+    freeSlot = id;
+}
+
+/**
+ * Removes the oldest event with the given callback and data.
+ * This searches the pool; use remove(id) where the event id is known.
+ */
+void TimedEventMgr::remove(TimedEvent::Callback callback, void *data) {
+    const TimedEvent* ev;
+    const TimedEvent* found = NULL;
+    const TimedEvent* end = pool + avail;
+
+    for (ev = pool; ev != end; ++ev) {
+        if (ev->heapPos >= 0 && ev->callback == callback && ev->data == data) {
+            if (! found || int32_t(ev->order - found->order) < 0)
+                found = ev;
+        }
+    }
+    if (found)
+        remove(int(found - pool));
+}
+
+/**
+ * Runs the callback functions of the events which are due.
+ *
+ * Each event is rescheduled before its callback is run, so the callback is
+ * free to add or remove events (including itself) or to run a nested tick.
+ */
+void TimedEventMgr::tick() {
+    TimedEvent* ev;
+
+    ++now;
+    while (used && int32_t(now - pool[heap[0]].due) >= 0) {
+        ev = pool + heap[0];
+        ev->due = now + ev->interval;
+        siftDown(0);
+
+        // Pool may be reallocated by the callback; ev must not be used after.
+        (*ev->callback)(ev->data);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * timedevent.h
+ */
+
+#ifndef TIMEDEVENT_H
+#define TIMEDEVENT_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * A callback which is run at a fixed interval of TimedEventMgr ticks.
+ */
+struct TimedEvent {
+    typedef void (*Callback)(void *);
+
+    Callback callback;
+    void *data;
+    uint32_t due;       // Tick on which the callback is next run.
+    uint32_t order;     // Orders events which are due on the same tick.
+    int interval;       // Ticks between calls, or next free slot if unused.
+    int heapPos;        // Index in TimedEventMgr::heap or -1 if unused.
+};
+
+
+/**
+ * A class for managing timed events.
+ *
+ * Events are kept in a pooled array and a binary min-heap orders them by
+ * the tick on which they are due, so each tick only touches the events
+ * which run.  Events due on the same tick run in the order they were added.
+ */
+class TimedEventMgr {
+public:
+    TimedEventMgr();
+    ~TimedEventMgr();
+
+    int  add(TimedEvent::Callback callback, int interval, void *data = NULL);
+    void remove(int id);
+    void remove(TimedEvent::Callback callback, void *data = NULL);
+    void tick();
+    int  count() const { return used; }
+
+private:
+    bool before(int a, int b) const;
+    void siftUp(int pos);
+    void siftDown(int pos);
+
+    TimedEvent* pool;
+    int* heap;          // Pool indices ordered by due tick.
+    int used;           // Number of events in the heap.
+    int avail;          // Number of pool & heap elements allocated.
+    int freeSlot;       // First unused pool element or -1.
+    uint32_t now;       // Number of ticks run.
+    uint32_t addCount;
+};
+
+#endif
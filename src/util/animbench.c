@@ -0,0 +1,224 @@
+/*
+ * animbench - Check & time the Animator.
+ *
+ * Linear animations are started, paused, stopped and reused at random and
+ * every value is compared against a simple reference each step.  The time
+ * of anim_advance() is then measured for large banks.
+ *
+ * Usage: animbench [<animation-count>]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CONFIG_ANIM_RANDOM
+#include "../support/anim.c"
+#include "../support/getTicks.c"
+
+#define ANIM_COUNT  2000
+#define CHECK_STEPS 600
+#define BENCH_STEPS 2000
+#define STEP_SEC    (1.0f / 60.0f)
+
+typedef struct {
+    AnimId id;
+    float ctime;
+    float dur;
+    float start[2];
+    float end[2];
+    int paused;
+    int finished;       // Set by the finish handler.
+}
+RefAnim;
+
+static uint32_t rngState = 0x5eed;
+
+static uint32_t rng(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+int anim_random(int range)
+{
+    return rng() % range;
+}
+
+static float rngF(float lo, float hi)
+{
+    return lo + (hi - lo) * (float) (rng() & 0xffff) / 65535.0f;
+}
+
+static void finishHandler(void* data, uint32_t fid)
+{
+    RefAnim* ref = (RefAnim*) data;
+    ref[fid - 1].finished++;
+}
+
+static void startRef(Animator* an, RefAnim* ra, int n)
+{
+    ra->ctime = 0.0f;
+    ra->dur = rngF(0.05f, 2.0f);
+    ra->start[0] = rngF(-100.0f, 100.0f);
+    ra->start[1] = rngF(-100.0f, 100.0f);
+    ra->end[0] = rngF(-100.0f, 100.0f);
+    ra->end[1] = rngF(-100.0f, 100.0f);
+    ra->paused = ra->finished = 0;
+    ra->id = anim_startLinearF2(an, ra->dur, n + 1, ra->start, ra->end);
+}
+
+static int checkValue(const RefAnim* ra, const float* v, int n, int step)
+{
+    float f = ra->ctime / ra->dur;
+    float ex, ey;
+    if (f > 1.0f)
+        f = 1.0f;
+    ex = ra->start[0] + (ra->end[0] - ra->start[0]) * f;
+    ey = ra->start[1] + (ra->end[1] - ra->start[1]) * f;
+    if (fabsf(v[0] - ex) > 0.01f || fabsf(v[1] - ey) > 0.01f) {
+        printf("Step %d anim %d: %f,%f expected %f,%f\n",
+               step, n, v[0], v[1], ex, ey);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Return number of errors found.
+ */
+static int checkLinear(int count)
+{
+    Animator an;
+    RefAnim* ref = (RefAnim*) calloc(count, sizeof(RefAnim));
+    RefAnim* ra;
+    AnimId stale;
+    int errors = 0;
+    int i, step;
+
+    // Start small so that the bank must grow.
+    anim_init(&an, 8, finishHandler, ref);
+    for (i = 0; i < count; ++i)
+        startRef(&an, ref + i, i);
+
+    for (step = 0; step < CHECK_STEPS && errors < 8; ++step) {
+        anim_advance(&an, STEP_SEC);
+
+        for (i = 0; i < count; ++i) {
+            ra = ref + i;
+            if (! ra->paused)
+                ra->ctime += STEP_SEC;
+
+            if (ra->ctime >= ra->dur) {
+                // Must be released with the end value & finished once.
+                if (anim_valid(&an, ra->id) || ra->finished != 1) {
+                    printf("Step %d anim %d: not finished (%d)\n",
+                           step, i, ra->finished);
+                    ++errors;
+                }
+                errors += checkValue(ra, anim_valueF2(&an, ra->id), i, step);
+
+                // Reuse the slot; the old id must now be ignored.
+                stale = ra->id;
+                startRef(&an, ra, i);
+                anim_setState(&an, stale, ANIM_PAUSED);
+                if (anim_valid(&an, stale)) {
+                    printf("Step %d anim %d: stale id valid\n", step, i);
+                    ++errors;
+                }
+                continue;
+            }
+
+            if (! anim_valid(&an, ra->id) || ra->finished) {
+                printf("Step %d anim %d: finished early\n", step, i);
+                ++errors;
+                continue;
+            }
+            errors += checkValue(ra, anim_valueF2(&an, ra->id), i, step);
+
+            switch (rng() & 63) {
+            case 0:
+                ra->paused = ! ra->paused;
+                anim_setState(&an, ra->id,
+                              ra->paused ? ANIM_PAUSED : ANIM_PLAYING);
+                break;
+            case 1:
+                // Stopping does not call the finish handler.
+                anim_setState(&an, ra->id, ANIM_FREE);
+                startRef(&an, ra, i);
+                break;
+            }
+        }
+
+        if (an.linearCount != (uint32_t) count) {
+            printf("Step %d: %u animations, expected %d\n",
+                   step, an.linearCount, count);
+            ++errors;
+        }
+    }
+
+    anim_free(&an);
+    free(ref);
+    return errors;
+}
+
+static double benchLinear(int count)
+{
+    Animator an;
+    float start[2] = { 0.0f, 0.0f };
+    float end[2] = { 10.0f, 20.0f };
+    int64_t t0;
+    int i;
+
+    anim_init(&an, count, NULL, NULL);
+    for (i = 0; i < count; ++i)
+        anim_startLinearF2(&an, 1e6f, 0, start, end);
+
+    t0 = usecTicks();
+    for (i = 0; i < BENCH_STEPS; ++i)
+        anim_advance(&an, STEP_SEC);
+    t0 = usecTicks() - t0;
+
+    anim_free(&an);
+    return (double) t0 * 1000.0 / ((double) BENCH_STEPS * count);
+}
+
+static double benchCycle(int count)
+{
+    Animator an;
+    int64_t t0;
+    int i;
+
+    anim_init(&an, count, NULL, NULL);
+    for (i = 0; i < count; ++i)
+        anim_startCycleRandomI(&an, rngF(0.1f, 0.5f), ANIM_FOREVER, 0,
+                               0, 4, 50);
+
+    t0 = usecTicks();
+    for (i = 0; i < BENCH_STEPS; ++i)
+        anim_advance(&an, STEP_SEC);
+    t0 = usecTicks() - t0;
+
+    anim_free(&an);
+    return (double) t0 * 1000.0 / ((double) BENCH_STEPS * count);
+}
+
+int main(int argc, char** argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : ANIM_COUNT;
+    int errors;
+
+    if (count < 1 || count > 60000) {
+        fprintf(stderr, "animbench: Invalid animation count\n");
+        return 1;
+    }
+
+    errors = checkLinear(count < 500 ? count : 500);
+    printf("%d animations\n", count);
+    printf("Linear F2: %.2f ns/value\n", benchLinear(count));
+    printf("Cycle:     %.2f ns/value\n", benchCycle(count));
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
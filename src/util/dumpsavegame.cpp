@@ -8,6 +8,7 @@
 #include "savegame.cpp"
 
 #define EX_USAGE     64  /* command line usage error */
+#define EX_DATAERR   65  /* data format error */
 #define EX_NOINPUT   66  /* cannot open input */
 
 void showSaveGamePlayerRecord(SaveGamePlayerRecord *rec) {
@@ -168,7 +169,11 @@ int main(int argc, char *argv[]) {
         return EX_NOINPUT;
     }
 
-    sg.read(in);
+    if (! sg.read(in)) {
+        fprintf(stderr, "%s: File is too short\n", argv[1]);
+        fclose(in);
+        return EX_DATAERR;
+    }
     showSaveGame(&sg);
     fclose(in);
     return 0;
@@ -0,0 +1,122 @@
+// Benchmark & check the dialogue KeywordIndex against a linear topic search.
+//
+// Usage: kwbench [<topics-per-conversation>]
+
+#include <cstdio>
+#include "../discourse_keyword.cpp"
+#include "../support/getTicks.c"
+
+#define CONV_COUNT      256
+#define TOPIC_COUNT     7       // U4 .TLK keywords, job, health, etc.
+#define LOOKUPS         2000000
+
+struct Topic {
+    std::string word;
+    int value;
+};
+
+static std::vector<Topic> topics[CONV_COUNT];
+static uint32_t seed = 0x1234567;
+
+static uint32_t rnd(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static std::string randomWord(int minLen, int maxLen) {
+    std::string word;
+    int len = minLen + rnd(maxLen - minLen + 1);
+    for (int i = 0; i < len; ++i)
+        word += char('a' + rnd(6));     // Small alphabet to share prefixes.
+    return word;
+}
+
+// The original search: input begins with the topic; the first topic wins.
+static int linearLookup(int conv, const char* input) {
+    size_t inLen = strlen(input);
+    std::vector<Topic>::const_iterator it;
+    for (it = topics[conv].begin(); it != topics[conv].end(); ++it) {
+        if (it->word.size() <= inLen &&
+            strncasecmp(input, it->word.c_str(), it->word.size()) == 0)
+            return it->value;
+    }
+    return -1;
+}
+
+static int indexLookup(const KeywordIndex* ki, int conv, const char* input) {
+    const KeywordEntry* ent = kwi_lookup(ki, conv, input);
+    return ent ? ent->value : -1;
+}
+
+int main(int argc, char** argv) {
+    KeywordBuilder kb;
+    std::vector<std::string> inputs;
+    char name[16];
+    int conv, i;
+    int topicCount = (argc > 1) ? atoi(argv[1]) : TOPIC_COUNT;
+
+    for (conv = 0; conv < CONV_COUNT; ++conv) {
+        for (i = 0; i < topicCount; ++i) {
+            Topic tp;
+            tp.word  = randomWord(1, 7);
+            tp.value = i;
+            topics[conv].push_back(tp);
+            kwb_add(&kb, conv, tp.word.c_str(), tp.word.size(), i, 0);
+        }
+        sprintf(name, "Name%d", conv);
+        kwb_add(&kb, KW_NAME_CONV, name, strlen(name), conv, 0);
+    }
+    KeywordIndex* ki = kwb_finish(&kb);
+    if (! ki) {
+        fprintf(stderr, "kwbench: Out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < 1024; ++i) {
+        std::string in(randomWord(0, 9));
+        if (i & 1)
+            in[0] = toupper(in[0]);     // Check case folding.
+        inputs.push_back(in);
+    }
+
+    // Check results.
+    int errors = 0;
+    for (conv = 0; conv < CONV_COUNT; ++conv) {
+        for (i = 0; i < (int) inputs.size(); ++i) {
+            const char* in = inputs[i].c_str();
+            if (indexLookup(ki, conv, in) != linearLookup(conv, in)) {
+                if (++errors < 10)
+                    printf("Mismatch conv %d \"%s\"\n", conv, in);
+            }
+        }
+        sprintf(name, "name%d", conv);
+        if (kwi_findName(ki, name) != conv) {
+            if (++errors < 10)
+                printf("Name %s not found\n", name);
+        }
+    }
+    if (kwi_findName(ki, "Nobody") != -1)
+        ++errors;
+
+    // Time lookups.
+    int64_t t0, tIndex, tLinear;
+    long hits = 0;
+
+    t0 = usecTicks();
+    for (i = 0; i < LOOKUPS; ++i)
+        hits += indexLookup(ki, i % CONV_COUNT, inputs[i & 1023].c_str());
+    tIndex = usecTicks() - t0;
+
+    t0 = usecTicks();
+    for (i = 0; i < LOOKUPS; ++i)
+        hits -= linearLookup(i % CONV_COUNT, inputs[i & 1023].c_str());
+    tLinear = usecTicks() - t0;
+
+    printf("%d conversations, %d topics each\n", CONV_COUNT, topicCount);
+    printf("Index:  %.1f ns/lookup\n", tIndex  * 1000.0 / LOOKUPS);
+    printf("Linear: %.1f ns/lookup\n", tLinear * 1000.0 / LOOKUPS);
+    printf("%d errors\n", errors + (hits ? 1 : 0));
+
+    free(ki);
+    return (errors || hits) ? 1 : 0;
+}
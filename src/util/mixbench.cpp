@@ -0,0 +1,183 @@
+// Check the software mixer by rendering a known sound to a WAV file.
+//
+// A sine tone is written as a 22050 Hz mono WAV, decoded, and played
+// several times through the mixer thread, which outputs a 44100 Hz stereo
+// WAV.  The output header, the number of sounding frames & the peak level
+// are then compared against the tone.  This runs in real time.
+//
+// Usage: mixbench [<output.wav>]
+
+#include <math.h>
+#include "../sound_mixcore.cpp"
+#include "../support/getTicks.c"
+
+#define TONE_RATE       22050
+#define TONE_FRAMES     (TONE_RATE / 4)
+#define TONE_HZ         440.0
+#define TONE_LEVEL      0.5
+#define PLAYS           4
+#define TONE_FILE       "mixbench_tone.wav"
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static bool writeTone(const char* path) {
+    uint8_t head[44];
+    int16_t pcm[TONE_FRAMES];
+    uint32_t dataBytes = sizeof(pcm);
+    int i;
+
+    for (i = 0; i < TONE_FRAMES; ++i)
+        pcm[i] = int16_t(32767.0 * TONE_LEVEL *
+                         sin(2.0 * M_PI * TONE_HZ * i / TONE_RATE));
+
+    memcpy(head, "RIFF....WAVEfmt ....................data....", 44);
+    putU32(head + 4, 36 + dataBytes);
+    putU32(head + 16, 16);
+    putU32(head + 20, 1 | 1 << 16);             // PCM, mono
+    putU32(head + 24, TONE_RATE);
+    putU32(head + 28, TONE_RATE * 2);
+    putU32(head + 32, 2 | 16 << 16);            // Block align, bits
+    putU32(head + 40, dataBytes);
+
+    FILE* fp = fopen(path, "wb");
+    if (! fp)
+        return false;
+    bool ok = fwrite(head, 1, 44, fp) == 44 &&
+              fwrite(pcm, 1, dataBytes, fp) == dataBytes;
+    return (fclose(fp) == 0) && ok;
+}
+
+static void playTone(Mixer* mx, const MixBuffer* buf) {
+    mutex_lock(&mx->lock);
+    MixSource* src = mx->source;
+    src->buffer = 0;
+    src->endFrame = buf->frames;
+    src->requestTime = usecTicks();
+    src->pos = 0;
+    src->step = mix_step(buf->rate);
+    mutex_unlock(&mx->lock);
+}
+
+static bool sourceBusy(Mixer* mx) {
+    mutex_lock(&mx->lock);
+    bool busy = mx->source[0].buffer >= 0;
+    mutex_unlock(&mx->lock);
+    return busy;
+}
+
+/*
+ * Return the number of errors found in the mixer output.
+ */
+static int checkOutput(const char* path, uint32_t periods) {
+    uint8_t head[44];
+    int16_t frame[2];
+    uint32_t dataBytes, frames = 0, sounding = 0;
+    int peak = 0;
+    int errors = 0;
+
+    FILE* fp = fopen(path, "rb");
+    if (! fp || fread(head, 1, 44, fp) != 44) {
+        printf("Cannot read %s\n", path);
+        if (fp)
+            fclose(fp);
+        return 1;
+    }
+    dataBytes = readU32(head + 40);
+    while (fread(frame, sizeof(int16_t), 2, fp) == 2) {
+        ++frames;
+        if (frame[0] || frame[1])
+            ++sounding;
+        if (abs(frame[0]) > peak)
+            peak = abs(frame[0]);
+        if (frame[0] != frame[1])
+            ++errors;   // Mono sources must be identical in both channels.
+    }
+    fclose(fp);
+
+    uint32_t expectFrames = periods * MIX_PERIOD;
+    uint32_t expectSound = uint32_t(PLAYS * double(TONE_FRAMES) *
+                                    MIX_RATE / TONE_RATE);
+    int expectPeak = int(32767.0 * TONE_LEVEL);
+
+    printf("Output: %u frames (%u sounding, expected %u), peak %d (%d)\n",
+           frames, sounding, expectSound, peak, expectPeak);
+
+    if (memcmp(head, "RIFF", 4) || memcmp(head + 8, "WAVEfmt ", 8) ||
+        readU32(head + 24) != MIX_RATE || dataBytes != frames * 4) {
+        printf("Bad WAV header\n");
+        ++errors;
+    }
+    if (frames != expectFrames) {
+        printf("Expected %u frames for %u periods\n", expectFrames, periods);
+        ++errors;
+    }
+    // Interpolated zero crossings may land exactly on zero.
+    if (sounding > expectSound + PLAYS * 2 ||
+        sounding < expectSound - expectSound / 200) {
+        printf("Sounding length differs\n");
+        ++errors;
+    }
+    if (abs(peak - expectPeak) > expectPeak / 100) {
+        printf("Peak level differs\n");
+        ++errors;
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = (argc > 1) ? argv[1] : "mixbench.wav";
+    MixBuffer* buf = buffers;
+    Decoder dec;
+    int errors = 0;
+    int i;
+
+    if (! writeTone(TONE_FILE) || ! dec_open(&dec, TONE_FILE, 0, 0)) {
+        fprintf(stderr, "mixbench: Cannot create %s\n", TONE_FILE);
+        return 1;
+    }
+    mix_decodeBuffer(buf, &dec);
+    remove(TONE_FILE);
+    if (buf->frames != TONE_FRAMES + 1 || buf->rate != TONE_RATE) {
+        printf("Decoded %u frames at %u Hz\n", buf->frames, buf->rate);
+        return 1;
+    }
+
+    FILE* wav = fopen(outPath, "w+b");
+    if (! wav) {
+        fprintf(stderr, "mixbench: Cannot create %s\n", outPath);
+        return 1;
+    }
+    Mixer* mx = mixer_new(wav);
+    if (! mx) {
+        fprintf(stderr, "mixbench: Unable to start thread\n");
+        return 1;
+    }
+
+    soundVolume = 1.0f;
+    for (i = 0; i < PLAYS; ++i) {
+        playTone(mx, buf);
+        do {
+            thread_sleep(5);
+        } while (sourceBusy(mx));
+    }
+    thread_sleep(50);
+    mixer_stop(mx);
+
+    mixer_printStats(mx);
+    if (mx->stats.plays != PLAYS) {
+        printf("Mixer counted %u plays\n", mx->stats.plays);
+        ++errors;
+    }
+    uint32_t periods = mx->stats.periods;
+    mixer_free(mx);
+    free(buf->samples);
+
+    errors += checkOutput(outPath, periods);
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
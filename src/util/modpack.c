@@ -0,0 +1,340 @@
+/*
+ * modpack - Compact CDI packages written by pack-xu4.b.
+ *
+ * Chunks with identical content are stored only once and all of their TOC
+ * entries alias the same data.  The TOC is sorted by appId so that the
+ * module loader can use a binary search.  Chunk hashing is split among
+ * worker threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdi.h"
+#include "threads.h"
+#include "murmurHash3.c"
+
+#ifndef MODPACK_WORKERS
+#define MODPACK_WORKERS 4
+#endif
+
+typedef struct {
+    uint8_t* data;          // Entire package file.
+    size_t size;
+    CDIEntry* toc;
+    uint32_t* hash;         // Content hash of each TOC entry.
+    uint32_t count;
+} Package;
+
+typedef struct {
+    const Package* pkg;
+    uint32_t start;
+    uint32_t stride;
+} HashJob;
+
+static int verbose = 0;
+
+static THREAD_FUNC hashChunks(void* arg)
+{
+    const HashJob* job = (const HashJob*) arg;
+    const Package* pkg = job->pkg;
+    const CDIEntry* ent;
+    uint32_t i;
+
+    for (i = job->start; i < pkg->count; i += job->stride) {
+        ent = pkg->toc + i;
+        pkg->hash[i] = murmurHash3_32(pkg->data + ent->offset, ent->bytes,
+                                      0x554956);
+    }
+    return THREAD_RETURN;
+}
+
+static void hashPackage(Package* pkg)
+{
+    Thread th[MODPACK_WORKERS];
+    HashJob job[MODPACK_WORKERS];
+    int started[MODPACK_WORKERS];
+    int i;
+
+    for (i = 0; i < MODPACK_WORKERS; ++i) {
+        job[i].pkg = pkg;
+        job[i].start = i;
+        job[i].stride = MODPACK_WORKERS;
+        started[i] = (i > 0) ? thread_create(th + i, hashChunks, job + i) : 0;
+    }
+
+    // Do the work of any thread which failed to start on this one.
+    for (i = 0; i < MODPACK_WORKERS; ++i) {
+        if (! started[i])
+            hashChunks(job + i);
+    }
+    for (i = 1; i < MODPACK_WORKERS; ++i) {
+        if (started[i])
+            thread_join(th[i]);
+    }
+}
+
+static const Package* sortPkg;
+
+static int compareHash(const void* a, const void* b)
+{
+    uint32_t ia = *(const uint32_t*) a;
+    uint32_t ib = *(const uint32_t*) b;
+    uint32_t ha = sortPkg->hash[ia];
+    uint32_t hb = sortPkg->hash[ib];
+    if (ha != hb)
+        return (ha < hb) ? -1 : 1;
+    return (ia < ib) ? -1 : (ia > ib);
+}
+
+static int sameChunk(const Package* pkg, const CDIEntry* a, const CDIEntry* b)
+{
+    return a->bytes == b->bytes &&
+           memcmp(pkg->data + a->offset, pkg->data + b->offset, a->bytes) == 0;
+}
+
+static int loadPackage(Package* pkg, const char* file)
+{
+    CDIEntry header;
+    const CDIEntry* ent;
+    uint32_t i;
+    FILE* fp;
+
+    memset(pkg, 0, sizeof(Package));
+
+    fp = cdi_openPak(file, &header);
+    if (! fp) {
+        fprintf(stderr, "modpack: Cannot open CDI package %s\n", file);
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    pkg->size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    pkg->data = (uint8_t*) malloc(pkg->size);
+    if (! pkg->data || fread(pkg->data, 1, pkg->size, fp) != pkg->size) {
+        fprintf(stderr, "modpack: Cannot read %s\n", file);
+        goto fail;
+    }
+
+    if (header.offset + header.bytes > pkg->size) {
+        fprintf(stderr, "modpack: Invalid TOC in %s\n", file);
+        goto fail;
+    }
+    pkg->count = CDI_TOC_SIZE((&header));
+    pkg->toc = cdi_loadPakTOC(fp, &header);
+    pkg->hash = (uint32_t*) malloc(pkg->count * sizeof(uint32_t));
+    if (! pkg->toc || ! pkg->hash) {
+        fprintf(stderr, "modpack: Cannot read TOC of %s\n", file);
+        goto fail;
+    }
+
+    for (i = 0; i < pkg->count; ++i) {
+        ent = pkg->toc + i;
+        if (ent->offset + ent->bytes > pkg->size) {
+            fprintf(stderr, "modpack: Invalid chunk %u in %s\n", i, file);
+            goto fail;
+        }
+    }
+
+    fclose(fp);
+    return 1;
+
+fail:
+    fclose(fp);
+    free(pkg->data);
+    free(pkg->toc);
+    free(pkg->hash);
+    return 0;
+}
+
+static void freePackage(Package* pkg)
+{
+    free(pkg->data);
+    free(pkg->toc);
+    free(pkg->hash);
+}
+
+static void write32(uint8_t* buf, uint32_t n)
+{
+    buf[0] = n;
+    buf[1] = n >> 8;
+    buf[2] = n >> 16;
+    buf[3] = n >> 24;
+}
+
+/*
+ * Set original[i] to the index of the first chunk with the same content as
+ * chunk i (or i if it is unique).
+ */
+static void findDuplicates(const Package* pkg, uint32_t* original)
+{
+    uint32_t* order = (uint32_t*) malloc(pkg->count * sizeof(uint32_t));
+    uint32_t i, j, k;
+
+    for (i = 0; i < pkg->count; ++i)
+        order[i] = original[i] = i;
+
+    // Group chunks by hash; within a group the lowest index comes first.
+    sortPkg = pkg;
+    qsort(order, pkg->count, sizeof(uint32_t), compareHash);
+
+    for (i = 0; i < pkg->count; i = j) {
+        for (j = i + 1; j < pkg->count &&
+             pkg->hash[order[j]] == pkg->hash[order[i]]; ++j) {
+            for (k = i; k < j; ++k) {
+                if (original[order[k]] == order[k] &&
+                    sameChunk(pkg, pkg->toc + order[k], pkg->toc + order[j])) {
+                    original[order[j]] = order[k];
+                    break;
+                }
+            }
+        }
+    }
+    free(order);
+}
+
+/*
+ * Write the package with duplicate chunks removed and the TOC sorted.
+ * The chunk data keeps its original order.
+ *
+ * Return number of bytes saved or -1 if an error occurred.
+ */
+static long compactPackage(Package* pkg, const char* file)
+{
+    CDIEntry* out;
+    CDIEntry* ent;
+    uint32_t* original;
+    uint32_t* newOffset;
+    uint32_t i, j;
+    uint32_t pos;
+    uint8_t* tocBuf;
+    char* tmpFile;
+    FILE* fp;
+    int dupCount = 0;
+    long saved = -1;
+
+    hashPackage(pkg);
+
+    out = (CDIEntry*) malloc(pkg->count * sizeof(CDIEntry));
+    original = (uint32_t*) malloc(pkg->count * sizeof(uint32_t));
+    newOffset = (uint32_t*) malloc(pkg->count * sizeof(uint32_t));
+    tmpFile = (char*) malloc(strlen(file) + 5);
+    if (! out || ! original || ! newOffset || ! tmpFile)
+        goto cleanup;
+    findDuplicates(pkg, original);
+    strcpy(tmpFile, file);
+    strcat(tmpFile, ".tmp");
+
+    fp = fopen(tmpFile, "wb");
+    if (! fp) {
+        fprintf(stderr, "modpack: Cannot create %s\n", tmpFile);
+        goto cleanup;
+    }
+
+    // Header is written again after the TOC position is known.
+    fwrite(pkg->data, 1, sizeof(CDIEntry), fp);
+    pos = sizeof(CDIEntry);
+
+    for (i = 0; i < pkg->count; ++i) {
+        ent = pkg->toc + i;
+        out[i] = *ent;
+
+        j = original[i];
+        if (j != i) {
+            newOffset[i] = newOffset[j];
+            ++dupCount;
+            if (verbose)
+                printf("  chunk %u aliases %u (%u bytes)\n", i, j, ent->bytes);
+        } else {
+            newOffset[i] = pos;
+            if (fwrite(pkg->data + ent->offset, 1, ent->bytes, fp) !=
+                    ent->bytes)
+                goto write_fail;
+            pos += ent->bytes;
+        }
+        out[i].offset = newOffset[i];
+    }
+
+    cdi_sortTOC(out, pkg->count);
+
+    // Stored offset & bytes are little endian.
+    tocBuf = (uint8_t*) out;
+    for (i = 0; i < pkg->count; ++i) {
+        write32(tocBuf + 8,  out[i].offset);
+        write32(tocBuf + 12, out[i].bytes);
+        tocBuf += sizeof(CDIEntry);
+    }
+    if (fwrite(out, sizeof(CDIEntry), pkg->count, fp) != pkg->count)
+        goto write_fail;
+
+    {
+    uint8_t head[8];
+    write32(head, pos);
+    write32(head + 4, pkg->count * sizeof(CDIEntry));
+    fseek(fp, 8, SEEK_SET);
+    if (fwrite(head, 1, 8, fp) != 8)
+        goto write_fail;
+    }
+
+    if (fclose(fp)) {
+        fp = NULL;
+        goto write_fail;
+    }
+    if (remove(file) || rename(tmpFile, file)) {
+        fprintf(stderr, "modpack: Cannot replace %s\n", file);
+        goto cleanup;
+    }
+
+    saved = (long) pkg->size - (long) (pos + pkg->count * sizeof(CDIEntry));
+    if (verbose)
+        printf("%s: %d of %u chunks aliased, %ld bytes saved\n",
+               file, dupCount, pkg->count, saved);
+    goto cleanup;
+
+write_fail:
+    fprintf(stderr, "modpack: Write to %s failed\n", tmpFile);
+    if (fp)
+        fclose(fp);
+    remove(tmpFile);
+
+cleanup:
+    free(out);
+    free(original);
+    free(newOffset);
+    free(tmpFile);
+    return saved;
+}
+
+int main(int argc, char** argv)
+{
+    Package pkg;
+    int i;
+    int status = 0;
+
+    if (argc < 2) {
+usage:
+        printf("Usage: modpack [-v] <package> ...\n\n"
+               "Remove duplicate chunks from CDI packages and sort the TOC.\n");
+        return 1;
+    }
+
+    for (i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            if (strcmp(argv[i], "-v") == 0)
+                verbose = 1;
+            else
+                goto usage;
+            continue;
+        }
+
+        if (! loadPackage(&pkg, argv[i])) {
+            status = 1;
+            continue;
+        }
+        if (compactPackage(&pkg, argv[i]) < 0)
+            status = 1;
+        freePackage(&pkg);
+    }
+    return status;
+}
@@ -0,0 +1,741 @@
+// Validate, compare, convert & summarize large numbers of Ultima 4 saves.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define SAVE_UTIL
+#include "savegame.cpp"
+#include "support/threads.h"
+
+#define EX_USAGE     64  /* command line usage error */
+#define EX_DATAERR   65  /* data format error */
+#define EX_NOINPUT   66  /* cannot open input */
+#define EX_CANTCREAT 73  /* can't create (user) output file */
+
+/*
+  A bundle is a header followed by fixed size records which each hold a
+  PARTY.SAV & MONSTERS.SAV pair.  The header is the "U4SB" magic and a
+  little-endian 32-bit record count.
+*/
+#define BUNDLE_MAGIC    "U4SB"
+#define BUNDLE_HEADER   8
+#define RECORD_SIZE     (SAVEGAME_SIZE + MONSTERTABLE_BYTES)
+#define BATCH_SIZE      4096
+
+enum Command {
+    CMD_VALIDATE,
+    CMD_STATS,
+    CMD_CONVERT
+};
+
+struct Input {
+    std::string path;       // Directory, party.sav file, or bundle.
+    int32_t record;         // Bundle record index or -1.
+};
+
+struct SaveRec {
+    SaveGame sg;
+    SaveGameMonsterRecord mons[MONSTERTABLE_SIZE];
+    bool hasMonsters;
+};
+
+#define KARMA_BUCKETS   6
+
+struct Stats {
+    uint32_t count;
+    uint32_t invalid;
+    uint32_t level[9];
+    uint32_t klass[8];
+    uint32_t members[9];
+    uint32_t karma[VIRT_MAX][KARMA_BUCKETS];
+    uint32_t items[16];
+    uint32_t stones[8];
+    uint32_t runes[8];
+    uint64_t moves;
+    uint64_t gold;
+    uint64_t torches;
+    uint64_t gems;
+    uint64_t keys;
+};
+
+struct Batch {
+    const Input* inputs;
+    int count;
+    Command cmd;
+    bool quiet;
+    uint8_t* records;       // Packed output for CMD_CONVERT.
+    uint8_t* valid;
+};
+
+struct Worker {
+    Thread thread;
+    const Batch* batch;
+    int first;
+    int stride;
+    Stats stats;
+    std::string bundlePath;
+    FILE* bundle;
+};
+
+static const char* const virtueNames[VIRT_MAX] = {
+    "Hon", "Com", "Val", "Jus", "Sac", "Hnr", "Spi", "Hum"
+};
+
+static const char* const classNames[8] = {
+    "Mage", "Bard", "Fighter", "Druid", "Tinker", "Paladin", "Ranger",
+    "Shepherd"
+};
+
+static const char* const itemNames[16] = {
+    "skull", "skull-destroyed", "candle", "book", "bell", "key-courage",
+    "key-love", "key-truth", "horn", "wheel", "candle-used", "book-used",
+    "bell-used", "bit-14", "bit-15", "bit-16"
+};
+
+//----------------------------------------------------------------------------
+
+static bool isDirectory(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static bool hasSuffix(const std::string& str, const char* suffix) {
+    size_t len = strlen(suffix);
+    return str.size() >= len &&
+           str.compare(str.size() - len, len, suffix) == 0;
+}
+
+/*
+ * Read an entire file which must be exactly size bytes.
+ * Return 1 if successful, 0 if the file does not exist, or -1 if the size
+ * is wrong.
+ */
+static int readExact(const std::string& path, uint8_t* buf, size_t size) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (! fp)
+        return 0;
+    size_t n = fread(buf, 1, size, fp);
+    int extra = fgetc(fp);
+    fclose(fp);
+    return (n == size && extra == EOF) ? 1 : -1;
+}
+
+static uint32_t bundleCount(FILE* fp) {
+    uint8_t head[BUNDLE_HEADER];
+    if (fread(head, 1, BUNDLE_HEADER, fp) != BUNDLE_HEADER ||
+        memcmp(head, BUNDLE_MAGIC, 4) != 0)
+        return 0;
+    return unpackInt(head + 4);
+}
+
+/*
+ * Load a save set into rec.  Return NULL if successful or an error message.
+ */
+static const char* loadSet(Worker* wk, const Input* in, SaveRec* rec) {
+    uint8_t buf[RECORD_SIZE];
+    std::string party, mons;
+    int ok;
+
+    if (in->record >= 0) {
+        if (wk->bundlePath != in->path) {
+            if (wk->bundle)
+                fclose(wk->bundle);
+            wk->bundle = fopen(in->path.c_str(), "rb");
+            wk->bundlePath = in->path;
+        }
+        if (! wk->bundle ||
+            fseek(wk->bundle, BUNDLE_HEADER + long(in->record) * RECORD_SIZE,
+                  SEEK_SET) != 0 ||
+            fread(buf, 1, RECORD_SIZE, wk->bundle) != RECORD_SIZE)
+            return "truncated bundle";
+        rec->sg.unpack(buf);
+        saveGameMonstersUnpack(rec->mons, buf + SAVEGAME_SIZE);
+        rec->hasMonsters = true;
+        return NULL;
+    }
+
+    if (isDirectory(in->path.c_str())) {
+        party = in->path + "/" PARTY_SAV;
+        mons  = in->path + "/" MONSTERS_SAV;
+    } else {
+        party = in->path;
+        size_t sep = party.find_last_of("/\\");
+        mons = (sep == std::string::npos) ? std::string()
+                                          : party.substr(0, sep + 1);
+        mons += MONSTERS_SAV;
+    }
+
+    ok = readExact(party, buf, SAVEGAME_SIZE);
+    if (ok == 0)
+        return "cannot open " PARTY_SAV;
+    if (ok < 0)
+        return PARTY_SAV " has wrong size";
+    rec->sg.unpack(buf);
+
+    ok = readExact(mons, buf, MONSTERTABLE_BYTES);
+    if (ok < 0)
+        return MONSTERS_SAV " has wrong size";
+    rec->hasMonsters = (ok == 1);
+    if (ok == 1)
+        saveGameMonstersUnpack(rec->mons, buf);
+    else
+        memset(rec->mons, 0, sizeof(rec->mons));
+    return NULL;
+}
+
+#define RANGE(v,lo,hi)  ((v) >= (lo) && (v) <= (hi))
+
+/*
+ * Check that the values in a save are within the limits of the game.
+ * Return NULL if valid or an error message.
+ */
+static const char* validateSet(const SaveRec* rec, char* msg, size_t msgLen) {
+    const SaveGame& sg = rec->sg;
+    int i;
+
+    if (! RANGE(sg.members, 1, 8))
+        return "invalid party size";
+
+    for (i = 0; i < sg.members; ++i) {
+        const SaveGamePlayerRecord& pr = sg.players[i];
+        const char* err = NULL;
+
+        if (! pr.name[0] || memchr(pr.name, 0, 16) == NULL)
+            err = "bad name";
+        else if (pr.weapon >= WEAP_MAX)
+            err = "bad weapon";
+        else if (pr.armor >= ARMR_MAX)
+            err = "bad armor";
+        else if (pr.klass > CLASS_SHEPHERD)
+            err = "bad class";
+        else if (pr.sex != SEX_MALE && pr.sex != SEX_FEMALE)
+            err = "bad sex";
+        else if (pr.status != STAT_GOOD && pr.status != STAT_POISONED &&
+                 pr.status != STAT_SLEEPING && pr.status != STAT_DEAD)
+            err = "bad status";
+        else if (pr.hp > pr.hpMax || pr.hpMax > 800)
+            err = "bad hit points";
+        else if (pr.str > 99 || pr.dex > 99 || pr.intel > 99 || pr.mp > 99)
+            err = "bad attribute";
+        else if (pr.xp > 9999)
+            err = "bad experience";
+
+        if (err) {
+            snprintf(msg, msgLen, "player %d %s", i + 1, err);
+            return msg;
+        }
+    }
+
+    for (i = 0; i < VIRT_MAX; ++i) {
+        if (! RANGE(sg.karma[i], 0, 100))
+            return "karma out of range";
+    }
+    for (i = 0; i < ARMR_MAX; ++i) {
+        if (! RANGE(sg.armor[i], 0, 99))
+            return "armor count out of range";
+    }
+    for (i = 0; i < WEAP_MAX; ++i) {
+        if (! RANGE(sg.weapons[i], 0, 99))
+            return "weapon count out of range";
+    }
+    for (i = 0; i < REAG_MAX; ++i) {
+        if (! RANGE(sg.reagents[i], 0, 99))
+            return "reagent count out of range";
+    }
+    for (i = 0; i < SPELL_MAX; ++i) {
+        if (! RANGE(sg.mixtures[i], 0, 99))
+            return "mixture count out of range";
+    }
+    if (! RANGE(sg.food, 0, 999900))
+        return "food out of range";
+    if (! RANGE(sg.gold, 0, 9999))
+        return "gold out of range";
+    if (! RANGE(sg.torches, 0, 99) || ! RANGE(sg.gems, 0, 99) ||
+        ! RANGE(sg.keys, 0, 99) || ! RANGE(sg.sextants, 0, 99))
+        return "equipment out of range";
+    if (sg.trammelphase > 7 || sg.feluccaphase > 7)
+        return "bad moon phase";
+    return NULL;
+}
+
+static void accumulate(Stats* st, const SaveGame& sg) {
+    int i, lev;
+
+    ++st->count;
+
+    lev = sg.players[0].hpMax / 100;
+    st->level[RANGE(lev, 1, 8) ? lev : 0]++;
+    if (sg.players[0].klass <= CLASS_SHEPHERD)
+        st->klass[sg.players[0].klass]++;
+    st->members[RANGE(sg.members, 1, 8) ? sg.members : 0]++;
+
+    // Buckets: 0 (Avatarhood), 1-24, 25-49, 50-74, 75-98, 99-100.
+    for (i = 0; i < VIRT_MAX; ++i) {
+        int k = sg.karma[i];
+        int b;
+        if (k <= 0)
+            b = 0;
+        else if (k >= 99)
+            b = 5;
+        else
+            b = 1 + k / 25;
+        st->karma[i][b]++;
+    }
+
+    for (i = 0; i < 16; ++i) {
+        if (sg.items & (1 << i))
+            st->items[i]++;
+    }
+    for (i = 0; i < 8; ++i) {
+        if (sg.stones & (1 << i))
+            st->stones[i]++;
+        if (sg.runes & (1 << i))
+            st->runes[i]++;
+    }
+
+    st->moves   += sg.moves;
+    st->gold    += sg.gold;
+    st->torches += sg.torches;
+    st->gems    += sg.gems;
+    st->keys    += sg.keys;
+}
+
+static void mergeStats(Stats* dst, const Stats* src) {
+    const uint32_t* sp = &src->count;
+    uint32_t* dp = &dst->count;
+    const uint32_t* end = (const uint32_t*) &src->moves;
+    while (sp != end)
+        *dp++ += *sp++;
+
+    dst->moves   += src->moves;
+    dst->gold    += src->gold;
+    dst->torches += src->torches;
+    dst->gems    += src->gems;
+    dst->keys    += src->keys;
+}
+
+static THREAD_FUNC workerMain(void* arg) {
+    Worker* wk = (Worker*) arg;
+    const Batch* batch = wk->batch;
+    SaveRec rec;
+    char msg[64];
+    const char* err;
+    int i;
+
+    for (i = wk->first; i < batch->count; i += wk->stride) {
+        const Input* in = batch->inputs + i;
+
+        err = loadSet(wk, in, &rec);
+        if (! err)
+            err = validateSet(&rec, msg, sizeof(msg));
+
+        batch->valid[i] = err ? 0 : 1;
+        if (err) {
+            ++wk->stats.invalid;
+            if (! batch->quiet) {
+                if (in->record >= 0)
+                    printf("%s#%d: %s\n", in->path.c_str(), in->record, err);
+                else
+                    printf("%s: %s\n", in->path.c_str(), err);
+            }
+            continue;
+        }
+
+        if (batch->cmd == CMD_STATS)
+            accumulate(&wk->stats, rec.sg);
+        else if (batch->cmd == CMD_CONVERT) {
+            uint8_t* dp = batch->records + size_t(i) * RECORD_SIZE;
+            dp = rec.sg.pack(dp);
+            saveGameMonstersPack(rec.hasMonsters ? rec.mons : NULL, dp);
+        }
+    }
+    return THREAD_RETURN;
+}
+
+//----------------------------------------------------------------------------
+
+static void printColumn(const char* label, const uint32_t* values, int count,
+                        const char* const* names) {
+    printf("%s:\n", label);
+    for (int i = 0; i < count; ++i) {
+        if (names)
+            printf("  %-16s %u\n", names[i], values[i]);
+        else
+            printf("  %-16d %u\n", i, values[i]);
+    }
+}
+
+static void printStats(const Stats* st) {
+    static const char* const bucketNames[KARMA_BUCKETS] = {
+        "0", "1-24", "25-49", "50-74", "75-98", "99+"
+    };
+    uint32_t n = st->count ? st->count : 1;
+    int i, v;
+
+    printf("saves: %u  invalid: %u\n", st->count, st->invalid);
+    printf("average moves: %.1f  gold: %.1f  torches: %.1f  gems: %.1f"
+           "  keys: %.1f\n",
+           double(st->moves) / n, double(st->gold) / n,
+           double(st->torches) / n, double(st->gems) / n,
+           double(st->keys) / n);
+
+    printColumn("avatar-level (0 = invalid)", st->level, 9, NULL);
+    printColumn("avatar-class", st->klass, 8, classNames);
+    printColumn("party-members", st->members, 9, NULL);
+
+    printf("karma:\n  %-8s", "");
+    for (v = 0; v < VIRT_MAX; ++v)
+        printf(" %8s", virtueNames[v]);
+    printf("\n");
+    for (i = 0; i < KARMA_BUCKETS; ++i) {
+        printf("  %-8s", bucketNames[i]);
+        for (v = 0; v < VIRT_MAX; ++v)
+            printf(" %8u", st->karma[v][i]);
+        printf("\n");
+    }
+
+    printColumn("items", st->items, 16, itemNames);
+    printColumn("stones (bit)", st->stones, 8, NULL);
+    printColumn("runes (bit)", st->runes, 8, NULL);
+}
+
+//----------------------------------------------------------------------------
+
+#define DIFF_FIELD(name, fmt) \
+    if (a.name != b.name) \
+        printf("%-16s " fmt " " fmt "\n", #name, a.name, b.name)
+
+#define DIFF_ARRAY(name, count) \
+    for (i = 0; i < count; ++i) { \
+        if (a.name[i] != b.name[i]) \
+            printf("%s[%d]%*s %d %d\n", #name, i, \
+                   int(13 - strlen(#name)), "", a.name[i], b.name[i]); \
+    }
+
+static void diffPlayer(int n, const SaveGamePlayerRecord& a,
+                       const SaveGamePlayerRecord& b) {
+    char label[24];
+
+#define DIFF_PLAYER(name, fmt) \
+    if (a.name != b.name) { \
+        snprintf(label, sizeof(label), "player%d.%s", n, #name); \
+        printf("%-16s " fmt " " fmt "\n", label, a.name, b.name); \
+    }
+
+    DIFF_PLAYER(hp, "%d");
+    DIFF_PLAYER(hpMax, "%d");
+    DIFF_PLAYER(xp, "%d");
+    DIFF_PLAYER(str, "%d");
+    DIFF_PLAYER(dex, "%d");
+    DIFF_PLAYER(intel, "%d");
+    DIFF_PLAYER(mp, "%d");
+    DIFF_PLAYER(weapon, "%d");
+    DIFF_PLAYER(armor, "%d");
+    DIFF_PLAYER(sex, "%d");
+    DIFF_PLAYER(klass, "%d");
+    DIFF_PLAYER(status, "%c");
+    if (strncmp(a.name, b.name, 16) != 0)
+        printf("player%d.name    %.16s %.16s\n", n, a.name, b.name);
+}
+
+static int diffSets(const SaveRec& ra, const SaveRec& rb) {
+    const SaveGame& a = ra.sg;
+    const SaveGame& b = rb.sg;
+    int i;
+
+    DIFF_FIELD(moves, "%u");
+    for (i = 0; i < 8; ++i)
+        diffPlayer(i + 1, a.players[i], b.players[i]);
+    DIFF_FIELD(food, "%d");
+    DIFF_FIELD(gold, "%d");
+    DIFF_ARRAY(karma, VIRT_MAX);
+    DIFF_FIELD(torches, "%d");
+    DIFF_FIELD(gems, "%d");
+    DIFF_FIELD(keys, "%d");
+    DIFF_FIELD(sextants, "%d");
+    DIFF_ARRAY(armor, ARMR_MAX);
+    DIFF_ARRAY(weapons, WEAP_MAX);
+    DIFF_ARRAY(reagents, REAG_MAX);
+    DIFF_ARRAY(mixtures, SPELL_MAX);
+    DIFF_FIELD(items, "0x%04x");
+    DIFF_FIELD(x, "%d");
+    DIFF_FIELD(y, "%d");
+    DIFF_FIELD(stones, "0x%02x");
+    DIFF_FIELD(runes, "0x%02x");
+    DIFF_FIELD(members, "%d");
+    DIFF_FIELD(transport, "0x%x");
+    DIFF_FIELD(balloonstate, "%d");
+    DIFF_FIELD(trammelphase, "%d");
+    DIFF_FIELD(feluccaphase, "%d");
+    DIFF_FIELD(shiphull, "%d");
+    DIFF_FIELD(lbintro, "%d");
+    DIFF_FIELD(lastcamp, "%d");
+    DIFF_FIELD(lastreagent, "%d");
+    DIFF_FIELD(lastmeditation, "%d");
+    DIFF_FIELD(lastvirtue, "%d");
+    DIFF_FIELD(dngx, "%d");
+    DIFF_FIELD(dngy, "%d");
+    DIFF_FIELD(orientation, "%d");
+    DIFF_FIELD(dnglevel, "%d");
+    DIFF_FIELD(location, "%d");
+
+    if (memcmp(ra.mons, rb.mons, sizeof(ra.mons)) != 0) {
+        for (i = 0; i < MONSTERTABLE_SIZE; ++i) {
+            if (memcmp(ra.mons + i, rb.mons + i, sizeof(ra.mons[0])) != 0)
+                printf("monster[%d]       %d,%d tile %d  %d,%d tile %d\n", i,
+                       ra.mons[i].x, ra.mons[i].y, ra.mons[i].tile,
+                       rb.mons[i].x, rb.mons[i].y, rb.mons[i].tile);
+        }
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+
+/*
+ * Append an argument to the input list.  Bundles are expanded into their
+ * records.  Return false if a bundle cannot be read.
+ */
+static bool addInput(std::vector<Input>& list, const char* path) {
+    Input in;
+    in.path = path;
+    in.record = -1;
+
+    if (hasSuffix(in.path, ".u4b")) {
+        FILE* fp = fopen(path, "rb");
+        if (! fp) {
+            perror(path);
+            return false;
+        }
+        uint32_t count = bundleCount(fp);
+        fclose(fp);
+        for (uint32_t i = 0; i < count; ++i) {
+            in.record = i;
+            list.push_back(in);
+        }
+    } else {
+        list.push_back(in);
+    }
+    return true;
+}
+
+static bool readInputList(std::vector<Input>& list, const char* file) {
+    char line[1024];
+    FILE* fp = strcmp(file, "-") ? fopen(file, "r") : stdin;
+    if (! fp) {
+        perror(file);
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        if (len && ! addInput(list, line))
+            break;
+    }
+    if (fp != stdin)
+        fclose(fp);
+    return true;
+}
+
+static int cpuCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? int(n) : 1;
+#endif
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [OPTIONS] <command> [<path> ...]\n\n"
+        "Commands:\n"
+        "  validate            Check that saves are well formed.\n"
+        "  stats               Print statistics for all valid saves.\n"
+        "  convert <out.u4b>   Pack all valid saves into a bundle.\n"
+        "  diff <pathA> <pathB>  Show the values that differ.\n\n"
+        "A path may be a directory holding " PARTY_SAV " & " MONSTERS_SAV
+        ",\na " PARTY_SAV " file, or a .u4b bundle.\n\n"
+        "Options:\n"
+        "  -j <count>   Number of worker threads (default is CPU count).\n"
+        "  -l <file>    Read paths from file, one per line (- for stdin).\n"
+        "  -q           Do not print validation errors.\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<Input> inputs;
+    std::vector<Worker> workers;
+    const char* cmdName = NULL;
+    const char* outFile = NULL;
+    FILE* out = NULL;
+    Stats total;
+    Batch batch;
+    Command cmd;
+    int threads = cpuCount();
+    uint32_t written = 0;
+    bool quiet = false;
+    int i, start;
+
+    for (i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (arg[0] == '-' && arg[1] && ! cmdName) {
+            switch (arg[1]) {
+                case 'j':
+                    if (++i >= argc)
+                        goto bad_usage;
+                    threads = atoi(argv[i]);
+                    if (threads < 1)
+                        threads = 1;
+                    break;
+                case 'l':
+                    if (++i >= argc)
+                        goto bad_usage;
+                    if (! readInputList(inputs, argv[i]))
+                        return EX_NOINPUT;
+                    break;
+                case 'q':
+                    quiet = true;
+                    break;
+                default:
+                    goto bad_usage;
+            }
+        } else if (! cmdName) {
+            cmdName = arg;
+            if (strcmp(cmdName, "convert") == 0) {
+                if (++i >= argc)
+                    goto bad_usage;
+                outFile = argv[i];
+            }
+        } else if (! addInput(inputs, arg)) {
+            return EX_NOINPUT;
+        }
+    }
+
+    if (! cmdName)
+        goto bad_usage;
+
+    if (strcmp(cmdName, "diff") == 0) {
+        Worker wk;
+        SaveRec ra, rb;
+        const char* err;
+
+        if (inputs.size() != 2)
+            goto bad_usage;
+        wk.bundle = NULL;
+        err = loadSet(&wk, &inputs[0], &ra);
+        if (! err)
+            err = loadSet(&wk, &inputs[1], &rb);
+        if (wk.bundle)
+            fclose(wk.bundle);
+        if (err) {
+            fprintf(stderr, "%s\n", err);
+            return EX_NOINPUT;
+        }
+        return diffSets(ra, rb);
+    }
+
+    if (strcmp(cmdName, "validate") == 0)
+        cmd = CMD_VALIDATE;
+    else if (strcmp(cmdName, "stats") == 0)
+        cmd = CMD_STATS;
+    else if (strcmp(cmdName, "convert") == 0)
+        cmd = CMD_CONVERT;
+    else
+        goto bad_usage;
+
+    if (cmd == CMD_CONVERT) {
+        out = fopen(outFile, "wb");
+        if (! out) {
+            perror(outFile);
+            return EX_CANTCREAT;
+        }
+        fwrite(BUNDLE_MAGIC "\0\0\0\0", 1, BUNDLE_HEADER, out);
+    }
+
+    memset(&total, 0, sizeof(total));
+    workers.resize(threads);
+
+    // Process inputs in batches to bound the memory used by convert.
+    batch.cmd     = cmd;
+    batch.quiet   = quiet;
+    batch.valid   = (uint8_t*) malloc(BATCH_SIZE);
+    batch.records = (cmd == CMD_CONVERT) ?
+                        (uint8_t*) malloc(BATCH_SIZE * RECORD_SIZE) : NULL;
+
+    for (start = 0; start < int(inputs.size()); start += BATCH_SIZE) {
+        batch.inputs = &inputs[start];
+        batch.count  = inputs.size() - start;
+        if (batch.count > BATCH_SIZE)
+            batch.count = BATCH_SIZE;
+
+        for (i = 0; i < threads; ++i) {
+            Worker& wk = workers[i];
+            wk.batch  = &batch;
+            wk.first  = i;
+            wk.stride = threads;
+            wk.bundle = NULL;
+            wk.bundlePath.clear();
+            memset(&wk.stats, 0, sizeof(Stats));
+            if (! thread_create(&wk.thread, workerMain, &wk)) {
+                fprintf(stderr, "Cannot create thread\n");
+                return EX_DATAERR;
+            }
+        }
+
+        for (i = 0; i < threads; ++i) {
+            Worker& wk = workers[i];
+            thread_join(wk.thread);
+            if (wk.bundle)
+                fclose(wk.bundle);
+            mergeStats(&total, &wk.stats);
+        }
+
+        if (out) {
+            for (i = 0; i < batch.count; ++i) {
+                if (batch.valid[i]) {
+                    fwrite(batch.records + size_t(i) * RECORD_SIZE, 1,
+                           RECORD_SIZE, out);
+                    ++written;
+                }
+            }
+        }
+    }
+
+    free(batch.valid);
+    free(batch.records);
+
+    if (out) {
+        uint8_t count[4];
+        packInt(count, written);
+        fseek(out, 4, SEEK_SET);
+        fwrite(count, 1, 4, out);
+        if (fclose(out) != 0) {
+            perror(outFile);
+            return EX_CANTCREAT;
+        }
+        printf("%u saves written to %s (%u invalid)\n",
+               written, outFile, total.invalid);
+    } else if (cmd == CMD_STATS) {
+        printStats(&total);
+    } else {
+        printf("%u of %u saves are valid\n",
+               uint32_t(inputs.size()) - total.invalid,
+               uint32_t(inputs.size()));
+    }
+    return total.invalid ? EX_DATAERR : 0;
+
+bad_usage:
+    usage(argv[0]);
+    return EX_USAGE;
+}
@@ -0,0 +1,119 @@
+// Benchmark & check the Symbol indexed tables used for tile & tile rule
+// lookups against the linear scan and std::map which they replaced.
+//
+// Usage: symbench [<element-count>]
+
+#include <stdio.h>
+#include <map>
+#include "../support/symbolIndex.c"
+#include "../support/getTicks.c"
+
+#define ELEMENT_COUNT   256     // Near the number of tiles in U4.
+#define SYMBOL_RANGE    2048    // Atoms in use after the config is loaded.
+#define LOOKUPS         4000000
+
+// Stand-in for Tile & TileRule; only the name and the stride matter.
+struct Element {
+    uint16_t name;
+    uint16_t data[31];
+};
+
+static uint32_t rngState = 0x5eed;
+
+static uint32_t rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static int linearFirst(const Element* elem, int count, uint16_t sym) {
+    for (int i = 0; i < count; ++i) {
+        if (elem[i].name == sym)
+            return i + 1;
+    }
+    return 0;
+}
+
+static double nsPer(int64_t usec, int n) {
+    return double(usec) * 1000.0 / n;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : ELEMENT_COUNT;
+    if (count < 1 || count > 65534) {
+        fprintf(stderr, "symbench: Invalid element count\n");
+        return 1;
+    }
+
+    Element* elem = new Element[count];
+    std::map<uint16_t, int> nameMap;
+    uint16_t* first;
+    uint16_t* last;
+    uint32_t firstSize, lastSize;
+    uint16_t* query;
+    uint32_t sum;
+    int64_t t0;
+    int errors = 0;
+    int i, n;
+
+    // Some names are repeated to check which element wins.
+    for (i = 0; i < count; ++i) {
+        elem[i].name = (i > 0 && (rng() & 15) == 0) ? elem[rng() % i].name
+                                                     : rng() % SYMBOL_RANGE;
+        nameMap[elem[i].name] = i + 1;          // Old Tileset::nameMap
+    }
+
+    t0 = usecTicks();
+    first = symi_build(&elem->name, count, sizeof(Element), SYMI_FIRST,
+                       &firstSize);
+    last  = symi_build(&elem->name, count, sizeof(Element), SYMI_LAST,
+                       &lastSize);
+    if (! first || ! last) {
+        fprintf(stderr, "symbench: Out of memory\n");
+        return 1;
+    }
+    printf("%d elements, build %.1f usec\n", count,
+           double(usecTicks() - t0) / 2.0);
+
+    for (i = 0; i < SYMBOL_RANGE + 16; ++i) {
+        std::map<uint16_t, int>::const_iterator it = nameMap.find(i);
+        int mapN = (it == nameMap.end()) ? 0 : it->second;
+        if (symi_lookup(first, firstSize, i) != linearFirst(elem, count, i) ||
+            symi_lookup(last, lastSize, i) != mapN) {
+            if (++errors < 8)
+                printf("Mismatch on symbol %d\n", i);
+        }
+    }
+
+    query = new uint16_t[1024];
+    for (i = 0; i < 1024; ++i)
+        query[i] = (i & 1) ? elem[rng() % count].name : rng() % SYMBOL_RANGE;
+
+    sum = 0;
+    t0 = usecTicks();
+    for (n = 0; n < LOOKUPS; ++n)
+        sum += symi_lookup(first, firstSize, query[n & 1023]);
+    printf("Index:  %.1f ns/lookup\n", nsPer(usecTicks() - t0, LOOKUPS));
+
+    t0 = usecTicks();
+    for (n = 0; n < LOOKUPS; ++n)
+        sum -= linearFirst(elem, count, query[n & 1023]);
+    printf("Linear: %.1f ns/lookup\n", nsPer(usecTicks() - t0, LOOKUPS));
+    if (sum)
+        ++errors;
+
+    t0 = usecTicks();
+    for (n = 0; n < LOOKUPS; ++n)
+        sum += nameMap.find(query[n & 1023]) != nameMap.end();
+    printf("Map:    %.1f ns/lookup (%u)\n", nsPer(usecTicks() - t0, LOOKUPS),
+           sum);
+
+    printf("%d errors\n", errors);
+
+    free(first);
+    free(last);
+    delete[] query;
+    delete[] elem;
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+// Stress test & benchmark the TimedEventMgr heap.
+//
+// Random adds and removes (including removals from inside callbacks) are
+// applied to TimedEventMgr and to a simple scan of every event each tick.
+// The order in which callbacks run must be identical.
+//
+// Usage: timerbench [<event-count>]
+
+#include <stdio.h>
+#include <vector>
+#include "../timedevent.cpp"
+#include "../support/getTicks.c"
+
+#define EVENT_COUNT     64      // Typical number of game timers is < 16.
+#define CHECK_TICKS     20000
+#define BENCH_TICKS     200000
+
+struct LogEntry {
+    uint32_t tick;
+    int event;
+};
+
+struct ScanEvent {
+    uint32_t due;
+    int interval;
+    bool live;
+};
+
+// The event identifiers used by the manager differ from the test ones.
+struct Harness {
+    TimedEventMgr* mgr;                 // NULL when running the scan model.
+    std::vector<ScanEvent> scan;
+    std::vector<int> mgrId;
+    std::vector<LogEntry> log;
+    uint32_t now;
+    bool logging;
+};
+
+struct EventArg {
+    Harness* h;
+    int n;
+};
+
+static std::vector<EventArg> args;
+
+static uint32_t mix(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1 ^ b * 0x85EBCA77;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    return h ^ (h >> 13);
+}
+
+static void harnessRemove(Harness* h, int n) {
+    if (h->mgr) {
+        if (h->mgrId[n] >= 0) {
+            h->mgr->remove(h->mgrId[n]);
+            h->mgrId[n] = -1;
+        }
+    } else
+        h->scan[n].live = false;
+}
+
+static void eventFired(void* data) {
+    EventArg* arg = (EventArg*) data;
+    Harness* h = arg->h;
+
+    if (h->logging) {
+        LogEntry le;
+        le.tick  = h->now;
+        le.event = arg->n;
+        h->log.push_back(le);
+
+        // Sometimes remove another event (or this one) from the callback.
+        uint32_t r = mix(arg->n, h->now);
+        if ((r & 31) == 0)
+            harnessRemove(h, (r >> 8) % h->scan.size());
+    }
+}
+
+static void harnessAdd(Harness* h, int n, int interval) {
+    if (h->mgr) {
+        h->mgrId[n] = h->mgr->add(eventFired, interval, &args[n]);
+    } else {
+        ScanEvent& se = h->scan[n];
+        se.due = h->now + interval;
+        se.interval = interval;
+        se.live = true;
+    }
+}
+
+static bool harnessLive(const Harness* h, int n) {
+    return h->mgr ? (h->mgrId[n] >= 0) : h->scan[n].live;
+}
+
+/*
+ * Run the callbacks of due events in (due, add order) sequence by scanning
+ * all events, as the list based manager did.  Ties are broken by the tick
+ * on which the event was last added, which the test tracks in addOrder.
+ */
+static std::vector<uint32_t> addOrder;
+
+static void scanTick(Harness* h) {
+    int best, i;
+    int count = h->scan.size();
+
+    for (;;) {
+        best = -1;
+        for (i = 0; i < count; ++i) {
+            const ScanEvent& se = h->scan[i];
+            if (! se.live || int32_t(h->now - se.due) < 0)
+                continue;
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+            const ScanEvent& be = h->scan[best];
+            if (int32_t(se.due - be.due) < 0 ||
+                (se.due == be.due && addOrder[i] < addOrder[best]))
+                best = i;
+        }
+        if (best < 0)
+            break;
+        h->scan[best].due = h->now + h->scan[best].interval;
+        eventFired(&args[best]);
+    }
+}
+
+static void runOps(Harness* h, int count, int ticks, uint32_t seed) {
+    uint32_t rs = seed;
+    uint32_t adds = 0;
+    int i, n;
+
+    for (i = 0; i < count; ++i) {
+        addOrder[i] = adds++;
+        harnessAdd(h, i, 1 + mix(i, seed) % 50);
+    }
+
+    for (h->now = 1; h->now <= uint32_t(ticks); ++h->now) {
+        if (h->mgr)
+            h->mgr->tick();
+        else
+            scanTick(h);
+
+        // Randomly remove & re-add events between ticks.
+        rs = mix(rs, h->now);
+        if ((rs & 3) == 0) {
+            n = (rs >> 4) % count;
+            if (harnessLive(h, n))
+                harnessRemove(h, n);
+            else {
+                addOrder[n] = adds++;
+                harnessAdd(h, n, 1 + (rs >> 16) % 50);
+            }
+        }
+    }
+}
+
+static void harnessInit(Harness* h, TimedEventMgr* mgr, int count, bool log) {
+    h->mgr = mgr;
+    h->scan.assign(count, ScanEvent());
+    h->mgrId.assign(count, -1);
+    h->log.clear();
+    h->now = 0;
+    h->logging = log;
+    for (int i = 0; i < count; ++i) {
+        args[i].h = h;
+        args[i].n = i;
+        h->scan[i].live = false;
+    }
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : EVENT_COUNT;
+    Harness hs, hm;
+    int64_t t0, tScan, tHeap;
+    size_t i;
+    int errors = 0;
+
+    if (count < 1) {
+        fprintf(stderr, "timerbench: Invalid event count\n");
+        return 1;
+    }
+    args.resize(count);
+    addOrder.resize(count);
+
+    {
+    TimedEventMgr mgr;
+    harnessInit(&hs, NULL, count, true);
+    runOps(&hs, count, CHECK_TICKS, 0xC0FFEE);
+    harnessInit(&hm, &mgr, count, true);
+    runOps(&hm, count, CHECK_TICKS, 0xC0FFEE);
+    }
+
+    if (hs.log.size() != hm.log.size()) {
+        printf("Callback count differs (scan %d, heap %d)\n",
+               int(hs.log.size()), int(hm.log.size()));
+        ++errors;
+    }
+    for (i = 0; i < hs.log.size() && i < hm.log.size(); ++i) {
+        if (hs.log[i].tick != hm.log[i].tick ||
+            hs.log[i].event != hm.log[i].event) {
+            printf("Callback %d differs (scan %u:%d, heap %u:%d)\n", int(i),
+                   hs.log[i].tick, hs.log[i].event,
+                   hm.log[i].tick, hm.log[i].event);
+            ++errors;
+            break;
+        }
+    }
+    printf("%d events, %d callbacks checked\n", count, int(hs.log.size()));
+
+    // Time without logging.
+    harnessInit(&hs, NULL, count, false);
+    t0 = usecTicks();
+    runOps(&hs, count, BENCH_TICKS, 1);
+    tScan = usecTicks() - t0;
+
+    {
+    TimedEventMgr mgr;
+    harnessInit(&hm, &mgr, count, false);
+    t0 = usecTicks();
+    runOps(&hm, count, BENCH_TICKS, 1);
+    tHeap = usecTicks() - t0;
+    }
+
+    printf("Heap: %.1f ns/tick\n", double(tHeap) * 1000.0 / BENCH_TICKS);
+    printf("Scan: %.1f ns/tick\n", double(tScan) * 1000.0 / BENCH_TICKS);
+    printf("%d errors\n", errors);
+    return errors ? 1 : 0;
+}
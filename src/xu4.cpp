@@ -12,6 +12,7 @@
 #include <cstring>
 #include <ctime>
 #include "xu4.h"
+#include "combatsim.h"
 #include "config.h"
 #include "error.h"
 #include "game.h"
@@ -19,6 +20,7 @@
 #include "imagemgr.h"
 #include "intro.h"
 #include "progress_bar.h"
+#include "savegame.h"
 #include "screen.h"
 #include "settings.h"
 #include "sound.h"
@@ -53,8 +55,6 @@ uint32_t well512_genU32(void* ws);
 #include "well512.h"
 #endif
 
-static void xu4_srandom(uint32_t);
-
 
 enum OptionsFlag {
     OPT_FULLSCREEN = 1,
@@ -64,7 +64,8 @@ enum OptionsFlag {
     OPT_FILTER     = 0x10,
     OPT_RECORD     = 0x20,
     OPT_REPLAY     = 0x40,
-    OPT_TEST_SAVE  = 0x80
+    OPT_TEST_SAVE  = 0x80,
+    OPT_COMBAT_SIM = 0x100
 };
 
 struct Options {
@@ -75,6 +76,8 @@ struct Options {
     const char* module;
     const char* profile;
     const char* recordFile;
+    const char* combatSim;
+    uint32_t seekTurn;
 };
 
 #define strEqual(A,B)       (strcmp(A,B) == 0)
@@ -93,6 +96,12 @@ int parseOptions(Options* opt, int argc, char** argv) {
             opt->filter = Settings::settingEnum(screenGetFilterNames(),argv[i]);
             opt->used |= OPT_FILTER;
         }
+        else if (strEqual(argv[i], "--seek"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->seekTurn = strtoul(argv[i], NULL, 0);
+        }
         else if (strEqualAlt(argv[i], "-s", "--scale"))
         {
             if (++i >= argc)
@@ -107,6 +116,13 @@ int parseOptions(Options* opt, int argc, char** argv) {
             opt->module = argv[i];
         }
 #endif
+        else if (strEqual(argv[i], "--combat-sim"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->combatSim = argv[i];
+            opt->flags |= OPT_COMBAT_SIM;
+        }
         else if (strEqualAlt(argv[i], "-p", "--profile"))
         {
             if (++i >= argc)
@@ -139,6 +155,9 @@ int parseOptions(Options* opt, int argc, char** argv) {
                    "v%s (%s)\n\n", VERSION, __DATE__ );
             printf(
             "Options:\n"
+            "  -c, --capture <file>    Record user input.\n"
+            "      --combat-sim <spec> Simulate battles with the saved party and quit.\n"
+            "                          (creature[,battles[,seed[,threads]]])\n"
             "      --filter <string>   Specify display filtering mode.\n"
             "                          (point, HQX, xBR-lv2, xBRZ, point-43, xBRZ-43)\n"
             "  -f, --fullscreen        Run in fullscreen mode.\n"
@@ -149,19 +168,18 @@ int parseOptions(Options* opt, int argc, char** argv) {
 #endif
             "  -p, --profile <string>  Use another set of settings and save files.\n"
             "  -q, --quiet             Disable audio.\n"
+            "  -r, --replay <file>     Play using recorded input.\n"
             "  -s, --scale <int>       Specify display scaling factor (1-5).\n"
+            "      --seek <turn>       Run replay quickly to the given turn.\n"
             "  -v, --verbose           Enable verbose console output.\n"
 #ifdef DEBUG
             "\nDEBUG Options:\n"
-            "  -c, --capture <file>    Record user input.\n"
-            "  -r, --replay <file>     Play using recorded input.\n"
             "      --test-save         Save to /tmp/xu4/ and quit.\n"
 #endif
             "\nHomepage: http://xu4.sourceforge.net\n");
 
             return 0;
         }
-#ifdef DEBUG
         else if (strEqualAlt(argv[i], "-c", "--capture"))
         {
             if (++i >= argc)
@@ -178,6 +196,7 @@ int parseOptions(Options* opt, int argc, char** argv) {
             opt->flags |= OPT_REPLAY;
             opt->used  |= OPT_REPLAY;
         }
+#ifdef DEBUG
         else if (strEqual(argv[i], "--test-save"))
         {
             opt->flags |= OPT_TEST_SAVE;
@@ -229,9 +248,7 @@ static void initResourcePaths(StringTable* st) {
 
 //----------------------------------------------------------------------------
 
-#ifdef DEBUG
 static void servicesFree(XU4GameServices*);
-#endif
 
 void servicesInit(XU4GameServices* gs, Options* opt) {
     gs->verbose = opt->flags & OPT_VERBOSE;
@@ -248,6 +265,7 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
 
     /* Setup the message bus early to make it available to other services. */
     notify_init(&gs->notifyBus, 8);
+    notify_initPosts(&gs->notifyBus, 64);
 
     /* initialize the settings */
     gs->settings = new Settings;
@@ -263,23 +281,26 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
 
     gs->config = configInit(opt->module ? opt->module : gs->settings->game,
                             gs->settings->soundtrack);
+    if (opt->flags & OPT_COMBAT_SIM)
+        return;     // Headless; no audio, video or event handling.
     if (! (opt->flags & OPT_NO_AUDIO))
         soundInit();
-    gs->eventHandler = new EventHandler(1000/gs->settings->gameCyclesPerSecond,
-                            1000/gs->settings->screenAnimationFramesPerSecond);
+    gs->eventHandler = new EventHandler(gs->settings->gameCyclesPerSecond,
+                            gs->settings->screenAnimationFramesPerSecond);
     screenInit(LAYER_COUNT);
     Tile::initSymbols(gs->config);
 
     {
     uint32_t seed;
 
-#ifdef DEBUG
     if (opt->flags & OPT_REPLAY) {
         seed = gs->eventHandler->replay(opt->recordFile);
         if (! seed) {
             servicesFree(gs);
             errorFatal("Cannot open recorded input from %s", opt->recordFile);
         }
+        if (opt->seekTurn)
+            gs->eventHandler->replaySeek(opt->seekTurn);
         xu4_srandom(seed);
     } else if (opt->flags & OPT_RECORD) {
         seed = time(NULL);
@@ -289,7 +310,6 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
         }
         xu4_srandom(seed);
     } else
-#endif
         seed = time(NULL);
 
     xu4_srandom(seed);
@@ -300,6 +320,8 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
 }
 
 static void servicesFreeGame(XU4GameServices* gs) {
+    saveSetWait();      // Finish any background save.
+
     delete gs->game;
     delete gs->intro;
     delete gs->gameBrowser;
@@ -337,8 +359,8 @@ static void servicesReset(XU4GameServices* gs) {
     soundInit();
 
     gs->eventHandler = new EventHandler(
-                        1000/settings->gameCyclesPerSecond,
-                        1000/settings->screenAnimationFramesPerSecond);
+                        settings->gameCyclesPerSecond,
+                        settings->screenAnimationFramesPerSecond);
 
     uint32_t seed = time(NULL);
     xu4_srandom(seed);
@@ -370,6 +392,17 @@ int main(int argc, char *argv[]) {
     memset(&xu4, 0, sizeof xu4);
     servicesInit(&xu4, &opt);
 
+    if (opt.flags & OPT_COMBAT_SIM) {
+        int status = combatSim_run(opt.combatSim);
+        delete xu4.saveGame;
+        configFree(xu4.config);
+        delete xu4.settings;
+        notify_free(&xu4.notifyBus);
+        u4fcleanup();
+        sst_free(&xu4.resourcePaths);
+        return status;
+    }
+
 #ifdef DEBUG
     if (opt.flags & OPT_TEST_SAVE) {
         int status;
@@ -456,7 +489,8 @@ void xu4_freeResourceGroup(uint16_t group) {
 /*
  * Seed the random number generator.
  */
-static void xu4_srandom(uint32_t seed) {
+void xu4_srandom(uint32_t seed) {
+    xu4.randomCount = xu4.randomLast = 0;
 #ifdef USE_BORON
     // Compiled code and module scripts share this generator.
     boron_randomSeed(xu4.config->boronThread(), seed);
@@ -475,18 +509,23 @@ extern "C" {
 
 /*
  * Generate a random number between 0 and (upperRange - 1).
+ *
+ * The number of draws and the last value are tracked so that the generator
+ * state can be included in recording checksums.
  */
 int xu4_random(int upperRange) {
 #ifdef USE_BORON
     if (upperRange < 2)
         return 0;
-#ifdef REPORT_RNG
     uint32_t r = boron_random(xu4.config->boronThread());
+    ++xu4.randomCount;
+    xu4.randomLast = r;
+#ifdef REPORT_RNG
     uint32_t n = r % upperRange;
     printf( "KR rn %d %d %c\n", r, n, rpos);
     return n;
 #else
-    return boron_random(xu4.config->boronThread()) % upperRange;
+    return r % upperRange;
 #endif
 #else
 #if (defined(BSD) && (BSD >= 199103)) || (defined (MACOSX) || defined (IOS))
@@ -494,6 +533,8 @@ int xu4_random(int upperRange) {
 #else
     int r = rand();
 #endif
+    ++xu4.randomCount;
+    xu4.randomLast = r;
     return (int) ((((double)upperRange) * r) / (RAND_MAX+1.0));
 #endif
 }
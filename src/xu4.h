@@ -12,6 +12,7 @@ enum NotifySender {
     SENDER_AURA,        // Aura*
     SENDER_MENU,        // MenuEvent*
     SENDER_SETTINGS,    // Settings*
+    SENDER_SOUND,       // SoundEvent* (posted by the sound loader thread)
   //SENDER_DISPLAY      // NULL or ScreenState*
 };
 
@@ -60,6 +61,8 @@ struct XU4GameServices {
     uint16_t resGroup;
     uint16_t gameReset;         // Load another game.
     uint32_t randomFx[17];      // Effects random number generator state.
+    uint32_t randomCount;       // Number of xu4_random() draws since seeded.
+    uint32_t randomLast;        // Last value drawn by xu4_random().
     bool verbose;
 };
 
@@ -69,8 +72,23 @@ extern XU4GameServices xu4;
 #define gs_unplug(id)               notify_unplug(&xu4.notifyBus,id)
 #define gs_emitMessage(sid,data)    notify_emit(&xu4.notifyBus,sid,data);
 
+/*
+ * Queue a message from any thread without locking or allocating memory.
+ * The main loop emits a copy of the message to the listeners, so T must be
+ * a plain struct of no more than NOTIFY_POST_SIZE bytes.
+ *
+ * Return false if the queue is full.
+ */
+template<class T>
+inline bool gs_postMessage(int sid, const T& msg) {
+    typedef char MessageTooLarge[(sizeof(T) <= NOTIFY_POST_SIZE) ? 1 : -1];
+    (void) sizeof(MessageTooLarge);
+    return notify_post(&xu4.notifyBus, sid, &msg, sizeof(T)) != 0;
+}
+
 void xu4_selectGame();
 uint16_t xu4_setResourceGroup(uint16_t group);
 void     xu4_freeResourceGroup(uint16_t group);
+void     xu4_srandom(uint32_t seed);
 extern "C" int xu4_random(int upperval);
 extern "C" int xu4_randomFx(int upperval);